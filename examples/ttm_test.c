@@ -11,12 +11,200 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <poll.h>
 #include <errno.h>
 
 #include "../include/pddgpu_drv.h"
 
 #define DEVICE_PATH "/dev/dri/card0"
 #define TEST_SIZE (1024 * 1024)  /* 1MB */
+#define PARAM_PATH "/sys/module/pddgpu/parameters/"
+#define PURGE_FILLER_SIZE (64 * 1024 * 1024)  /* 64MB */
+#define PURGE_MAX_FILLERS 256
+
+/* 读取整数模块参数，读取失败返回-1 */
+static int read_param(const char *name)
+{
+	char path[128];
+	FILE *f;
+	int val;
+
+	snprintf(path, sizeof(path), PARAM_PATH "%s", name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &val) != 1)
+		val = -1;
+	fclose(f);
+
+	return val;
+}
+
+/* 预取到指定域并等待栅栏 */
+static int prefetch_wait(int fd, __u32 *handle, __u32 domain)
+{
+	struct drm_pddgpu_gem_prefetch args = {};
+	struct pollfd pfd = {};
+	int ret;
+
+	args.handles = (unsigned long)handle;
+	args.num_handles = 1;
+	args.domain = domain;
+
+	if (ioctl(fd, DRM_IOCTL_PDDGPU_GEM_PREFETCH, &args) < 0)
+		return -1;
+
+	pfd.fd = args.fence_fd;
+	pfd.events = POLLIN;
+	ret = poll(&pfd, 1, 1000);
+	close(args.fence_fd);
+
+	return ret > 0 ? 0 : -1;
+}
+
+/* 映射BO，按val填充或检查全部内容，不一致时返回-1 */
+static int fill_or_check(int fd, __u32 handle, size_t size, unsigned char val, int check)
+{
+	struct drm_pddgpu_gem_map map_args = {};
+	unsigned char *data;
+	size_t i;
+	int ret = 0;
+
+	map_args.handle = handle;
+	map_args.size = size;
+	if (ioctl(fd, DRM_IOCTL_PDDGPU_GEM_MAP, &map_args) < 0)
+		return -1;
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	            fd, map_args.offset);
+	if (data == MAP_FAILED)
+		return -1;
+
+	if (!check) {
+		memset(data, val, size);
+	} else {
+		for (i = 0; i < size; i++) {
+			if (data[i] != val) {
+				printf("  偏移%zu: 0x%02x，期望0x%02x\n", i, data[i], val);
+				ret = -1;
+				break;
+			}
+		}
+	}
+
+	munmap(data, size);
+	return ret;
+}
+
+/*
+ * 系统内存中的BO空闲后被后台压缩，再迁移到VRAM时内容必须先解压，
+ * 不能被当作未填充的页面清零。需要以compress_interval_ms非零加载驱动。
+ */
+static void test_compress_move(int fd)
+{
+	struct drm_pddgpu_gem_create create_args = {};
+	int interval = read_param("compress_interval_ms");
+	int min_age = read_param("compress_min_age_ms");
+
+	if (interval <= 0) {
+		printf("压缩后迁移: 跳过（compress_interval_ms未开启）\n");
+		return;
+	}
+
+	create_args.size = TEST_SIZE;
+	create_args.alignment = 4096;
+	create_args.domains = PDDGPU_GEM_DOMAIN_CPU | PDDGPU_GEM_DOMAIN_VRAM;
+
+	if (ioctl(fd, DRM_IOCTL_PDDGPU_GEM_CREATE, &create_args) < 0) {
+		perror("Failed to create GEM object");
+		return;
+	}
+
+	if (prefetch_wait(fd, &create_args.handle, PDDGPU_GEM_DOMAIN_CPU) ||
+	    fill_or_check(fd, create_args.handle, TEST_SIZE, 0x5A, 0)) {
+		perror("Failed to fill GEM object in system memory");
+		goto out;
+	}
+
+	/* 等BO超过最短空闲时间并经过至少两轮压缩 */
+	usleep(((min_age > 0 ? min_age : 0) + 2 * interval + 100) * 1000);
+
+	if (prefetch_wait(fd, &create_args.handle, PDDGPU_GEM_DOMAIN_VRAM)) {
+		perror("Failed to prefetch GEM object to VRAM");
+		goto out;
+	}
+
+	printf("压缩后迁移到VRAM: 内容%s\n",
+	       fill_or_check(fd, create_args.handle, TEST_SIZE, 0x5A, 1) ? "错误" : "正确");
+
+out:
+	ioctl(fd, DRM_IOCTL_PDDGPU_GEM_DESTROY, &create_args);
+}
+
+/*
+ * VRAM压力下DONTNEED的BO被驱逐时丢弃内容：不断分配并写满VRAM BO，
+ * 直到再次DONTNEED报告内容已丢弃，之后WILLNEED必须返回retained=0。
+ */
+static void test_purge_under_pressure(int fd)
+{
+	struct drm_pddgpu_gem_create victim = {};
+	struct drm_pddgpu_gem_create fillers[PURGE_MAX_FILLERS] = {};
+	struct drm_pddgpu_gem_madvise madv_args = {};
+	int i, n = 0;
+
+	victim.size = TEST_SIZE;
+	victim.alignment = 4096;
+	victim.domains = PDDGPU_GEM_DOMAIN_VRAM;
+
+	if (ioctl(fd, DRM_IOCTL_PDDGPU_GEM_CREATE, &victim) < 0) {
+		perror("Failed to create GEM object");
+		return;
+	}
+
+	madv_args.handle = victim.handle;
+	madv_args.madv = PDDGPU_MADV_DONTNEED;
+	if (fill_or_check(fd, victim.handle, TEST_SIZE, 0xAA, 0) ||
+	    ioctl(fd, DRM_IOCTL_PDDGPU_GEM_MADVISE, &madv_args) < 0) {
+		perror("Failed to prepare purgeable GEM object");
+		goto out;
+	}
+
+	while (madv_args.retained && n < PURGE_MAX_FILLERS) {
+		fillers[n].size = PURGE_FILLER_SIZE;
+		fillers[n].alignment = 4096;
+		fillers[n].domains = PDDGPU_GEM_DOMAIN_VRAM;
+		if (ioctl(fd, DRM_IOCTL_PDDGPU_GEM_CREATE, &fillers[n]) < 0)
+			break;
+		n++;
+
+		/* 首次写入在缺页时放置到VRAM，必要时驱逐其他BO */
+		if (fill_or_check(fd, fillers[n - 1].handle, PURGE_FILLER_SIZE, 0x55, 0))
+			break;
+
+		/* 再次DONTNEED不改变状态，只查询内容是否仍保留 */
+		if (ioctl(fd, DRM_IOCTL_PDDGPU_GEM_MADVISE, &madv_args) < 0)
+			break;
+	}
+
+	if (madv_args.retained) {
+		printf("压力下丢弃: 分配%d个%dMB BO后仍未丢弃，跳过\n",
+		       n, PURGE_FILLER_SIZE >> 20);
+		goto out;
+	}
+
+	madv_args.madv = PDDGPU_MADV_WILLNEED;
+	if (ioctl(fd, DRM_IOCTL_PDDGPU_GEM_MADVISE, &madv_args) < 0)
+		perror("Failed to madvise GEM object");
+	else
+		printf("压力下丢弃: 分配%d个%dMB BO后丢弃，WILLNEED retained=%u（%s）\n",
+		       n, PURGE_FILLER_SIZE >> 20, madv_args.retained,
+		       madv_args.retained ? "错误" : "正确");
+
+out:
+	for (i = 0; i < n; i++)
+		ioctl(fd, DRM_IOCTL_PDDGPU_GEM_DESTROY, &fillers[i]);
+	ioctl(fd, DRM_IOCTL_PDDGPU_GEM_DESTROY, &victim);
+}
 
 int main(int argc, char *argv[])
 {
@@ -24,6 +212,10 @@ int main(int argc, char *argv[])
 	struct drm_pddgpu_gem_create create_args = {};
 	struct drm_pddgpu_gem_map map_args = {};
 	struct drm_pddgpu_gem_info info_args = {};
+	struct drm_pddgpu_gem_priority prio_args = {};
+	struct drm_pddgpu_gem_madvise madv_args = {};
+	struct drm_pddgpu_gem_prefetch prefetch_args = {};
+	struct pollfd pfd = {};
 	void *mapped_addr;
 	int ret;
 
@@ -70,6 +262,16 @@ int main(int argc, char *argv[])
 	printf("  域: 0x%x\n", info_args.domain);
 	printf("  标志: 0x%x\n", info_args.flags);
 
+	/* 设置驱逐优先级 */
+	prio_args.handle = create_args.handle;
+	prio_args.priority = PDDGPU_BO_PRIORITY_HIGH;
+
+	ret = ioctl(fd, DRM_IOCTL_PDDGPU_GEM_PRIORITY, &prio_args);
+	if (ret < 0)
+		perror("Failed to set GEM priority");
+	else
+		printf("GEM对象优先级已设置: %u\n", prio_args.priority);
+
 	/* 映射GEM对象 */
 	map_args.handle = create_args.handle;
 	map_args.offset = 0;
@@ -83,10 +285,11 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	printf("GEM对象已映射: 地址=0x%llx\n", map_args.offset);
+	printf("GEM对象已映射: mmap偏移=0x%llx\n", map_args.offset);
 
-	/* 测试写入数据 */
-	mapped_addr = (void *)map_args.offset;
+	/* 通过mmap伪偏移映射到用户空间 */
+	mapped_addr = mmap(NULL, TEST_SIZE, PROT_READ | PROT_WRITE,
+	                   MAP_SHARED, fd, map_args.offset);
 	if (mapped_addr != MAP_FAILED) {
 		/* 写入测试数据 */
 		memset(mapped_addr, 0xAA, TEST_SIZE);
@@ -99,10 +302,48 @@ int main(int argc, char *argv[])
 			printf("%02x ", data[i]);
 		}
 		printf("...\n");
+
+		munmap(mapped_addr, TEST_SIZE);
+	} else {
+		perror("Failed to mmap GEM object");
+	}
+
+	/* 标记为可丢弃，再取回并检查内容是否保留 */
+	madv_args.handle = create_args.handle;
+	madv_args.madv = PDDGPU_MADV_DONTNEED;
+
+	ret = ioctl(fd, DRM_IOCTL_PDDGPU_GEM_MADVISE, &madv_args);
+	if (ret < 0) {
+		perror("Failed to madvise GEM object");
+	} else {
+		madv_args.madv = PDDGPU_MADV_WILLNEED;
+		ret = ioctl(fd, DRM_IOCTL_PDDGPU_GEM_MADVISE, &madv_args);
+		if (ret < 0)
+			perror("Failed to madvise GEM object");
+		else
+			printf("GEM对象madvise: 内容%s\n",
+			       madv_args.retained ? "已保留" : "已丢弃");
+	}
+
+	/* 预取到VRAM并等待栅栏 */
+	prefetch_args.handles = (unsigned long)&create_args.handle;
+	prefetch_args.num_handles = 1;
+	prefetch_args.domain = PDDGPU_GEM_DOMAIN_VRAM;
+
+	ret = ioctl(fd, DRM_IOCTL_PDDGPU_GEM_PREFETCH, &prefetch_args);
+	if (ret < 0) {
+		perror("Failed to prefetch GEM object");
 	} else {
-		printf("映射地址无效\n");
+		pfd.fd = prefetch_args.fence_fd;
+		pfd.events = POLLIN;
+		ret = poll(&pfd, 1, 1000);
+		printf("GEM对象预取: %s\n", ret > 0 ? "完成" : "超时");
+		close(prefetch_args.fence_fd);
 	}
 
+	test_compress_move(fd);
+	test_purge_under_pressure(fd);
+
 	/* 清理 */
 	printf("清理资源...\n");
 	close(fd);
@@ -0,0 +1,19 @@
+/*
+ * PDDGPU BO移动基准测试
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_BENCHMARK_H__
+#define __PDDGPU_BENCHMARK_H__
+
+struct pddgpu_device;
+
+/* 测试BO大小和每个方向的移动次数 */
+#define PDDGPU_BENCHMARK_SIZE           (16 * 1024 * 1024)
+#define PDDGPU_BENCHMARK_ITERS          16
+
+/* 分别用通用实现和SIMD实现测量各个域之间的移动和清理带宽 */
+void pddgpu_benchmark(struct pddgpu_device *pdev);
+
+#endif /* __PDDGPU_BENCHMARK_H__ */
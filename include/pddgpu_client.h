@@ -0,0 +1,79 @@
+/*
+ * PDDGPU 客户端（drm_file）状态
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_CLIENT_H__
+#define __PDDGPU_CLIENT_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/kref.h>
+#include <linux/sched.h>
+
+#include <drm/ttm/ttm_placement.h>
+
+#include "pddgpu_cs.h"
+
+struct drm_device;
+struct drm_file;
+struct drm_printer;
+struct pddgpu_bo;
+struct pddgpu_device;
+struct ttm_resource;
+
+/* 按内存类型统计的区域：系统内存、GTT和VRAM */
+#define PDDGPU_CLIENT_MEM_REGIONS       (TTM_PL_VRAM + 1)
+
+/* 一个区域中归属于客户端的BO字节数 */
+struct pddgpu_client_mem {
+	atomic64_t total;
+	atomic64_t shared;              /* 有其他句柄或已导出为dma-buf */
+	atomic64_t purgeable;           /* 标记为DONTNEED */
+};
+
+/* 每个打开的设备文件一个，BO持有创建者的引用，文件关闭后统计仍可更新 */
+struct pddgpu_fpriv {
+	struct kref refcount;
+	struct pddgpu_device *pdev;
+	pid_t pid;
+	char comm[TASK_COMM_LEN];
+
+	/* 抖动统计 */
+	atomic64_t thrash_moves;        /* 在两个域之间往返的移动次数 */
+	atomic64_t thrash_bytes;        /* 往返移动搬移的字节数 */
+	atomic64_t thrash_holds;        /* 触发回退窗口的次数 */
+	atomic64_t thrash_demotions;    /* 被永久移出VRAM的BO数 */
+
+	/* 移动配额 */
+	struct pddgpu_move_budget move_budget;
+	atomic64_t moved_bytes;         /* 计入配额的移动字节数 */
+	atomic64_t moves_throttled;     /* 因配额耗尽接受非首选放置的次数 */
+
+	/* 内存统计，BO计入创建者，在分配、移动和释放时增量更新 */
+	struct pddgpu_client_mem mem[PDDGPU_CLIENT_MEM_REGIONS];
+	atomic64_t visible_vram;        /* 位于CPU可见VRAM中的字节数 */
+	atomic64_t evicted_vram;        /* 首选VRAM但不在VRAM中的字节数 */
+};
+
+/* DRM文件打开和关闭 */
+int pddgpu_driver_open(struct drm_device *dev, struct drm_file *file);
+void pddgpu_driver_postclose(struct drm_device *dev, struct drm_file *file);
+
+/* fdinfo输出 */
+void pddgpu_show_fdinfo(struct drm_printer *p, struct drm_file *file);
+
+/*
+ * 按BO当前的资源更新创建者的内存统计，res为NULL表示BO不再占用内存。
+ * 调用者需持有BO预留锁，BO释放时除外。
+ */
+void pddgpu_client_bo_update(struct pddgpu_bo *bo, struct ttm_resource *res);
+/* 句柄打开、关闭或导出后更新共享状态，shared为变化后的状态 */
+void pddgpu_client_bo_set_shared(struct pddgpu_bo *bo, bool shared);
+
+/* 引用计数 */
+struct pddgpu_fpriv *pddgpu_fpriv_get(struct pddgpu_fpriv *fpriv);
+void pddgpu_fpriv_put(struct pddgpu_fpriv *fpriv);
+
+#endif /* __PDDGPU_CLIENT_H__ */
@@ -0,0 +1,77 @@
+/*
+ * PDDGPU 系统内存BO压缩
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_COMPRESS_H__
+#define __PDDGPU_COMPRESS_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
+struct crypto_comp;
+struct page;
+struct drm_printer;
+struct pddgpu_device;
+
+/* 每个BO抽样压缩的页数 */
+#define PDDGPU_COMPRESS_SAMPLE_PAGES    8
+/* 每轮最多压缩的页数，4K页时为64MB */
+#define PDDGPU_COMPRESS_BATCH_PAGES     (16384UL)
+
+/* 一页的压缩数据，len为0表示全零页，等于PAGE_SIZE表示原样保存 */
+struct pddgpu_compress_page {
+	void *data;
+	u32 len;
+};
+
+/* 一个ttm_tt的压缩副本，按页压缩，解压时逐页写回 */
+struct pddgpu_compressed {
+	pgoff_t num_pages;
+	size_t stored;                  /* 压缩数据占用的字节数 */
+	struct pddgpu_compress_page pages[];
+};
+
+/*
+ * 设备压缩状态。后台工作函数把空闲较久的系统内存BO压缩保存并释放页面，
+ * 位于系统内存和换出之间；验证或缺页时按需解压。
+ */
+struct pddgpu_compress {
+	struct crypto_comp *tfm;        /* 为空时压缩层关闭 */
+	struct mutex lock;              /* 保护tfm和scratch */
+	void *scratch;                  /* 单页压缩输出 */
+	struct delayed_work work;       /* 在后台回收队列上运行 */
+
+	/* 统计信息 */
+	atomic64_t compressions;
+	atomic64_t compressed_bytes;    /* 压缩前的累计字节数 */
+	atomic64_t compress_ns;         /* 压缩和抽样的累计CPU时间 */
+	atomic64_t decompressions;
+	atomic64_t decompressed_bytes;
+	atomic64_t decompress_ns;
+	atomic64_t incompressible;      /* 抽样后跳过的BO数 */
+	atomic64_t zero_pages;          /* 全零页数 */
+	atomic64_t resident_bytes;      /* 当前压缩保存的BO的原始大小 */
+	atomic64_t stored_bytes;        /* 当前压缩数据占用的字节数 */
+};
+
+/* 初始化和清理，依赖后台回收队列，算法不可用时压缩层关闭 */
+void pddgpu_compress_init(struct pddgpu_device *pdev);
+void pddgpu_compress_fini(struct pddgpu_device *pdev);
+
+/* 压缩、解压和释放ttm_tt页面的副本 */
+struct pddgpu_compressed *pddgpu_compress_pages(struct pddgpu_device *pdev,
+                                                struct page **pages,
+                                                pgoff_t num_pages);
+int pddgpu_decompress_pages(struct pddgpu_device *pdev,
+                            struct pddgpu_compressed *c, struct page **pages);
+void pddgpu_compressed_free(struct pddgpu_device *pdev, struct pddgpu_compressed *c);
+
+/* 调试接口 */
+void pddgpu_compress_debug_print(struct pddgpu_device *pdev,
+                                 struct drm_printer *p);
+
+#endif /* __PDDGPU_COMPRESS_H__ */
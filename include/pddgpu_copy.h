@@ -0,0 +1,118 @@
+/*
+ * PDDGPU 软件复制引擎
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_COPY_H__
+#define __PDDGPU_COPY_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+
+#include <drm/ttm/ttm_bo.h>
+
+struct drm_printer;
+struct pddgpu_device;
+struct pddgpu_copy_worker;
+struct ttm_buffer_object;
+struct ttm_resource;
+
+/* 分块大小的下限，太小的分块调度开销超过并行收益 */
+#define PDDGPU_COPY_MIN_CHUNK_PAGES     16
+/* 工作线程数上限 */
+#define PDDGPU_COPY_MAX_WORKERS         16
+/* 一批最多合并的小移动数 */
+#define PDDGPU_COPY_MAX_BATCH           16
+
+/* 移动优先级，数值越小越先调度 */
+enum pddgpu_move_prio {
+	PDDGPU_MOVE_PRIO_INLINE = 0,    /* 分配路径上的放置及其引起的驱逐 */
+	PDDGPU_MOVE_PRIO_FAULT,         /* CPU缺页触发的迁移 */
+	PDDGPU_MOVE_PRIO_PREFETCH,      /* 用户态预取提示 */
+	PDDGPU_MOVE_PRIO_BACKGROUND,    /* 后台分层和回收 */
+	PDDGPU_MOVE_PRIO_COUNT,
+};
+
+/*
+ * 带移动优先级的操作上下文。调用者把base交给ttm_bo_validate()，这次验证
+ * 引起的移动以及为腾出空间而驱逐其他BO的移动都按prio调度。
+ * 优先级属于这次调用而不是BO，其他上下文发起的移动按INLINE调度。
+ */
+struct pddgpu_move_ctx {
+	struct ttm_operation_ctx base;
+	enum pddgpu_move_prio prio;
+	struct list_head node;          /* 引擎的活动上下文链表 */
+};
+
+/* 每个优先级一个运行队列 */
+struct pddgpu_copy_queue {
+	struct list_head jobs;          /* 依赖已满足、仍有分块未取走的作业 */
+	u32 depth;                      /* 排队的作业数，受引擎锁保护 */
+
+	/* 统计信息 */
+	atomic64_t submitted;
+	atomic64_t completed;
+	atomic64_t latency_ns;          /* 提交到完成的累计时间 */
+	atomic64_t max_latency_ns;
+};
+
+/*
+ * 设备复制引擎，用CPU工作线程池代替DMA引擎执行BO移动。
+ * 大移动按分块取走，工作线程每复制完一块就重新挑选最高优先级的工作，
+ * 高优先级的移动不必等低优先级的大移动复制完。
+ */
+struct pddgpu_copy_engine {
+	struct workqueue_struct *wq;    /* 无绑定工作队列，工作线程在多个CPU上并行复制 */
+	struct pddgpu_copy_worker *workers;
+	u32 num_workers;
+
+	spinlock_t lock;                /* 保护运行队列，会在栅栏回调中获取 */
+	struct pddgpu_copy_queue queues[PDDGPU_MOVE_PRIO_COUNT];
+	atomic_t inflight;              /* 已提交未完成的作业数 */
+	wait_queue_head_t idle;
+
+	spinlock_t fence_lock;           /* 作业栅栏共用的锁，每个作业有自己的栅栏上下文 */
+
+	spinlock_t ctx_lock;             /* 保护活动的移动上下文链表 */
+	struct list_head ctxs;
+
+	/* 统计信息 */
+	atomic64_t jobs;
+	atomic64_t chunks;
+	atomic64_t batches;             /* 合并复制的小移动批次 */
+	atomic64_t bytes;
+	atomic64_t errors;              /* 提交后资源切换失败、回退到同步复制的次数 */
+};
+
+/* 初始化和清理 */
+int pddgpu_copy_init(struct pddgpu_device *pdev);
+void pddgpu_copy_fini(struct pddgpu_device *pdev);
+
+/* 登记和注销带优先级的操作上下文，登记期间由该上下文发起的移动按prio调度 */
+void pddgpu_move_ctx_begin(struct pddgpu_device *pdev, struct pddgpu_move_ctx *mctx,
+                           enum pddgpu_move_prio prio);
+void pddgpu_move_ctx_end(struct pddgpu_device *pdev, struct pddgpu_move_ctx *mctx);
+
+/*
+ * 异步移动BO，按ctx登记的优先级调度，成功时已通过
+ * ttm_bo_move_accel_cleanup()完成资源切换
+ */
+int pddgpu_move_blit(struct ttm_buffer_object *bo, bool evict,
+                     struct ttm_operation_ctx *ctx,
+                     struct ttm_resource *new_mem,
+                     struct ttm_resource *old_mem);
+
+/* 同步CPU复制移动，不适用时返回-EAGAIN */
+int pddgpu_copy_sync(struct ttm_buffer_object *bo, struct ttm_operation_ctx *ctx,
+                     struct ttm_resource *new_mem);
+
+/* 调试接口 */
+void pddgpu_copy_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p);
+
+#endif /* __PDDGPU_COPY_H__ */
@@ -0,0 +1,66 @@
+/*
+ * PDDGPU 缓冲区移动配额
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_CS_H__
+#define __PDDGPU_CS_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/spinlock.h>
+
+struct drm_printer;
+struct pddgpu_device;
+struct pddgpu_fpriv;
+
+/* 配额最多积攒的时间片，与amdgpu相同取200ms */
+#define PDDGPU_MOVE_BUDGET_SLICE_US     200000
+/* 尚未测得复制带宽时使用的初始值 */
+#define PDDGPU_MOVE_DEFAULT_MBPS        1024
+
+/*
+ * 移动配额：以可用复制时间计，随时间流逝补充，移动后按测得带宽扣除。
+ * 可以透支，透支期间只有随时间偿还后才允许再次移动。
+ */
+struct pddgpu_move_budget {
+	spinlock_t lock;
+	s64 last_update_us;
+	s64 accum_us;                   /* 累积的可用复制时间 */
+	s64 accum_us_vis;               /* 其中可用于CPU可见VRAM的部分 */
+};
+
+/* 设备移动统计 */
+struct pddgpu_mm_stats {
+	struct pddgpu_move_budget budget;
+	u32 log2_max_MBps;              /* 复制带宽的对数，MB/s约等于字节/微秒 */
+	u32 measured_MBps;              /* 测得带宽的滑动平均 */
+
+	/* 统计信息 */
+	atomic64_t throttled;           /* 因配额耗尽接受非首选放置的验证次数 */
+	atomic64_t reported_bytes;      /* 计入配额的移动字节数 */
+};
+
+/* 初始化 */
+void pddgpu_cs_mm_stats_init(struct pddgpu_device *pdev);
+void pddgpu_cs_budget_init(struct pddgpu_move_budget *budget, bool full);
+
+/* 配额查询和扣除，fpriv为NULL时只计入设备配额 */
+void pddgpu_cs_get_threshold_for_moves(struct pddgpu_device *pdev,
+                                       struct pddgpu_fpriv *fpriv,
+                                       u64 *max_bytes, u64 *max_vis_bytes);
+void pddgpu_cs_report_moved_bytes(struct pddgpu_device *pdev,
+                                  struct pddgpu_fpriv *fpriv,
+                                  u64 num_bytes, u64 num_vis_bytes);
+void pddgpu_cs_note_throttled(struct pddgpu_device *pdev,
+                              struct pddgpu_fpriv *fpriv);
+
+/* CPU复制完成后采样带宽 */
+void pddgpu_cs_note_copy(struct pddgpu_device *pdev, u64 bytes, s64 us);
+
+/* 调试接口 */
+void pddgpu_cs_debug_print(struct pddgpu_device *pdev,
+                           struct drm_printer *p);
+
+#endif /* __PDDGPU_CS_H__ */
@@ -32,6 +32,8 @@
 #include <linux/mutex.h>
 #include <linux/list.h>
 #include <linux/atomic.h>
+#include <linux/workqueue.h>
+#include <linux/dma-fence.h>
 
 #include <drm/drm_gem.h>
 #include <drm/ttm/ttm_bo.h>
@@ -39,6 +41,20 @@
 #include <drm/ttm/ttm_resource.h>
 
 #include "pddgpu_regs.h"
+#include "pddgpu_kmap_cache.h"
+#include "pddgpu_evict.h"
+#include "pddgpu_thrash.h"
+#include "pddgpu_client.h"
+#include "pddgpu_reclaim.h"
+#include "pddgpu_tier.h"
+#include "pddgpu_cs.h"
+#include "pddgpu_copy.h"
+#include "pddgpu_memcpy.h"
+#include "pddgpu_benchmark.h"
+#include "pddgpu_pool.h"
+#include "pddgpu_swap.h"
+#include "pddgpu_compress.h"
+#include "pddgpu_prefetch.h"
 
 /* 内存泄漏监控宏 */
 #define PDDGPU_MEMORY_LEAK_MONITOR_ENABLED 1
@@ -114,7 +130,21 @@ struct pddgpu_device {
 		struct ttm_resource_manager *man[TTM_NUM_MEM_TYPES];
 		struct pddgpu_vram_mgr *vram_mgr;
 		struct pddgpu_gtt_mgr gtt_mgr;
+		struct pddgpu_kmap_cache kmap_cache;
+		struct pddgpu_evict_state evict;
+		struct pddgpu_reclaim reclaim;
+		struct pddgpu_tier tier;
+		struct pddgpu_mm_stats mm_stats;
+		struct pddgpu_copy_engine copy;
+		struct pddgpu_page_pool pool;
+		struct pddgpu_swap swap;
+		struct pddgpu_compress compress;
+		struct pddgpu_prefetch prefetch;
 		bool buffer_funcs_enabled;
+		
+		/* 异步BO创建 */
+		struct workqueue_struct *bo_create_wq;
+		spinlock_t bo_create_fence_lock;
 	} mman;
 	
 	/* 图形内存控制器 */
@@ -172,6 +202,52 @@ struct pddgpu_device {
 			atomic64_t debug_evictions;
 		} debug;
 		
+		/* CPU缺页统计 */
+		struct {
+			atomic64_t faults;          /* 缺页处理次数 */
+			atomic64_t pmd_faults;      /* PMD大页映射次数 */
+			atomic64_t pud_faults;      /* PUD大页映射次数 */
+			atomic64_t bytes_mapped;    /* 缺页映射的总字节数 */
+		} fault;
+		
+		/* BO抖动统计 */
+		struct {
+			atomic64_t moves;           /* 在两个域之间往返的移动次数 */
+			atomic64_t bytes;           /* 往返移动搬移的字节数 */
+			atomic64_t holds;           /* 触发回退窗口的次数 */
+			atomic64_t demotions;       /* 被永久移出VRAM的BO数 */
+		} thrash;
+		
+		/* BO移动路径统计 */
+		struct {
+			atomic64_t copies;          /* 复制数据的移动次数 */
+			atomic64_t copy_bytes;
+			atomic64_t zero_copy;       /* 只改变GART绑定的移动次数 */
+			atomic64_t zero_copy_bytes;
+		} move;
+		
+		/* GART绑定统计 */
+		struct {
+			atomic64_t binds;
+			atomic64_t frags;           /* 绑定划分出的映射片段数 */
+			atomic64_t huge_frags;      /* 其中可用一个2MB表项映射的片段数 */
+			atomic64_t dma_maps;        /* ttm_tt的DMA映射次数 */
+			atomic64_t dma_segments;    /* 映射后的DMA段数 */
+		} gart;
+		
+		/* 稀疏BO统计 */
+		struct {
+			atomic64_t size;            /* 稀疏ttm_tt的总大小 */
+			atomic64_t populated;       /* 其中已填充的字节数 */
+			atomic64_t zero_maps;       /* 读缺页映射零页的次数 */
+		} sparse;
+		
+		/* 可清除BO统计 */
+		struct {
+			atomic64_t purges;          /* 丢弃后备存储的次数 */
+			atomic64_t bytes;           /* 丢弃的字节数 */
+		} purge;
+		
 #if PDDGPU_MEMORY_LEAK_MONITOR_ENABLED
 		/* 内存泄漏监控工作队列 */
 		struct {
@@ -185,6 +261,9 @@ struct pddgpu_device {
 
 };
 
+/* sg表中单个段的最大长度 */
+#define PDDGPU_MAX_SG_SEGMENT_SIZE	(2UL << 30)
+
 /* PDDGPU BO */
 struct pddgpu_bo {
 	struct ttm_buffer_object tbo;
@@ -239,6 +318,22 @@ struct pddgpu_bo_param {
 #define PDDGPU_GEM_CREATE_VRAM_CLEARED       (1 << 4)
 #define PDDGPU_GEM_CREATE_VM_ALWAYS_VALID    (1 << 5)
 #define PDDGPU_GEM_CREATE_EXPLICIT_SYNC      (1 << 6)
+#define PDDGPU_GEM_CREATE_LAZY_PLACEMENT     (1 << 7)  /* 首次使用时才分配后备存储 */
+#define PDDGPU_GEM_CREATE_ASYNC              (1 << 8)  /* 放置、清理和填充在后台完成 */
+#define PDDGPU_GEM_CREATE_SPARSE             (1 << 9)  /* 系统内存和GTT页面在CPU首次写入时才分配 */
+#define PDDGPU_GEM_CREATE_CPU_GTT_USWC       (1 << 10) /* GTT页面写合并，适合CPU流式写入 */
+#define PDDGPU_GEM_CREATE_CPU_GTT_UNCACHED   (1 << 11) /* GTT页面不可缓存；两者都不设时可缓存，适合CPU回读 */
+#define PDDGPU_GEM_CREATE_VRAM_CONTIGUOUS    (1 << 12) /* VRAM物理连续，只对内核BO生效 */
+
+/* PDDGPU BO驱逐优先级，映射到TTM LRU优先级，数值越小越先被驱逐 */
+#define PDDGPU_BO_PRIORITY_BATCH     0  /* 批处理和暂存缓冲区 */
+#define PDDGPU_BO_PRIORITY_NORMAL    1  /* 用户BO默认优先级 */
+#define PDDGPU_BO_PRIORITY_HIGH      2
+#define PDDGPU_BO_PRIORITY_CRITICAL  3  /* 延迟关键，内存压力下保持驻留 */
+
+/* PDDGPU BO madvise状态 */
+#define PDDGPU_MADV_WILLNEED     0  /* 内容需要保留 */
+#define PDDGPU_MADV_DONTNEED     1  /* 内存压力下可以直接丢弃后备存储 */
 
 /* PDDGPU GEM创建参数 */
 struct drm_pddgpu_gem_create {
@@ -269,16 +364,45 @@ struct drm_pddgpu_gem_info {
 	__u32 flags;
 };
 
+/* PDDGPU GEM优先级参数 */
+struct drm_pddgpu_gem_priority {
+	__u32 handle;
+	__u32 priority;
+};
+
+/* PDDGPU GEM madvise参数 */
+struct drm_pddgpu_gem_madvise {
+	__u32 handle;
+	__u32 madv;
+	__u32 retained;    /* 返回：为0表示后备存储已被丢弃，内容需要重新生成 */
+	__u32 pad;
+};
+
+/* PDDGPU GEM预取参数 */
+struct drm_pddgpu_gem_prefetch {
+	__u64 handles;     /* 指向__u32句柄数组 */
+	__u32 num_handles;
+	__u32 domain;      /* 目标域，只能指定一个 */
+	__u32 flags;
+	__s32 fence_fd;    /* 返回：全部迁移完成后发出信号的sync_file */
+};
+
 /* IOCTL定义 */
 #define DRM_PDDGPU_GEM_CREATE    0x00
 #define DRM_PDDGPU_GEM_MAP       0x01
 #define DRM_PDDGPU_GEM_INFO      0x02
 #define DRM_PDDGPU_GEM_DESTROY   0x03
+#define DRM_PDDGPU_GEM_PRIORITY  0x04
+#define DRM_PDDGPU_GEM_MADVISE   0x05
+#define DRM_PDDGPU_GEM_PREFETCH  0x06
 
 #define DRM_IOCTL_PDDGPU_GEM_CREATE  DRM_IOWR(DRM_COMMAND_BASE + DRM_PDDGPU_GEM_CREATE, struct drm_pddgpu_gem_create)
 #define DRM_IOCTL_PDDGPU_GEM_MAP     DRM_IOWR(DRM_COMMAND_BASE + DRM_PDDGPU_GEM_MAP, struct drm_pddgpu_gem_map)
 #define DRM_IOCTL_PDDGPU_GEM_INFO    DRM_IOWR(DRM_COMMAND_BASE + DRM_PDDGPU_GEM_INFO, struct drm_pddgpu_gem_info)
 #define DRM_IOCTL_PDDGPU_GEM_DESTROY DRM_IOW(DRM_COMMAND_BASE + DRM_PDDGPU_GEM_DESTROY, struct drm_pddgpu_gem_create)
+#define DRM_IOCTL_PDDGPU_GEM_PRIORITY DRM_IOW(DRM_COMMAND_BASE + DRM_PDDGPU_GEM_PRIORITY, struct drm_pddgpu_gem_priority)
+#define DRM_IOCTL_PDDGPU_GEM_MADVISE DRM_IOWR(DRM_COMMAND_BASE + DRM_PDDGPU_GEM_MADVISE, struct drm_pddgpu_gem_madvise)
+#define DRM_IOCTL_PDDGPU_GEM_PREFETCH DRM_IOWR(DRM_COMMAND_BASE + DRM_PDDGPU_GEM_PREFETCH, struct drm_pddgpu_gem_prefetch)
 
 /* 转换宏 */
 static inline struct pddgpu_device *pdev_to_drm(struct pddgpu_device *pdev)
@@ -302,6 +426,41 @@ static inline struct pddgpu_device *drm_to_pdev(struct drm_device *ddev)
 #define PDDGPU_INFO(fmt, ...) pr_info("PDDGPU: " fmt, ##__VA_ARGS__)
 #define PDDGPU_ERROR(fmt, ...) pr_err("PDDGPU: " fmt, ##__VA_ARGS__)
 
+/* 模块参数 */
+extern int pddgpu_mmap_prefault;
+extern int pddgpu_kmap_cache_size;
+extern int pddgpu_evict_scan_depth;
+extern int pddgpu_evict_max_skip;
+extern int pddgpu_evict_weight_move;
+extern int pddgpu_evict_weight_fence;
+extern int pddgpu_evict_weight_reuse;
+extern int pddgpu_thrash_window_ms;
+extern int pddgpu_thrash_flips;
+extern int pddgpu_thrash_backoff_ms;
+extern int pddgpu_thrash_demote_strikes;
+extern int pddgpu_reclaim_low_pct;
+extern int pddgpu_reclaim_high_pct;
+extern int pddgpu_reclaim_rate_mb;
+extern int pddgpu_reclaim_interval_ms;
+extern int pddgpu_reclaim_min_age_ms;
+extern int pddgpu_tier_interval_ms;
+extern int pddgpu_tier_hot_threshold;
+extern int pddgpu_tier_half_life_ms;
+extern int pddgpu_tier_migrate_mb_per_sec;
+extern int pddgpu_moverate;
+extern int pddgpu_copy_chunk_kb;
+extern int pddgpu_simd_copy;
+extern int pddgpu_benchmark;
+extern int pddgpu_pool_max_mb;
+extern int pddgpu_pool_prewarm_mb;
+extern int pddgpu_huge_tt;
+extern int pddgpu_populate_parallel_mb;
+extern int pddgpu_sparse_chunk_kb;
+extern int pddgpu_swap_min_age_ms;
+extern int pddgpu_compress_interval_ms;
+extern int pddgpu_compress_min_age_ms;
+extern char *pddgpu_compress_alg;
+
 /* 常量定义 */
 #define PDDGPU_VM_RESERVED_VRAM (256 * 1024 * 1024)  // 256MB 保留VRAM
 #define PDDGPU_BO_INVALID_OFFSET 0xffffffffffffffff
@@ -331,14 +490,41 @@ void pddgpu_ttm_fini(struct pddgpu_device *pdev);
 int pddgpu_ttm_pools_init(struct pddgpu_device *pdev);
 void pddgpu_ttm_pools_fini(struct pddgpu_device *pdev);
 void pddgpu_bo_placement_from_domain(struct pddgpu_bo *abo, u32 domain);
+int pddgpu_ttm_clear_buffer(struct pddgpu_bo *bo, struct dma_resv *resv,
+                            struct dma_fence **fence);
+void pddgpu_ttm_fill(void *ptr, bool is_iomem, u8 value, size_t size);
+int pddgpu_ttm_sparse_populate(struct ttm_buffer_object *bo, pgoff_t start,
+                               pgoff_t num_pages);
+bool pddgpu_ttm_swappable(struct ttm_buffer_object *bo);
+int pddgpu_ttm_swapout(struct pddgpu_bo *abo, gfp_t gfp);
+int pddgpu_ttm_compress(struct pddgpu_bo *abo);
+int pddgpu_ttm_purge(struct pddgpu_bo *abo, struct ttm_operation_ctx *ctx);
+extern const struct vm_operations_struct pddgpu_ttm_vm_ops;
+extern const struct vm_operations_struct pddgpu_ttm_sparse_vm_ops;
+
+/* GEM函数声明 */
+int pddgpu_mmap(struct file *filp, struct vm_area_struct *vma);
+int pddgpu_gem_priority_ioctl(struct drm_device *dev, void *data,
+                              struct drm_file *filp);
+int pddgpu_gem_madvise_ioctl(struct drm_device *dev, void *data,
+                             struct drm_file *filp);
+int pddgpu_gem_prefetch_ioctl(struct drm_device *dev, void *data,
+                              struct drm_file *filp);
 
 /* VRAM管理器函数 */
 int pddgpu_vram_mgr_init(struct pddgpu_device *pdev);
 void pddgpu_vram_mgr_fini(struct pddgpu_device *pdev);
+u64 pddgpu_vram_mgr_res_addr(struct ttm_resource *res, u64 offset, u64 *contig);
+u64 pddgpu_vram_mgr_res_visible_size(struct pddgpu_device *pdev,
+                                     struct ttm_resource *res);
 
 /* GTT管理器函数 */
 int pddgpu_gtt_mgr_init(struct pddgpu_device *pdev, uint64_t gtt_size);
 void pddgpu_gtt_mgr_fini(struct pddgpu_device *pdev);
 void pddgpu_gtt_mgr_recover(struct pddgpu_gtt_mgr *mgr);
 
+/* debugfs */
+struct drm_minor;
+void pddgpu_debugfs_init(struct drm_minor *minor);
+
 #endif /* __PDDGPU_DRV_H__ */
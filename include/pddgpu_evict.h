@@ -0,0 +1,70 @@
+/*
+ * PDDGPU 驱逐代价评估
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_EVICT_H__
+#define __PDDGPU_EVICT_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+
+#include <drm/ttm/ttm_placement.h>
+#include <drm/ttm/ttm_resource.h>
+
+struct drm_printer;
+struct pddgpu_device;
+struct pddgpu_bo;
+
+/* 代价模型常量 */
+#define PDDGPU_EVICT_BUSY_NS            (2 * NSEC_PER_MSEC)   /* 等待未完成栅栏的代价 */
+#define PDDGPU_EVICT_HOT_WINDOW_NS      (100 * NSEC_PER_MSEC) /* 再次使用概率的衰减窗口 */
+#define PDDGPU_EVICT_UNBIND_NS_PER_PAGE 50                    /* 无需复制时的解绑代价 */
+#define PDDGPU_EVICT_MIN_GAIN_PCT       25                    /* 换选其他候选的最低收益 */
+
+/* 单个候选BO的驱逐代价明细，单位均为纳秒 */
+struct pddgpu_evict_cost {
+	u64 move_ns;                    /* 按目标域带宽估算的搬移耗时 */
+	u64 fence_ns;                   /* 等待未完成栅栏的代价 */
+	u64 reuse_ns;                   /* 近期使用过的BO被再次换入的预期代价 */
+	u64 score;                      /* 加权总代价 */
+	u64 score_per_mb;               /* 每释放1MB的代价，候选之间按此比较 */
+};
+
+/*
+ * 每个内存类型的驱逐遍历状态。跳过当前候选前会在同一优先级LRU上向后查找
+ * 本轮遍历还会访问到的更便宜候选，连续跳过次数另有上限，防止查找之后
+ * 被其他线程锁住或移走的参照让遍历一直落空。
+ */
+struct pddgpu_evict_walk {
+	atomic_t skip_streak;           /* 连续跳过的候选数，保证驱逐总能推进 */
+};
+
+/* 设备驱逐状态 */
+struct pddgpu_evict_state {
+	struct pddgpu_evict_walk walk[TTM_NUM_MEM_TYPES];
+
+	/* 统计信息 */
+	atomic64_t scored;
+	atomic64_t accepted;
+	atomic64_t skipped;             /* 因存在更便宜的候选而跳过 */
+	atomic64_t forced;              /* 达到跳过上限后强制接受 */
+	atomic64_t cost_total_ns;       /* 已接受候选的代价总和 */
+	atomic64_t bytes_evicted;
+};
+
+/* 初始化 */
+void pddgpu_evict_init(struct pddgpu_device *pdev);
+
+/* 代价评估，调用者需持有BO预留锁或LRU锁 */
+void pddgpu_evict_score(struct pddgpu_bo *bo, struct pddgpu_evict_cost *cost);
+
+/* 判断候选是否是当前最划算的驱逐对象 */
+bool pddgpu_evict_valuable(struct pddgpu_bo *bo, const struct ttm_place *place);
+
+/* 调试接口 */
+void pddgpu_evict_debug_print(struct pddgpu_device *pdev,
+                              struct drm_printer *p);
+
+#endif /* __PDDGPU_EVICT_H__ */
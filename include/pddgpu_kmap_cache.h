@@ -0,0 +1,71 @@
+/*
+ * PDDGPU 内核映射缓存
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_KMAP_CACHE_H__
+#define __PDDGPU_KMAP_CACHE_H__
+
+#include <linux/types.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/atomic.h>
+#include <linux/shrinker.h>
+
+#include <drm/ttm/ttm_bo.h>
+
+struct drm_printer;
+struct pddgpu_device;
+struct pddgpu_bo;
+
+/* 缓存的内核映射 */
+struct pddgpu_kmap_entry {
+	struct list_head bo_link;       /* 挂在BO的映射链表上 */
+	struct list_head lru;           /* 空闲时挂在设备LRU上 */
+	struct pddgpu_bo *bo;
+	unsigned long start_page;       /* 映射起始页（BO内偏移） */
+	unsigned long num_pages;        /* 映射页数 */
+	struct ttm_bo_kmap_obj map;
+	void *vaddr;
+	bool is_iomem;
+	bool pfn_mapped;                /* 不连续VRAM经vmap_pfn()拼接映射 */
+	bool stale;                     /* BO已移动，最后一个引用释放时拆除 */
+	unsigned int ref_count;         /* 受cache->lock保护 */
+	u64 last_use;
+};
+
+/* 设备内核映射缓存 */
+struct pddgpu_kmap_cache {
+	struct mutex lock;
+	struct list_head lru;           /* 空闲映射，表头最久未使用 */
+	u64 mapped_bytes;               /* 当前保留的映射总量 */
+	u64 idle_bytes;                 /* 其中空闲可回收的部分 */
+	u64 max_bytes;                  /* 映射总量上限 */
+	struct shrinker *shrinker;
+
+	/* 统计信息 */
+	atomic64_t hits;
+	atomic64_t misses;
+	atomic64_t evictions;
+	atomic64_t invalidations;
+};
+
+/* 初始化和清理 */
+int pddgpu_kmap_cache_init(struct pddgpu_device *pdev);
+void pddgpu_kmap_cache_fini(struct pddgpu_device *pdev);
+
+/* 映射获取和释放，调用者需持有BO预留锁 */
+int pddgpu_kmap_cache_get(struct pddgpu_bo *bo, unsigned long start_page,
+                          unsigned long num_pages, void **ptr, bool *is_iomem);
+void pddgpu_kmap_cache_put(struct pddgpu_bo *bo, void *ptr);
+
+/* BO移动和销毁时使映射失效 */
+void pddgpu_kmap_cache_invalidate(struct pddgpu_bo *bo);
+void pddgpu_kmap_cache_bo_fini(struct pddgpu_bo *bo);
+
+/* 调试接口 */
+void pddgpu_kmap_cache_debug_print(struct pddgpu_device *pdev,
+                                   struct drm_printer *p);
+
+#endif /* __PDDGPU_KMAP_CACHE_H__ */
@@ -0,0 +1,35 @@
+/*
+ * PDDGPU 非临时SIMD复制和填充
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_MEMCPY_H__
+#define __PDDGPU_MEMCPY_H__
+
+#include <linux/types.h>
+
+struct iosys_map;
+
+/* 一次关抢占的SIMD段最多处理的字节数 */
+#define PDDGPU_SIMD_MAX_BYTES           (64 * 1024)
+
+/* 按CPU特性选择的实现 */
+enum pddgpu_memcpy_impl {
+	PDDGPU_MEMCPY_GENERIC = 0,
+	PDDGPU_MEMCPY_SSE41,
+	PDDGPU_MEMCPY_AVX2,
+	PDDGPU_MEMCPY_NEON,
+	PDDGPU_MEMCPY_COUNT,
+};
+
+/* 模块加载时检测CPU特性 */
+void pddgpu_memcpy_init(void);
+enum pddgpu_memcpy_impl pddgpu_memcpy_get_impl(void);
+const char *pddgpu_memcpy_impl_name(enum pddgpu_memcpy_impl impl);
+
+/* 复制和填充，WC/IO内存使用非临时访问，不满足条件时回退到通用实现 */
+void pddgpu_memcpy(struct iosys_map *dst, const struct iosys_map *src, size_t len);
+void pddgpu_memset(void *ptr, bool is_iomem, u8 value, size_t len);
+
+#endif /* __PDDGPU_MEMCPY_H__ */
@@ -16,6 +16,7 @@
 #include <linux/rwsem.h> /* 读写锁 */
 #include <linux/sched.h> /* pid_t */
 
+struct drm_printer;
 struct pddgpu_device;
 struct pddgpu_bo;
 
@@ -80,6 +81,28 @@ struct pddgpu_memory_stats_info {
 	u64 avg_allocation_time;
 	u64 avg_deallocation_time;
 	u64 avg_move_time;
+	u64 mmap_faults;
+	u64 mmap_huge_faults;
+	u64 mmap_bytes_mapped;
+	u64 mmap_faults_per_mb;     /* 每MB映射的缺页次数 (x1000) */
+	u64 thrash_moves;
+	u64 thrash_bytes;
+	u64 thrash_holds;
+	u64 thrash_demotions;
+	u64 move_copies;
+	u64 move_copy_bytes;
+	u64 move_zero_copy;
+	u64 move_zero_copy_bytes;
+	u64 gart_binds;
+	u64 gart_frags;
+	u64 gart_huge_frags;
+	u64 gart_dma_maps;
+	u64 gart_dma_segments;
+	u64 sparse_size;
+	u64 sparse_populated;
+	u64 sparse_zero_maps;
+	u64 purges;
+	u64 purged_bytes;
 };
 
 /* 内存统计模块初始化 */
@@ -106,6 +129,10 @@ void pddgpu_memory_stats_move_start(struct pddgpu_device *pdev,
 void pddgpu_memory_stats_move_end(struct pddgpu_device *pdev, 
                                   struct pddgpu_bo *bo);
 
+/* CPU缺页统计 */
+void pddgpu_memory_stats_fault(struct pddgpu_device *pdev, u64 bytes,
+                               unsigned int order);
+
 /* 内存泄漏检测 */
 void pddgpu_memory_stats_leak_check(struct pddgpu_device *pdev);
 void pddgpu_memory_stats_leak_report(struct pddgpu_device *pdev);
@@ -119,7 +146,8 @@ void pddgpu_memory_stats_get_info(struct pddgpu_device *pdev,
                                   struct pddgpu_memory_stats_info *info);
 
 /* 调试接口 */
-void pddgpu_memory_stats_debug_print(struct pddgpu_device *pdev);
+void pddgpu_memory_stats_debug_print(struct pddgpu_device *pdev,
+                                     struct drm_printer *p);
 void pddgpu_memory_stats_reset(struct pddgpu_device *pdev);
 
 /* 内存泄漏检测配置 */
@@ -0,0 +1,85 @@
+/*
+ * PDDGPU TTM页面池
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_POOL_H__
+#define __PDDGPU_POOL_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
+#include <linux/mm.h>
+
+#include <drm/ttm/ttm_caching.h>
+#include <drm/ttm/ttm_tt.h>
+
+struct device;
+struct drm_printer;
+struct pddgpu_device;
+struct ttm_operation_ctx;
+
+/* 池中最大的块，4K页时为2MB，以复合页分配 */
+#define PDDGPU_POOL_MAX_ORDER           9
+#define PDDGPU_POOL_HUGE_ORDER          PDDGPU_POOL_MAX_ORDER
+#define PDDGPU_POOL_HUGE_PAGES          (1UL << PDDGPU_POOL_HUGE_ORDER)
+#define PDDGPU_POOL_NUM_ORDERS          (PDDGPU_POOL_MAX_ORDER + 1)
+#define PDDGPU_POOL_NUM_TYPES           (TTM_NUM_CACHING_TYPES * PDDGPU_POOL_NUM_ORDERS)
+/* 并行填充时每段的最小页数，4K页时为64MB */
+#define PDDGPU_POOL_MIN_PARALLEL_PAGES  (32 * PDDGPU_POOL_HUGE_PAGES)
+/* 并行填充的线程数上限，包括调用线程 */
+#define PDDGPU_POOL_MAX_WORKERS         8
+
+/* 同一缓存属性、同一阶的空闲块 */
+struct pddgpu_pool_type {
+	spinlock_t lock;
+	struct list_head pages;         /* 块首页的lru链表，页面已清零 */
+	unsigned long nr;               /* 空闲块数 */
+};
+
+/*
+ * 设备页面池。页面在放回池中时保留WC/UC属性，复用时不必再改页表属性。
+ * 设备DMA掩码不超过32位时所有页面都从DMA32区域分配。
+ */
+struct pddgpu_page_pool {
+	struct device *dev;
+	bool use_dma32;
+	struct pddgpu_pool_type types[TTM_NUM_CACHING_TYPES][PDDGPU_POOL_NUM_ORDERS];
+	atomic_long_t nr_pages;         /* 池中的页数 */
+	unsigned long max_pages;        /* 超出后释放的页面直接还给系统 */
+	atomic_t shrink_cursor;         /* 收缩器轮转的起点 */
+	struct shrinker *shrinker;
+	struct workqueue_struct *populate_wq;   /* 并行填充的无绑定工作队列 */
+	u32 num_workers;                /* 调用线程之外的填充线程数 */
+
+	/* 统计信息 */
+	atomic64_t hits;                /* 从池中取得的块数 */
+	atomic64_t misses;              /* 从系统分配的块数 */
+	atomic64_t caching_changes;     /* 改变属性的页数 */
+	atomic64_t shrunk;              /* 收缩器释放的页数 */
+	atomic_long_t tt_pages;         /* 已填充到ttm_tt的页数 */
+	atomic_long_t tt_huge_pages;    /* 其中由大页块提供的页数 */
+	atomic64_t parallel_populates;  /* 并行填充的次数 */
+};
+
+/* 初始化和清理 */
+int pddgpu_pool_init(struct pddgpu_device *pdev);
+void pddgpu_pool_fini(struct pddgpu_device *pdev);
+
+/* 填充和释放ttm_tt的页面 */
+int pddgpu_pool_alloc(struct pddgpu_page_pool *pool, struct ttm_tt *tt,
+                      struct ttm_operation_ctx *ctx);
+int pddgpu_pool_alloc_pages(struct pddgpu_page_pool *pool, struct ttm_tt *tt,
+                            struct ttm_operation_ctx *ctx, pgoff_t start, pgoff_t end);
+void pddgpu_pool_free(struct pddgpu_page_pool *pool, struct ttm_tt *tt);
+void pddgpu_pool_release(struct pddgpu_page_pool *pool, struct ttm_tt *tt);
+
+/* 调试接口 */
+void pddgpu_pool_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p);
+
+#endif /* __PDDGPU_POOL_H__ */
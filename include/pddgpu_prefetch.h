@@ -0,0 +1,62 @@
+/*
+ * PDDGPU BO预取
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_PREFETCH_H__
+#define __PDDGPU_PREFETCH_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+struct dma_fence;
+struct drm_gem_object;
+struct drm_printer;
+struct pddgpu_device;
+struct pddgpu_fpriv;
+
+/* 一次预取请求最多包含的BO数 */
+#define PDDGPU_PREFETCH_MAX_BOS         256
+
+/*
+ * 设备预取状态。请求在有序队列上按提交顺序处理，迁移交给复制引擎以
+ * PREFETCH优先级执行，全部完成后按序号顺序发出栅栏信号。
+ */
+struct pddgpu_prefetch {
+	struct workqueue_struct *wq;
+
+	u64 fence_context;
+	atomic64_t fence_seqno;
+	spinlock_t fence_lock;
+
+	/* 统计信息 */
+	atomic64_t requests;
+	atomic64_t bos;                 /* 迁移的BO数 */
+	atomic64_t bytes;
+	atomic64_t skipped;             /* 已在目标域或不能迁移而跳过的BO数 */
+	atomic64_t throttled;           /* 因移动配额不足跳过的BO数 */
+	atomic64_t errors;
+	atomic64_t latency_ns;          /* 提交到栅栏信号的累计时间 */
+};
+
+/* 初始化和清理，依赖复制引擎 */
+int pddgpu_prefetch_init(struct pddgpu_device *pdev);
+void pddgpu_prefetch_fini(struct pddgpu_device *pdev);
+
+/*
+ * 提交预取请求，成功时接管objs数组及其引用，返回全部迁移完成后发出
+ * 信号的栅栏。迁移计入fpriv的移动配额。
+ */
+struct dma_fence *pddgpu_prefetch_submit(struct pddgpu_device *pdev,
+                                         struct pddgpu_fpriv *fpriv,
+                                         struct drm_gem_object **objs,
+                                         u32 count, u32 domain);
+
+/* 调试接口 */
+void pddgpu_prefetch_debug_print(struct pddgpu_device *pdev,
+                                 struct drm_printer *p);
+
+#endif /* __PDDGPU_PREFETCH_H__ */
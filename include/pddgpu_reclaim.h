@@ -0,0 +1,41 @@
+/*
+ * PDDGPU 后台内存回收
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_RECLAIM_H__
+#define __PDDGPU_RECLAIM_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/workqueue.h>
+
+struct drm_printer;
+struct pddgpu_device;
+
+/* 设备后台回收状态 */
+struct pddgpu_reclaim {
+	struct workqueue_struct *wq;    /* 每设备一个有序工作队列，相当于kswapd线程 */
+	struct delayed_work work;
+
+	/* 统计信息 */
+	atomic64_t wakeups;             /* 低于低水位被唤醒的次数 */
+	atomic64_t passes;              /* 回收轮数 */
+	atomic64_t bos_evicted;
+	atomic64_t vram_bytes;          /* 从VRAM移出的字节数 */
+	atomic64_t gtt_bytes;           /* 从GTT移出的字节数 */
+};
+
+/* 初始化和清理 */
+int pddgpu_reclaim_init(struct pddgpu_device *pdev);
+void pddgpu_reclaim_fini(struct pddgpu_device *pdev);
+
+/* 分配后检查水位，低于低水位时唤醒后台回收 */
+void pddgpu_reclaim_check(struct pddgpu_device *pdev, u32 mem_type);
+
+/* 调试接口 */
+void pddgpu_reclaim_debug_print(struct pddgpu_device *pdev,
+                                struct drm_printer *p);
+
+#endif /* __PDDGPU_RECLAIM_H__ */
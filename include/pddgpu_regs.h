@@ -60,6 +60,11 @@
 #define PDDGPU_GEM_CREATE_VRAM_CLEARED           0x00000010
 #define PDDGPU_GEM_CREATE_VM_ALWAYS_VALID        0x00000020
 #define PDDGPU_GEM_CREATE_EXPLICIT_SYNC          0x00000040
+#define PDDGPU_GEM_CREATE_LAZY_PLACEMENT         0x00000080
+#define PDDGPU_GEM_CREATE_ASYNC                  0x00000100
+#define PDDGPU_GEM_CREATE_SPARSE                 0x00000200
+#define PDDGPU_GEM_CREATE_CPU_GTT_USWC           0x00000400
+#define PDDGPU_GEM_CREATE_CPU_GTT_UNCACHED       0x00000800
 
 /* 内存类型定义 */
 #define PDDGPU_PL_SYSTEM             0
@@ -0,0 +1,51 @@
+/*
+ * PDDGPU 系统内存BO换出
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_SWAP_H__
+#define __PDDGPU_SWAP_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
+
+struct drm_printer;
+struct pddgpu_device;
+
+/*
+ * 设备换出状态。收缩器把冷的系统内存BO通过TTM换出到shmem，shmem页面
+ * 再由内核异步写回交换区；下次使用时填充ttm_tt的路径按需换入。
+ */
+struct pddgpu_swap {
+	struct shrinker *shrinker;
+	struct work_struct work;        /* 不能进入文件系统的回收推迟到后台回收队列 */
+	atomic_long_t deferred_pages;   /* 推迟到后台换出的页数 */
+	atomic_long_t swapped_pages;    /* 当前换出在shmem中的页数 */
+
+	/* 统计信息 */
+	atomic64_t swapouts;
+	atomic64_t swapout_bytes;
+	atomic64_t swapout_us;          /* 换出累计耗时 */
+	atomic64_t swapins;
+	atomic64_t swapin_bytes;
+	atomic64_t swapin_us;           /* 换入累计耗时 */
+	atomic64_t deferred;            /* 推迟到后台的扫描次数 */
+};
+
+/* 初始化和清理，依赖后台回收队列 */
+int pddgpu_swap_init(struct pddgpu_device *pdev);
+void pddgpu_swap_fini(struct pddgpu_device *pdev);
+
+/* 由ttm_tt换出、填充和销毁路径调用 */
+void pddgpu_swap_note_out(struct pddgpu_device *pdev, pgoff_t num_pages, s64 us);
+void pddgpu_swap_note_in(struct pddgpu_device *pdev, pgoff_t num_pages, s64 us);
+void pddgpu_swap_note_released(struct pddgpu_device *pdev, pgoff_t num_pages);
+
+/* 调试接口 */
+void pddgpu_swap_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p);
+
+#endif /* __PDDGPU_SWAP_H__ */
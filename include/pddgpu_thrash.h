@@ -0,0 +1,40 @@
+/*
+ * PDDGPU BO抖动检测
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_THRASH_H__
+#define __PDDGPU_THRASH_H__
+
+#include <linux/types.h>
+
+struct pddgpu_bo;
+
+/* 回退窗口最多翻倍的次数 */
+#define PDDGPU_THRASH_MAX_BACKOFF_SHIFT 3
+
+/* 每个BO的移动历史，受BO预留锁保护 */
+struct pddgpu_bo_thrash {
+	u64 window_start;               /* 当前统计窗口起点 */
+	u64 hold_until;                 /* 回退窗口结束前保持在当前域 */
+	u32 prev_mem_type;              /* 上一次移动前所在的域 */
+	u32 flips;                      /* 窗口内回到原域的次数 */
+	u32 strikes;                    /* 连续被判定为抖动的次数 */
+	bool demoted;                   /* 已永久移出VRAM */
+};
+
+/* 初始化BO移动历史 */
+void pddgpu_thrash_bo_init(struct pddgpu_bo *bo);
+
+/* 记录一次移动，调用者需持有BO预留锁 */
+void pddgpu_thrash_note_move(struct pddgpu_bo *bo, u32 old_mem_type,
+                             u32 new_mem_type);
+
+/* BO是否处于回退窗口内，应保持在当前域 */
+bool pddgpu_thrash_bo_held(struct pddgpu_bo *bo);
+
+/* 放置时应避开VRAM */
+bool pddgpu_thrash_avoid_vram(struct pddgpu_bo *bo);
+
+#endif /* __PDDGPU_THRASH_H__ */
@@ -0,0 +1,51 @@
+/*
+ * PDDGPU VRAM/GTT冷热分层
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#ifndef __PDDGPU_TIER_H__
+#define __PDDGPU_TIER_H__
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/workqueue.h>
+
+struct drm_printer;
+struct pddgpu_device;
+struct pddgpu_bo;
+
+/* 热度上限，避免长期热点在变冷后迟迟降不下来 */
+#define PDDGPU_TIER_MAX_HEAT            64
+/* 每轮最多迁移的BO数 */
+#define PDDGPU_TIER_MAX_MOVES_PER_PASS  8
+/* 每次挑选候选时扫描的LRU项数 */
+#define PDDGPU_TIER_SCAN_DEPTH          32
+
+/* 设备分层状态 */
+struct pddgpu_tier {
+	struct delayed_work work;       /* 在后台回收队列上运行，与回收串行 */
+	u64 budget_bytes;               /* 剩余迁移配额，仅工作函数访问 */
+	u64 budget_stamp;               /* 上次补充配额的时间 */
+
+	/* 统计信息 */
+	atomic64_t promotions;
+	atomic64_t demotions;
+	atomic64_t promoted_bytes;
+	atomic64_t demoted_bytes;
+	atomic64_t budget_exhausted;    /* 因配额不足推迟的迁移次数 */
+};
+
+/* 初始化和清理，依赖后台回收队列 */
+void pddgpu_tier_init(struct pddgpu_device *pdev);
+void pddgpu_tier_fini(struct pddgpu_device *pdev);
+
+/* 访问采样 */
+void pddgpu_tier_note_access(struct pddgpu_bo *bo);
+u32 pddgpu_tier_heat(struct pddgpu_bo *bo);
+
+/* 调试接口 */
+void pddgpu_tier_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p);
+
+#endif /* __PDDGPU_TIER_H__ */
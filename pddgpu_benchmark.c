@@ -0,0 +1,191 @@
+/*
+ * PDDGPU BO移动基准测试实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/dma-resv.h>
+#include <linux/dma-fence.h>
+
+#include <drm/ttm/ttm_bo.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_benchmark.h"
+#include "pddgpu_object.h"
+
+/*
+ * 测量的域对，每对来回移动，两个方向分别统计。GTT和系统内存之间的移动
+ * 共用页面不复制数据，只有绑定和解绑开销，不计入带宽测量。
+ */
+static const u32 pddgpu_benchmark_pairs[][2] = {
+	{ PDDGPU_GEM_DOMAIN_VRAM, PDDGPU_GEM_DOMAIN_GTT },
+	{ PDDGPU_GEM_DOMAIN_VRAM, PDDGPU_GEM_DOMAIN_CPU },
+};
+
+static const char *pddgpu_benchmark_domain_name(u32 domain)
+{
+	switch (domain) {
+	case PDDGPU_GEM_DOMAIN_VRAM:
+		return "VRAM";
+	case PDDGPU_GEM_DOMAIN_GTT:
+		return "GTT";
+	case PDDGPU_GEM_DOMAIN_CPU:
+		return "CPU";
+	default:
+		return "unknown";
+	}
+}
+
+static void pddgpu_benchmark_log(const char *op, u32 sdomain, u32 ddomain,
+                                 u64 bytes, s64 us)
+{
+	PDDGPU_INFO("Benchmark %s %s %s -> %s: %llu MB in %lld us, %llu MB/s\n",
+	            pddgpu_memcpy_impl_name(pddgpu_memcpy_get_impl()), op,
+	            pddgpu_benchmark_domain_name(sdomain),
+	            pddgpu_benchmark_domain_name(ddomain),
+	            bytes >> 20, us, us > 0 ? div64_u64(bytes, us) : 0);
+}
+
+/* 把BO移到domain并等待复制引擎完成，调用者需持有BO预留锁 */
+static int pddgpu_benchmark_move(struct pddgpu_bo *bo, u32 domain, s64 *us)
+{
+	struct ttm_operation_ctx ctx = { .interruptible = false };
+	ktime_t start = ktime_get();
+	long r;
+
+	pddgpu_bo_placement_from_domain(bo, domain);
+	r = ttm_bo_validate(&bo->tbo, &bo->placement, &ctx);
+	if (r)
+		return r;
+
+	r = dma_resv_wait_timeout(bo->tbo.base.resv, DMA_RESV_USAGE_KERNEL, false,
+	                          MAX_SCHEDULE_TIMEOUT);
+	if (r < 0)
+		return r;
+
+	*us = ktime_us_delta(ktime_get(), start);
+	return 0;
+}
+
+/* 在a和b之间来回移动 */
+static int pddgpu_benchmark_pair(struct pddgpu_bo *bo, u32 a, u32 b)
+{
+	u64 bytes = (u64)bo->tbo.base.size * PDDGPU_BENCHMARK_ITERS;
+	s64 us, us_ab = 0, us_ba = 0;
+	int i, r;
+
+	r = pddgpu_benchmark_move(bo, a, &us);
+	if (r)
+		return r;
+
+	for (i = 0; i < PDDGPU_BENCHMARK_ITERS; i++) {
+		r = pddgpu_benchmark_move(bo, b, &us);
+		if (r)
+			return r;
+		us_ab += us;
+
+		r = pddgpu_benchmark_move(bo, a, &us);
+		if (r)
+			return r;
+		us_ba += us;
+	}
+
+	pddgpu_benchmark_log("move", a, b, bytes, us_ab);
+	pddgpu_benchmark_log("move", b, a, bytes, us_ba);
+
+	return 0;
+}
+
+/* 在domain中反复清理BO */
+static int pddgpu_benchmark_clear(struct pddgpu_bo *bo, u32 domain)
+{
+	u64 bytes = (u64)bo->tbo.base.size * PDDGPU_BENCHMARK_ITERS;
+	struct dma_fence *fence;
+	ktime_t start;
+	s64 us;
+	int i, r;
+
+	r = pddgpu_benchmark_move(bo, domain, &us);
+	if (r)
+		return r;
+
+	start = ktime_get();
+	for (i = 0; i < PDDGPU_BENCHMARK_ITERS; i++) {
+		r = pddgpu_ttm_clear_buffer(bo, bo->tbo.base.resv, &fence);
+		if (r)
+			return r;
+		dma_fence_wait(fence, false);
+		dma_fence_put(fence);
+	}
+
+	pddgpu_benchmark_log("clear", domain, domain, bytes,
+	                     ktime_us_delta(ktime_get(), start));
+
+	return 0;
+}
+
+/* 依次测量各域对，SIMD实现不可用时只测一轮 */
+static int pddgpu_benchmark_run(struct pddgpu_bo *bo)
+{
+	int i, r;
+
+	for (i = 0; i < ARRAY_SIZE(pddgpu_benchmark_pairs); i++) {
+		r = pddgpu_benchmark_pair(bo, pddgpu_benchmark_pairs[i][0],
+		                          pddgpu_benchmark_pairs[i][1]);
+		if (r)
+			return r;
+	}
+
+	r = pddgpu_benchmark_clear(bo, PDDGPU_GEM_DOMAIN_VRAM);
+	if (r)
+		return r;
+
+	return pddgpu_benchmark_clear(bo, PDDGPU_GEM_DOMAIN_GTT);
+}
+
+/*
+ * 先以通用实现测量作为对照，再以SIMD实现测量。测量期间临时修改
+ * simd_copy参数，同时进行的其他移动也会使用对应的实现。
+ */
+void pddgpu_benchmark(struct pddgpu_device *pdev)
+{
+	struct pddgpu_bo_param bp = {};
+	struct pddgpu_bo *bo = NULL;
+	int simd_copy = READ_ONCE(pddgpu_simd_copy);
+	int r;
+
+	bp.size = PDDGPU_BENCHMARK_SIZE;
+	bp.byte_align = PAGE_SIZE;
+	bp.domain = PDDGPU_GEM_DOMAIN_VRAM;
+	/* 物理连续时清理走ttm_bo_kmap()的单段映射，测量结果不受分段映射影响 */
+	bp.flags = PDDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED |
+	           PDDGPU_GEM_CREATE_VRAM_CONTIGUOUS;
+	bp.type = ttm_bo_type_kernel;
+	bp.bo_ptr_size = sizeof(struct pddgpu_bo);
+
+	r = pddgpu_bo_create(pdev, &bp, &bo);
+	if (r) {
+		PDDGPU_ERROR("Failed to create benchmark BO: %d\n", r);
+		return;
+	}
+
+	dma_resv_lock(bo->tbo.base.resv, NULL);
+
+	WRITE_ONCE(pddgpu_simd_copy, 0);
+	r = pddgpu_benchmark_run(bo);
+	if (!r) {
+		WRITE_ONCE(pddgpu_simd_copy, 1);
+		if (pddgpu_memcpy_get_impl() != PDDGPU_MEMCPY_GENERIC)
+			r = pddgpu_benchmark_run(bo);
+	}
+	WRITE_ONCE(pddgpu_simd_copy, simd_copy);
+
+	if (r)
+		PDDGPU_ERROR("Benchmark failed: %d\n", r);
+
+	dma_resv_unlock(bo->tbo.base.resv);
+	pddgpu_bo_unref(&bo);
+}
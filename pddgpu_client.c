@@ -0,0 +1,231 @@
+/*
+ * PDDGPU 客户端（drm_file）状态实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/dma-resv.h>
+
+#include <drm/drm_file.h>
+#include <drm/drm_gem.h>
+#include <drm/drm_print.h>
+#include <drm/ttm/ttm_resource.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_client.h"
+#include "pddgpu_object.h"
+
+/* BO计入内存统计的状态位 */
+#define PDDGPU_CLIENT_BO_SHARED         (1 << 0)
+#define PDDGPU_CLIENT_BO_PURGEABLE      (1 << 1)
+#define PDDGPU_CLIENT_BO_EVICTED        (1 << 2)
+
+static const char * const pddgpu_client_mem_names[PDDGPU_CLIENT_MEM_REGIONS] = {
+	[TTM_PL_SYSTEM] = "cpu",
+	[TTM_PL_TT] = "gtt",
+	[TTM_PL_VRAM] = "vram",
+};
+
+static void pddgpu_fpriv_release(struct kref *ref)
+{
+	struct pddgpu_fpriv *fpriv = container_of(ref, struct pddgpu_fpriv, refcount);
+
+	kfree(fpriv);
+}
+
+/* 获取客户端引用 */
+struct pddgpu_fpriv *pddgpu_fpriv_get(struct pddgpu_fpriv *fpriv)
+{
+	if (fpriv)
+		kref_get(&fpriv->refcount);
+
+	return fpriv;
+}
+
+/* 释放客户端引用 */
+void pddgpu_fpriv_put(struct pddgpu_fpriv *fpriv)
+{
+	if (fpriv)
+		kref_put(&fpriv->refcount, pddgpu_fpriv_release);
+}
+
+/* 把一个BO的状态加入或移出客户端统计 */
+static void pddgpu_client_account(struct pddgpu_fpriv *fpriv, int mem_type,
+                                  u32 flags, s64 size)
+{
+	struct pddgpu_client_mem *mem = &fpriv->mem[mem_type];
+
+	atomic64_add(size, &mem->total);
+	if (flags & PDDGPU_CLIENT_BO_SHARED)
+		atomic64_add(size, &mem->shared);
+	if (flags & PDDGPU_CLIENT_BO_PURGEABLE)
+		atomic64_add(size, &mem->purgeable);
+	if (flags & PDDGPU_CLIENT_BO_EVICTED)
+		atomic64_add(size, &fpriv->evicted_vram);
+}
+
+/*
+ * BO记住上次计入的区域、状态和CPU可见字节数，更新时减去旧状态再加上新状态，
+ * 所以首选域或共享状态在两次更新之间变化也不会使统计失衡。VRAM资源由多个
+ * buddy块组成，可见字节数按块累加，可能只有一部分落在可见范围内。
+ */
+static void pddgpu_client_bo_account(struct pddgpu_bo *bo, struct ttm_resource *res,
+                                     bool shared)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_fpriv *fpriv = bo->owner;
+	u64 size = bo->tbo.base.size;
+	u64 visible = 0;
+	int mem_type = -1;
+	u32 flags = 0;
+
+	if (!fpriv)
+		return;
+
+	if (res && res->mem_type < PDDGPU_CLIENT_MEM_REGIONS) {
+		mem_type = res->mem_type;
+		if (shared)
+			flags |= PDDGPU_CLIENT_BO_SHARED;
+		if (bo->madv == PDDGPU_MADV_DONTNEED)
+			flags |= PDDGPU_CLIENT_BO_PURGEABLE;
+		if (mem_type == TTM_PL_VRAM)
+			visible = pddgpu_vram_mgr_res_visible_size(pdev, res);
+		else if (bo->preferred_domains & PDDGPU_GEM_DOMAIN_VRAM)
+			flags |= PDDGPU_CLIENT_BO_EVICTED;
+	}
+
+	if (mem_type == bo->client_mem_type && flags == bo->client_flags &&
+	    visible == bo->client_visible)
+		return;
+
+	atomic64_add((s64)visible - (s64)bo->client_visible, &fpriv->visible_vram);
+	bo->client_visible = visible;
+
+	if (bo->client_mem_type >= 0)
+		pddgpu_client_account(fpriv, bo->client_mem_type, bo->client_flags,
+		                      -(s64)size);
+	if (mem_type >= 0)
+		pddgpu_client_account(fpriv, mem_type, flags, size);
+
+	bo->client_mem_type = mem_type;
+	bo->client_flags = flags;
+}
+
+/* 按BO当前的资源更新创建者的内存统计 */
+void pddgpu_client_bo_update(struct pddgpu_bo *bo, struct ttm_resource *res)
+{
+	struct drm_gem_object *obj = &bo->tbo.base;
+
+	pddgpu_client_bo_account(bo, res, READ_ONCE(obj->handle_count) > 1 ||
+	                                  READ_ONCE(obj->dma_buf));
+}
+
+/* 更新BO的共享状态 */
+void pddgpu_client_bo_set_shared(struct pddgpu_bo *bo, bool shared)
+{
+	if (!bo->owner)
+		return;
+
+	dma_resv_lock(bo->tbo.base.resv, NULL);
+	pddgpu_client_bo_account(bo, bo->tbo.resource, shared);
+	dma_resv_unlock(bo->tbo.base.resv);
+}
+
+/* 打开设备文件 */
+int pddgpu_driver_open(struct drm_device *dev, struct drm_file *file)
+{
+	struct pddgpu_fpriv *fpriv;
+	int i;
+
+	fpriv = kzalloc(sizeof(*fpriv), GFP_KERNEL);
+	if (!fpriv)
+		return -ENOMEM;
+
+	kref_init(&fpriv->refcount);
+	fpriv->pdev = drm_to_pdev(dev);
+	fpriv->pid = task_tgid_nr(current);
+	get_task_comm(fpriv->comm, current);
+
+	atomic64_set(&fpriv->thrash_moves, 0);
+	atomic64_set(&fpriv->thrash_bytes, 0);
+	atomic64_set(&fpriv->thrash_holds, 0);
+	atomic64_set(&fpriv->thrash_demotions, 0);
+
+	/* 新客户端从完整时间片开始，总量仍受设备配额约束 */
+	pddgpu_cs_budget_init(&fpriv->move_budget, true);
+	atomic64_set(&fpriv->moved_bytes, 0);
+	atomic64_set(&fpriv->moves_throttled, 0);
+
+	for (i = 0; i < PDDGPU_CLIENT_MEM_REGIONS; i++) {
+		atomic64_set(&fpriv->mem[i].total, 0);
+		atomic64_set(&fpriv->mem[i].shared, 0);
+		atomic64_set(&fpriv->mem[i].purgeable, 0);
+	}
+	atomic64_set(&fpriv->visible_vram, 0);
+	atomic64_set(&fpriv->evicted_vram, 0);
+
+	file->driver_priv = fpriv;
+
+	PDDGPU_DEBUG("Client opened: pid=%d (%s)\n", fpriv->pid, fpriv->comm);
+
+	return 0;
+}
+
+/* 关闭设备文件，BO持有的引用在BO销毁时释放 */
+void pddgpu_driver_postclose(struct drm_device *dev, struct drm_file *file)
+{
+	struct pddgpu_fpriv *fpriv = file->driver_priv;
+
+	PDDGPU_DEBUG("Client closed: pid=%d (%s)\n", fpriv->pid, fpriv->comm);
+
+	file->driver_priv = NULL;
+	pddgpu_fpriv_put(fpriv);
+}
+
+/*
+ * 输出客户端统计到/proc/<pid>/fdinfo。内存使用标准的drm-*-<region>键，
+ * 系统内存域中的BO可能已换出、压缩或尚未填充，不报告驻留量。
+ */
+void pddgpu_show_fdinfo(struct drm_printer *p, struct drm_file *file)
+{
+	struct pddgpu_fpriv *fpriv = file->driver_priv;
+	struct drm_memory_stats stats;
+	enum drm_gem_object_status status;
+	u64 total;
+	int i;
+
+	for (i = 0; i < PDDGPU_CLIENT_MEM_REGIONS; i++) {
+		total = atomic64_read(&fpriv->mem[i].total);
+		stats.shared = min_t(u64, atomic64_read(&fpriv->mem[i].shared), total);
+		stats.private = total - stats.shared;
+		stats.resident = i == TTM_PL_SYSTEM ? 0 : total;
+		stats.purgeable = atomic64_read(&fpriv->mem[i].purgeable);
+		stats.active = 0;
+
+		status = DRM_GEM_OBJECT_PURGEABLE;
+		if (i != TTM_PL_SYSTEM)
+			status |= DRM_GEM_OBJECT_RESIDENT;
+
+		drm_print_memory_stats(p, &stats, status, pddgpu_client_mem_names[i]);
+	}
+
+	drm_printf(p, "pddgpu-memory-visible-vram:\t%llu KiB\n",
+	           atomic64_read(&fpriv->visible_vram) >> 10);
+	drm_printf(p, "pddgpu-evicted-vram:\t%llu KiB\n",
+	           atomic64_read(&fpriv->evicted_vram) >> 10);
+
+	drm_printf(p, "pddgpu-thrash-moves:\t%llu\n",
+	           atomic64_read(&fpriv->thrash_moves));
+	drm_printf(p, "pddgpu-thrash-bytes:\t%llu KiB\n",
+	           atomic64_read(&fpriv->thrash_bytes) >> 10);
+	drm_printf(p, "pddgpu-thrash-holds:\t%llu\n",
+	           atomic64_read(&fpriv->thrash_holds));
+	drm_printf(p, "pddgpu-thrash-demotions:\t%llu\n",
+	           atomic64_read(&fpriv->thrash_demotions));
+	drm_printf(p, "pddgpu-moved-bytes:\t%llu KiB\n",
+	           atomic64_read(&fpriv->moved_bytes) >> 10);
+	drm_printf(p, "pddgpu-moves-throttled:\t%llu\n",
+	           atomic64_read(&fpriv->moves_throttled));
+}
@@ -0,0 +1,387 @@
+/*
+ * PDDGPU 系统内存BO压缩实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <linux/dma-resv.h>
+#include <linux/crypto.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_device.h>
+#include <drm/ttm/ttm_resource.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_compress.h"
+#include "pddgpu_object.h"
+
+/* 单页压缩输出缓冲，留出算法的最坏膨胀 */
+#define PDDGPU_COMPRESS_SCRATCH_SIZE    (2 * PAGE_SIZE)
+/* 压缩后超过这个长度的页原样保存 */
+#define PDDGPU_COMPRESS_MAX_LEN         (PAGE_SIZE - PAGE_SIZE / 8)
+
+/*
+ * 压缩一页，返回保存所需的长度：0为全零页，PAGE_SIZE为原样保存。
+ * data不为空时分配并填入保存的数据。
+ */
+static int pddgpu_compress_one(struct pddgpu_compress *comp, struct page *page,
+                               void **data)
+{
+	unsigned int dlen = PDDGPU_COMPRESS_SCRATCH_SIZE;
+	void *src;
+	int len;
+
+	src = kmap_local_page(page);
+	if (!memchr_inv(src, 0, PAGE_SIZE)) {
+		kunmap_local(src);
+		if (data)
+			*data = NULL;
+		return 0;
+	}
+
+	mutex_lock(&comp->lock);
+	if (!comp->tfm ||
+	    crypto_comp_compress(comp->tfm, src, PAGE_SIZE, comp->scratch, &dlen) ||
+	    dlen > PDDGPU_COMPRESS_MAX_LEN)
+		len = PAGE_SIZE;
+	else
+		len = dlen;
+
+	if (data) {
+		*data = kmalloc(len, GFP_KERNEL | __GFP_NOWARN);
+		if (*data)
+			memcpy(*data, len == PAGE_SIZE ? src : comp->scratch, len);
+		else
+			len = -ENOMEM;
+	}
+	mutex_unlock(&comp->lock);
+	kunmap_local(src);
+
+	return len;
+}
+
+/* 释放压缩副本，不更新统计 */
+static void pddgpu_compressed_destroy(struct pddgpu_compressed *c)
+{
+	pgoff_t i;
+
+	for (i = 0; i < c->num_pages; i++)
+		kfree(c->pages[i].data);
+	kvfree(c);
+}
+
+/*
+ * 压缩ttm_tt的页面。先均匀抽样几页，压缩后超过原大小2/3的BO整体跳过，
+ * 返回-E2BIG；压缩层关闭时返回-ENODEV。
+ */
+struct pddgpu_compressed *pddgpu_compress_pages(struct pddgpu_device *pdev,
+                                                struct page **pages,
+                                                pgoff_t num_pages)
+{
+	struct pddgpu_compress *comp = &pdev->mman.compress;
+	struct pddgpu_compressed *c = NULL;
+	u64 start = ktime_get_ns();
+	pgoff_t i, n, zero = 0;
+	u64 sampled = 0;
+	int len, r;
+
+	if (!READ_ONCE(comp->tfm) || !num_pages)
+		return ERR_PTR(-ENODEV);
+
+	n = min_t(pgoff_t, num_pages, PDDGPU_COMPRESS_SAMPLE_PAGES);
+	for (i = 0; i < n; i++)
+		sampled += pddgpu_compress_one(comp, pages[div_u64((u64)i * num_pages, n)], NULL);
+
+	if (sampled * 3 > (u64)n * PAGE_SIZE * 2) {
+		atomic64_inc(&comp->incompressible);
+		r = -E2BIG;
+		goto out;
+	}
+
+	c = kvzalloc(struct_size(c, pages, num_pages), GFP_KERNEL | __GFP_NOWARN);
+	if (!c) {
+		r = -ENOMEM;
+		goto out;
+	}
+	c->num_pages = num_pages;
+
+	for (i = 0; i < num_pages; i++) {
+		len = pddgpu_compress_one(comp, pages[i], &c->pages[i].data);
+		if (len < 0) {
+			r = len;
+			goto out;
+		}
+
+		c->pages[i].len = len;
+		c->stored += len;
+		if (!len)
+			zero++;
+	}
+
+	atomic64_inc(&comp->compressions);
+	atomic64_add((u64)num_pages << PAGE_SHIFT, &comp->compressed_bytes);
+	atomic64_add(zero, &comp->zero_pages);
+	atomic64_add((u64)num_pages << PAGE_SHIFT, &comp->resident_bytes);
+	atomic64_add(c->stored, &comp->stored_bytes);
+	r = 0;
+
+out:
+	atomic64_add(ktime_get_ns() - start, &comp->compress_ns);
+	if (r) {
+		if (c)
+			pddgpu_compressed_destroy(c);
+		return ERR_PTR(r);
+	}
+
+	return c;
+}
+
+/* 把压缩副本解压到ttm_tt新分配的页面，失败时副本保持不变 */
+int pddgpu_decompress_pages(struct pddgpu_device *pdev,
+                            struct pddgpu_compressed *c, struct page **pages)
+{
+	struct pddgpu_compress *comp = &pdev->mman.compress;
+	u64 start = ktime_get_ns();
+	unsigned int dlen;
+	pgoff_t i;
+	void *dst;
+	int r = 0;
+
+	for (i = 0; i < c->num_pages && !r; i++) {
+		struct pddgpu_compress_page *cp = &c->pages[i];
+
+		dst = kmap_local_page(pages[i]);
+		if (!cp->len) {
+			memset(dst, 0, PAGE_SIZE);
+		} else if (cp->len == PAGE_SIZE) {
+			memcpy(dst, cp->data, PAGE_SIZE);
+		} else {
+			dlen = PAGE_SIZE;
+			mutex_lock(&comp->lock);
+			r = comp->tfm ? crypto_comp_decompress(comp->tfm, cp->data, cp->len,
+			                                       dst, &dlen) : -ENODEV;
+			mutex_unlock(&comp->lock);
+			if (!r && dlen != PAGE_SIZE)
+				r = -EIO;
+		}
+		kunmap_local(dst);
+	}
+
+	atomic64_add(ktime_get_ns() - start, &comp->decompress_ns);
+
+	if (r) {
+		PDDGPU_ERROR("Failed to decompress BO page %lu: %d\n", i - 1, r);
+		return r;
+	}
+
+	atomic64_inc(&comp->decompressions);
+	atomic64_add((u64)c->num_pages << PAGE_SHIFT, &comp->decompressed_bytes);
+
+	return 0;
+}
+
+/* 释放压缩副本 */
+void pddgpu_compressed_free(struct pddgpu_device *pdev, struct pddgpu_compressed *c)
+{
+	struct pddgpu_compress *comp = &pdev->mman.compress;
+
+	atomic64_sub((u64)c->num_pages << PAGE_SHIFT, &comp->resident_bytes);
+	atomic64_sub(c->stored, &comp->stored_bytes);
+	pddgpu_compressed_destroy(c);
+}
+
+/* 从系统内存LRU头挑选一个可压缩的冷BO，返回时已持有其预留锁和引用 */
+static struct pddgpu_bo *pddgpu_compress_pick(struct pddgpu_device *pdev, u64 min_age)
+{
+	struct ttm_device *bdev = &pdev->mman.bdev;
+	struct ttm_resource_manager *man = ttm_manager_type(bdev, TTM_PL_SYSTEM);
+	u64 now = ktime_get_ns();
+	struct ttm_resource_cursor cursor;
+	struct pddgpu_bo *victim = NULL;
+	struct ttm_resource *res;
+
+	spin_lock(&bdev->lru_lock);
+	ttm_resource_cursor_init(&cursor, man);
+	ttm_resource_manager_for_each_res(&cursor, res) {
+		struct ttm_buffer_object *tbo = res->bo;
+		struct pddgpu_bo *bo;
+		u64 last_use;
+
+		if (!tbo || !pddgpu_bo_is_pddgpu_bo(tbo) || tbo->pin_count ||
+		    tbo->type != ttm_bo_type_device ||
+		    tbo->priority >= PDDGPU_BO_PRIORITY_CRITICAL ||
+		    !pddgpu_ttm_swappable(tbo))
+			continue;
+
+		/* DONTNEED的BO留给换出时丢弃，上次抽样不可压缩的BO再次使用后才重新抽样 */
+		bo = to_pddgpu_bo(tbo);
+		last_use = READ_ONCE(bo->last_use_ns);
+		if (now - last_use < min_age || pddgpu_thrash_bo_held(bo) ||
+		    READ_ONCE(bo->kptr) || READ_ONCE(bo->madv) == PDDGPU_MADV_DONTNEED ||
+		    (last_use && READ_ONCE(bo->incompressible_ns) == last_use))
+			continue;
+
+		if (!dma_resv_trylock(tbo->base.resv))
+			continue;
+
+		if (tbo->resource != res ||
+		    !dma_resv_test_signaled(tbo->base.resv, DMA_RESV_USAGE_BOOKKEEP) ||
+		    !ttm_bo_get_unless_zero(tbo)) {
+			dma_resv_unlock(tbo->base.resv);
+			continue;
+		}
+
+		victim = bo;
+		break;
+	}
+	ttm_resource_cursor_fini(&cursor);
+	spin_unlock(&bdev->lru_lock);
+
+	return victim;
+}
+
+/* 压缩工作函数：每轮压缩有限页数的冷BO，控制CPU开销 */
+static void pddgpu_compress_work(struct work_struct *work)
+{
+	struct pddgpu_compress *comp =
+		container_of(to_delayed_work(work), struct pddgpu_compress, work);
+	struct pddgpu_device *pdev =
+		container_of(comp, struct pddgpu_device, mman.compress);
+	int interval = READ_ONCE(pddgpu_compress_interval_ms);
+	u64 min_age = (u64)max(READ_ONCE(pddgpu_compress_min_age_ms), 0) * NSEC_PER_MSEC;
+	unsigned long budget = PDDGPU_COMPRESS_BATCH_PAGES;
+	struct pddgpu_bo *bo;
+	pgoff_t num_pages;
+	int r;
+
+	if (interval <= 0 || !comp->tfm)
+		return;
+
+	while (budget) {
+		bo = pddgpu_compress_pick(pdev, min_age);
+		if (!bo)
+			break;
+
+		num_pages = PFN_UP(bo->tbo.base.size);
+		r = pddgpu_ttm_compress(bo);
+		if (r == -E2BIG)
+			WRITE_ONCE(bo->incompressible_ns, READ_ONCE(bo->last_use_ns));
+		dma_resv_unlock(bo->tbo.base.resv);
+		ttm_bo_put(&bo->tbo);
+
+		if (r && r != -E2BIG) {
+			PDDGPU_DEBUG("BO compression failed: %d\n", r);
+			break;
+		}
+
+		budget -= min_t(unsigned long, budget, num_pages);
+	}
+
+	queue_delayed_work(pdev->mman.reclaim.wq, &comp->work,
+	                   msecs_to_jiffies(interval));
+}
+
+/* 初始化压缩 */
+void pddgpu_compress_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_compress *comp = &pdev->mman.compress;
+	struct crypto_comp *tfm;
+
+	PDDGPU_DEBUG("Initializing BO compression\n");
+
+	mutex_init(&comp->lock);
+	INIT_DELAYED_WORK(&comp->work, pddgpu_compress_work);
+	comp->tfm = NULL;
+
+	atomic64_set(&comp->compressions, 0);
+	atomic64_set(&comp->compressed_bytes, 0);
+	atomic64_set(&comp->compress_ns, 0);
+	atomic64_set(&comp->decompressions, 0);
+	atomic64_set(&comp->decompressed_bytes, 0);
+	atomic64_set(&comp->decompress_ns, 0);
+	atomic64_set(&comp->incompressible, 0);
+	atomic64_set(&comp->zero_pages, 0);
+	atomic64_set(&comp->resident_bytes, 0);
+	atomic64_set(&comp->stored_bytes, 0);
+
+	if (pddgpu_compress_interval_ms <= 0)
+		return;
+
+	comp->scratch = kmalloc(PDDGPU_COMPRESS_SCRATCH_SIZE, GFP_KERNEL);
+	if (!comp->scratch) {
+		PDDGPU_ERROR("Failed to allocate compression buffer\n");
+		return;
+	}
+
+	tfm = crypto_alloc_comp(pddgpu_compress_alg, 0, 0);
+	if (IS_ERR(tfm)) {
+		PDDGPU_INFO("Compression algorithm %s unavailable (%ld), BO compression disabled\n",
+		            pddgpu_compress_alg, PTR_ERR(tfm));
+		kfree(comp->scratch);
+		comp->scratch = NULL;
+		return;
+	}
+	comp->tfm = tfm;
+
+	queue_delayed_work(pdev->mman.reclaim.wq, &comp->work,
+	                   msecs_to_jiffies(pddgpu_compress_interval_ms));
+}
+
+/* 清理压缩，之后压缩保存的BO无法解压，调用前BO应已全部释放 */
+void pddgpu_compress_fini(struct pddgpu_device *pdev)
+{
+	struct pddgpu_compress *comp = &pdev->mman.compress;
+
+	PDDGPU_DEBUG("Finalizing BO compression\n");
+
+	cancel_delayed_work_sync(&comp->work);
+
+	mutex_lock(&comp->lock);
+	if (comp->tfm) {
+		crypto_free_comp(comp->tfm);
+		comp->tfm = NULL;
+	}
+	kfree(comp->scratch);
+	comp->scratch = NULL;
+	mutex_unlock(&comp->lock);
+}
+
+/* 调试打印 */
+void pddgpu_compress_debug_print(struct pddgpu_device *pdev,
+                                 struct drm_printer *p)
+{
+	struct pddgpu_compress *comp = &pdev->mman.compress;
+	u64 resident = atomic64_read(&comp->resident_bytes);
+	u64 stored = atomic64_read(&comp->stored_bytes);
+	u64 c_bytes = atomic64_read(&comp->compressed_bytes);
+	u64 c_ns = atomic64_read(&comp->compress_ns);
+	u64 d_bytes = atomic64_read(&comp->decompressed_bytes);
+	u64 d_ns = atomic64_read(&comp->decompress_ns);
+
+	drm_printf(p, "BO Compression Debug Info:\n");
+	drm_printf(p, "  Algorithm=%s, Enabled=%d, Interval=%d ms, Min_Age=%d ms\n",
+	           pddgpu_compress_alg, comp->tfm != NULL,
+	           pddgpu_compress_interval_ms, pddgpu_compress_min_age_ms);
+	drm_printf(p, "  Resident=%llu MB, Stored=%llu MB, Ratio=%llu.%02llu, Zero_Pages=%llu, Incompressible=%llu\n",
+	           resident >> 20, stored >> 20,
+	           stored ? div64_u64(resident, stored) : 0,
+	           stored ? div64_u64(resident * 100, stored) % 100 : 0,
+	           atomic64_read(&comp->zero_pages),
+	           atomic64_read(&comp->incompressible));
+	drm_printf(p, "  Compress: Count=%llu, Bytes=%llu MB, CPU=%llu ms (%llu MB/s)\n",
+	           atomic64_read(&comp->compressions), c_bytes >> 20,
+	           div_u64(c_ns, NSEC_PER_MSEC),
+	           c_ns ? mul_u64_u64_div_u64(c_bytes, NSEC_PER_SEC, c_ns) >> 20 : 0);
+	drm_printf(p, "  Decompress: Count=%llu, Bytes=%llu MB, CPU=%llu ms (%llu MB/s)\n",
+	           atomic64_read(&comp->decompressions), d_bytes >> 20,
+	           div_u64(d_ns, NSEC_PER_MSEC),
+	           d_ns ? mul_u64_u64_div_u64(d_bytes, NSEC_PER_SEC, d_ns) >> 20 : 0);
+}
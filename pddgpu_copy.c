@@ -0,0 +1,655 @@
+/*
+ * PDDGPU 软件复制引擎实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/cpumask.h>
+#include <linux/iosys-map.h>
+#include <linux/dma-fence.h>
+#include <linux/dma-resv.h>
+#include <linux/workqueue.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_device.h>
+#include <drm/ttm/ttm_kmap_iter.h>
+#include <drm/ttm/ttm_resource.h>
+#include <drm/ttm/ttm_tt.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_copy.h"
+
+/* VRAM资源中一段物理连续的区间及其IO映射 */
+struct pddgpu_copy_seg {
+	u64 offset;                     /* 在资源内的偏移 */
+	u64 size;
+	void __iomem *vaddr;
+};
+
+/*
+ * 复制的一端。VRAM在提交时按物理连续的buddy块分段IO映射，不再引用资源
+ * 本身：流水线驱逐会在复制完成前释放旧资源，只有栅栏保护其下的VRAM不被重用。
+ */
+struct pddgpu_copy_side {
+	struct pddgpu_copy_seg *segs;   /* 按偏移递增排列 */
+	u32 num_segs;
+	struct ttm_kmap_iter_tt tt_iter;
+	struct ttm_kmap_iter *iter;
+};
+
+/* 工作线程，从运行队列取分块复制，队列为空时退出 */
+struct pddgpu_copy_worker {
+	struct work_struct work;
+	struct pddgpu_copy_engine *engine;
+};
+
+/* 一次BO移动，所有分块完成后栅栏发出信号 */
+struct pddgpu_copy_job {
+	struct dma_fence base;
+	struct pddgpu_device *pdev;
+	struct dma_fence *dep;          /* 移动前BO上已有的栅栏 */
+	struct dma_fence_cb dep_cb;
+	struct list_head node;          /* 运行队列链表，受引擎锁保护 */
+	struct pddgpu_copy_side src;
+	struct pddgpu_copy_side dst;
+	enum pddgpu_move_prio prio;
+	u32 num_pages;
+	u32 chunk_pages;
+	u32 next_page;                  /* 下一个待取走的分块，受引擎锁保护 */
+	atomic_t remaining;             /* 尚未复制完的页数 */
+	u64 submit_ns;
+	u64 start_ns;
+};
+
+/* 工作线程取走的一段复制 */
+struct pddgpu_copy_chunk {
+	struct pddgpu_copy_job *job;
+	u32 first;
+	u32 npages;
+};
+
+static const char * const pddgpu_move_prio_names[PDDGPU_MOVE_PRIO_COUNT] = {
+	[PDDGPU_MOVE_PRIO_INLINE] = "Inline",
+	[PDDGPU_MOVE_PRIO_FAULT] = "Fault",
+	[PDDGPU_MOVE_PRIO_PREFETCH] = "Prefetch",
+	[PDDGPU_MOVE_PRIO_BACKGROUND] = "Background",
+};
+
+static const char *pddgpu_copy_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "pddgpu";
+}
+
+static const char *pddgpu_copy_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "copy";
+}
+
+static void pddgpu_copy_fence_release(struct dma_fence *fence)
+{
+	struct pddgpu_copy_job *job = container_of(fence, struct pddgpu_copy_job, base);
+
+	kfree_rcu(job, base.rcu);
+}
+
+static const struct dma_fence_ops pddgpu_copy_fence_ops = {
+	.get_driver_name = pddgpu_copy_fence_get_driver_name,
+	.get_timeline_name = pddgpu_copy_fence_get_timeline_name,
+	.release = pddgpu_copy_fence_release,
+};
+
+static void pddgpu_copy_side_fini(struct pddgpu_copy_side *side)
+{
+	u32 i;
+
+	for (i = 0; i < side->num_segs; i++)
+		iounmap(side->segs[i].vaddr);
+	kfree(side->segs);
+	side->segs = NULL;
+	side->num_segs = 0;
+}
+
+/*
+ * 准备复制的一端：ttm_tt的页面逐页临时映射，VRAM资源不一定物理连续，
+ * 按buddy块合并出的连续区间分段IO映射。
+ */
+static int pddgpu_copy_side_init(struct pddgpu_copy_side *side,
+                                 struct ttm_buffer_object *bo,
+                                 struct ttm_resource *mem)
+{
+	struct ttm_resource_manager *man = ttm_manager_type(bo->bdev, mem->mem_type);
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->bdev);
+	u64 offset, addr, contig;
+	u32 n;
+	int r;
+
+	if (man->use_tt) {
+		if (!bo->ttm || !ttm_tt_is_populated(bo->ttm))
+			return -EINVAL;
+
+		side->iter = ttm_kmap_iter_tt_init(&side->tt_iter, bo->ttm);
+		return 0;
+	}
+
+	r = ttm_mem_io_reserve(bo->bdev, mem);
+	if (r)
+		return r;
+
+	if (!mem->bus.is_iomem)
+		return -EINVAL;
+
+	/* 先数出连续区间的个数 */
+	for (offset = 0, n = 0; offset < mem->size; offset += contig, n++) {
+		pddgpu_vram_mgr_res_addr(mem, offset, &contig);
+		if (!contig)
+			return -EINVAL;
+	}
+
+	side->segs = kcalloc(n, sizeof(*side->segs), GFP_KERNEL);
+	if (!side->segs)
+		return -ENOMEM;
+
+	for (offset = 0; offset < mem->size; offset += contig) {
+		struct pddgpu_copy_seg *seg = &side->segs[side->num_segs];
+
+		addr = pddgpu_vram_mgr_res_addr(mem, offset, &contig);
+		contig = min(contig, mem->size - offset);
+
+		seg->offset = offset;
+		seg->size = contig;
+		seg->vaddr = ioremap_wc(pdev->gmc.fb_start + addr, contig);
+		if (!seg->vaddr) {
+			pddgpu_copy_side_fini(side);
+			return -ENOMEM;
+		}
+		side->num_segs++;
+	}
+
+	return 0;
+}
+
+/* 二分查找页面所在的连续区间，多个工作线程并发查找，不缓存上次的位置 */
+static void __iomem *pddgpu_copy_side_vaddr(struct pddgpu_copy_side *side, u32 page)
+{
+	u64 offset = (u64)page << PAGE_SHIFT;
+	u32 lo = 0, hi = side->num_segs - 1, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if (side->segs[mid].offset <= offset)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return side->segs[lo].vaddr + (offset - side->segs[lo].offset);
+}
+
+static void pddgpu_copy_side_map(struct pddgpu_copy_side *side,
+                                 struct iosys_map *map, u32 page)
+{
+	if (side->segs)
+		iosys_map_set_vaddr_iomem(map, pddgpu_copy_side_vaddr(side, page));
+	else
+		side->iter->ops->map_local(side->iter, map, page);
+}
+
+static void pddgpu_copy_side_unmap(struct pddgpu_copy_side *side,
+                                   struct iosys_map *map)
+{
+	if (!side->segs && side->iter->ops->unmap_local)
+		side->iter->ops->unmap_local(side->iter, map);
+}
+
+static void pddgpu_copy_note_latency(struct pddgpu_copy_queue *queue, u64 ns)
+{
+	s64 max = atomic64_read(&queue->max_latency_ns);
+
+	atomic64_add(ns, &queue->latency_ns);
+	atomic64_inc(&queue->completed);
+
+	while (ns > max && !atomic64_try_cmpxchg(&queue->max_latency_ns, &max, ns))
+		;
+}
+
+/* 最后一个分块完成：释放映射，记录带宽和延迟并发出栅栏信号 */
+static void pddgpu_copy_job_done(struct pddgpu_copy_job *job)
+{
+	struct pddgpu_device *pdev = job->pdev;
+	struct pddgpu_copy_engine *engine = &pdev->mman.copy;
+	u64 bytes = (u64)job->num_pages << PAGE_SHIFT;
+	u64 now = ktime_get_ns();
+
+	pddgpu_copy_side_fini(&job->src);
+	pddgpu_copy_side_fini(&job->dst);
+
+	atomic64_add(bytes, &engine->bytes);
+	pddgpu_cs_note_copy(pdev, bytes, div_u64(now - job->start_ns, NSEC_PER_USEC));
+	pddgpu_copy_note_latency(&engine->queues[job->prio], now - job->submit_ns);
+
+	dma_fence_put(job->dep);
+	dma_fence_signal(&job->base);
+	dma_fence_put(&job->base);
+
+	if (atomic_dec_and_test(&engine->inflight))
+		wake_up_all(&engine->idle);
+}
+
+/* 复制一段，最后一段完成时结束作业 */
+static void pddgpu_copy_chunk_run(struct pddgpu_copy_chunk *chunk)
+{
+	struct pddgpu_copy_job *job = chunk->job;
+	struct iosys_map src_map, dst_map;
+	u32 i;
+
+	cmpxchg64(&job->start_ns, 0, ktime_get_ns());
+
+	for (i = chunk->first; i < chunk->first + chunk->npages; i++) {
+		pddgpu_copy_side_map(&job->dst, &dst_map, i);
+		pddgpu_copy_side_map(&job->src, &src_map, i);
+		pddgpu_memcpy(&dst_map, &src_map, PAGE_SIZE);
+		pddgpu_copy_side_unmap(&job->src, &src_map);
+		pddgpu_copy_side_unmap(&job->dst, &dst_map);
+	}
+
+	atomic64_inc(&job->pdev->mman.copy.chunks);
+
+	if (atomic_sub_and_test(chunk->npages, &job->remaining))
+		pddgpu_copy_job_done(job);
+}
+
+/*
+ * 取下一批工作：最高优先级队列头部作业的下一个分块。大作业留在队列头，
+ * 其余分块由其他线程并行取走；整个作业不超过一个分块时，
+ * 把同一队列中紧随其后的小作业合并为一批，总量不超过一个分块。
+ */
+static u32 pddgpu_copy_dequeue(struct pddgpu_copy_engine *engine,
+                               struct pddgpu_copy_chunk *batch)
+{
+	struct pddgpu_copy_queue *queue;
+	struct pddgpu_copy_job *job;
+	unsigned long flags;
+	u32 n = 0, pages = 0, npages;
+	int prio;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	for (prio = 0; prio < PDDGPU_MOVE_PRIO_COUNT; prio++) {
+		queue = &engine->queues[prio];
+		job = list_first_entry_or_null(&queue->jobs, struct pddgpu_copy_job, node);
+		if (!job)
+			continue;
+
+		do {
+			npages = min(job->chunk_pages, job->num_pages - job->next_page);
+			batch[n].job = job;
+			batch[n].first = job->next_page;
+			batch[n].npages = npages;
+			n++;
+
+			pages += npages;
+			job->next_page += npages;
+			if (job->next_page < job->num_pages)
+				break;
+
+			list_del(&job->node);
+			queue->depth--;
+
+			job = list_first_entry_or_null(&queue->jobs, struct pddgpu_copy_job, node);
+		} while (job && n < PDDGPU_COPY_MAX_BATCH && !job->next_page &&
+		         pages + job->num_pages <= batch[0].job->chunk_pages);
+		break;
+	}
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	return n;
+}
+
+/* 工作线程：每复制完一批就重新挑选，高优先级的移动可以插到大移动的分块之间 */
+static void pddgpu_copy_worker_func(struct work_struct *work)
+{
+	struct pddgpu_copy_worker *worker =
+		container_of(work, struct pddgpu_copy_worker, work);
+	struct pddgpu_copy_engine *engine = worker->engine;
+	struct pddgpu_copy_chunk batch[PDDGPU_COPY_MAX_BATCH];
+	u32 i, n;
+
+	while ((n = pddgpu_copy_dequeue(engine, batch))) {
+		if (n > 1)
+			atomic64_inc(&engine->batches);
+
+		for (i = 0; i < n; i++)
+			pddgpu_copy_chunk_run(&batch[i]);
+
+		cond_resched();
+	}
+}
+
+/* 依赖满足的作业进入运行队列，可能在栅栏回调中调用 */
+static void pddgpu_copy_job_queue(struct pddgpu_copy_job *job)
+{
+	struct pddgpu_copy_engine *engine = &job->pdev->mman.copy;
+	struct pddgpu_copy_queue *queue = &engine->queues[job->prio];
+	unsigned long flags;
+	u32 i;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	list_add_tail(&job->node, &queue->jobs);
+	queue->depth++;
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	/* 正在运行的工作线程会被重新排队，不会漏掉新作业 */
+	for (i = 0; i < engine->num_workers; i++)
+		queue_work(engine->wq, &engine->workers[i].work);
+}
+
+static void pddgpu_copy_dep_cb(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+	pddgpu_copy_job_queue(container_of(cb, struct pddgpu_copy_job, dep_cb));
+}
+
+/* 按分块大小参数拆分，分块是调度和抢占的粒度 */
+static u32 pddgpu_copy_chunk_pages(void)
+{
+	u32 chunk_pages = (u32)max(READ_ONCE(pddgpu_copy_chunk_kb), 0) >> (PAGE_SHIFT - 10);
+
+	return max_t(u32, chunk_pages, PDDGPU_COPY_MIN_CHUNK_PAGES);
+}
+
+void pddgpu_move_ctx_begin(struct pddgpu_device *pdev, struct pddgpu_move_ctx *mctx,
+                           enum pddgpu_move_prio prio)
+{
+	struct pddgpu_copy_engine *engine = &pdev->mman.copy;
+
+	mctx->prio = prio;
+	spin_lock(&engine->ctx_lock);
+	list_add(&mctx->node, &engine->ctxs);
+	spin_unlock(&engine->ctx_lock);
+}
+
+void pddgpu_move_ctx_end(struct pddgpu_device *pdev, struct pddgpu_move_ctx *mctx)
+{
+	struct pddgpu_copy_engine *engine = &pdev->mman.copy;
+
+	spin_lock(&engine->ctx_lock);
+	list_del(&mctx->node);
+	spin_unlock(&engine->ctx_lock);
+}
+
+/* 查找发起移动的上下文登记的优先级，驱逐移动沿用引起驱逐的调用者的上下文 */
+static enum pddgpu_move_prio pddgpu_move_ctx_prio(struct pddgpu_copy_engine *engine,
+                                                  struct ttm_operation_ctx *ctx)
+{
+	enum pddgpu_move_prio prio = PDDGPU_MOVE_PRIO_INLINE;
+	struct pddgpu_move_ctx *mctx;
+
+	spin_lock(&engine->ctx_lock);
+	list_for_each_entry(mctx, &engine->ctxs, node) {
+		if (&mctx->base == ctx) {
+			prio = mctx->prio;
+			break;
+		}
+	}
+	spin_unlock(&engine->ctx_lock);
+
+	return prio;
+}
+
+/*
+ * 异步移动BO：作业按优先级进入运行队列，由工作线程池分块并行复制，
+ * 栅栏交给ttm_bo_move_accel_cleanup()，调用者不等待复制完成。
+ * 驱逐时旧资源按流水线方式释放，新的分配会等待该栅栏。
+ */
+int pddgpu_move_blit(struct ttm_buffer_object *bo, bool evict,
+                     struct ttm_operation_ctx *ctx,
+                     struct ttm_resource *new_mem,
+                     struct ttm_resource *old_mem)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->bdev);
+	struct pddgpu_copy_engine *engine = &pdev->mman.copy;
+	struct pddgpu_copy_job *job;
+	struct dma_fence *fence;
+	int r;
+
+	if (!engine->wq || READ_ONCE(pddgpu_copy_chunk_kb) <= 0)
+		return -ENODEV;
+
+	/* 系统内存和GTT之间共享ttm_tt，不经过复制引擎 */
+	if (ttm_manager_type(bo->bdev, old_mem->mem_type)->use_tt &&
+	    ttm_manager_type(bo->bdev, new_mem->mem_type)->use_tt)
+		return -EINVAL;
+
+	r = dma_resv_reserve_fences(bo->base.resv, 1);
+	if (r)
+		return r;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	job->pdev = pdev;
+	job->prio = min_t(u32, pddgpu_move_ctx_prio(engine, ctx), PDDGPU_MOVE_PRIO_COUNT - 1);
+	job->num_pages = PFN_UP(bo->base.size);
+	job->chunk_pages = pddgpu_copy_chunk_pages();
+	atomic_set(&job->remaining, job->num_pages);
+
+	r = pddgpu_copy_side_init(&job->src, bo, old_mem);
+	if (r)
+		goto err_free;
+
+	r = pddgpu_copy_side_init(&job->dst, bo, new_mem);
+	if (r)
+		goto err_src_fini;
+
+	/* 依赖BO上已有的全部栅栏 */
+	r = dma_resv_get_singleton(bo->base.resv, DMA_RESV_USAGE_BOOKKEEP, &job->dep);
+	if (r)
+		goto err_dst_fini;
+
+	/*
+	 * 各优先级队列和同一作业的分块并行完成，作业之间没有完成顺序，
+	 * 不能共用一条时间线。每个作业使用独立的栅栏上下文。
+	 */
+	dma_fence_init(&job->base, &pddgpu_copy_fence_ops, &engine->fence_lock,
+	               dma_fence_context_alloc(1), 1);
+
+	/* 初始引用归工作线程，最后一个分块完成时释放；这里另取一个给TTM */
+	fence = dma_fence_get(&job->base);
+	job->submit_ns = ktime_get_ns();
+	atomic_inc(&engine->inflight);
+	atomic64_inc(&engine->jobs);
+	atomic64_inc(&engine->queues[job->prio].submitted);
+
+	/* 依赖满足后才进入运行队列，工作线程从不等待 */
+	if (!job->dep ||
+	    dma_fence_add_callback(job->dep, &job->dep_cb, pddgpu_copy_dep_cb))
+		pddgpu_copy_job_queue(job);
+
+	/* 内核BO不做流水线驱逐，与amdgpu相同 */
+	r = ttm_bo_move_accel_cleanup(bo, fence, evict,
+	                              bo->type != ttm_bo_type_kernel, new_mem);
+	if (r) {
+		/* 资源未切换，等复制结束后由调用者回退到同步复制 */
+		dma_fence_wait(fence, false);
+		atomic64_inc(&engine->errors);
+		PDDGPU_ERROR("Copy engine cleanup failed: %d\n", r);
+	}
+	dma_fence_put(fence);
+
+	return r;
+
+err_dst_fini:
+	pddgpu_copy_side_fini(&job->dst);
+err_src_fini:
+	pddgpu_copy_side_fini(&job->src);
+err_free:
+	kfree(job);
+	return r;
+}
+
+/*
+ * 同步CPU复制，代替ttm_bo_move_memcpy()以使用非临时SIMD复制，
+ * 用于复制引擎关闭或提交失败时。源在未填充的ttm_tt中时应清零而不是复制，
+ * 返回-EAGAIN交给TTM处理。
+ */
+int pddgpu_copy_sync(struct ttm_buffer_object *bo, struct ttm_operation_ctx *ctx,
+                     struct ttm_resource *new_mem)
+{
+	struct ttm_resource *old_mem = bo->resource;
+	struct pddgpu_copy_side src = {}, dst = {};
+	struct iosys_map src_map, dst_map;
+	u32 i, num_pages = PFN_UP(bo->base.size);
+	int r;
+
+	if (ttm_manager_type(bo->bdev, old_mem->mem_type)->use_tt &&
+	    (!bo->ttm || !ttm_tt_is_populated(bo->ttm)))
+		return -EAGAIN;
+
+	r = ttm_bo_wait_ctx(bo, ctx);
+	if (r)
+		return r;
+
+	if (ttm_manager_type(bo->bdev, new_mem->mem_type)->use_tt) {
+		r = ttm_tt_populate(bo->bdev, bo->ttm, ctx);
+		if (r)
+			return r;
+	}
+
+	r = pddgpu_copy_side_init(&src, bo, old_mem);
+	if (r)
+		return r;
+
+	r = pddgpu_copy_side_init(&dst, bo, new_mem);
+	if (r)
+		goto out_src_fini;
+
+	for (i = 0; i < num_pages; i++) {
+		pddgpu_copy_side_map(&dst, &dst_map, i);
+		pddgpu_copy_side_map(&src, &src_map, i);
+		pddgpu_memcpy(&dst_map, &src_map, PAGE_SIZE);
+		pddgpu_copy_side_unmap(&src, &src_map);
+		pddgpu_copy_side_unmap(&dst, &dst_map);
+
+		if (!((i + 1) % PDDGPU_COPY_MIN_CHUNK_PAGES))
+			cond_resched();
+	}
+
+	pddgpu_copy_side_fini(&dst);
+	pddgpu_copy_side_fini(&src);
+
+	ttm_bo_move_sync_cleanup(bo, new_mem);
+	return 0;
+
+out_src_fini:
+	pddgpu_copy_side_fini(&src);
+	return r;
+}
+
+/* 初始化复制引擎 */
+int pddgpu_copy_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_copy_engine *engine = &pdev->mman.copy;
+	u32 i;
+
+	PDDGPU_DEBUG("Initializing copy engine\n");
+
+	spin_lock_init(&engine->ctx_lock);
+	INIT_LIST_HEAD(&engine->ctxs);
+
+	engine->num_workers = clamp_t(u32, num_online_cpus(), 1, PDDGPU_COPY_MAX_WORKERS);
+	engine->workers = kcalloc(engine->num_workers, sizeof(*engine->workers),
+	                          GFP_KERNEL);
+	if (!engine->workers)
+		return -ENOMEM;
+
+	/* 驱逐在内存回收路径上运行，队列必须能保证前进 */
+	engine->wq = alloc_workqueue("pddgpu-copy", WQ_UNBOUND | WQ_MEM_RECLAIM,
+	                             engine->num_workers);
+	if (!engine->wq) {
+		kfree(engine->workers);
+		engine->workers = NULL;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < engine->num_workers; i++) {
+		INIT_WORK(&engine->workers[i].work, pddgpu_copy_worker_func);
+		engine->workers[i].engine = engine;
+	}
+
+	spin_lock_init(&engine->lock);
+	for (i = 0; i < PDDGPU_MOVE_PRIO_COUNT; i++) {
+		struct pddgpu_copy_queue *queue = &engine->queues[i];
+
+		INIT_LIST_HEAD(&queue->jobs);
+		queue->depth = 0;
+		atomic64_set(&queue->submitted, 0);
+		atomic64_set(&queue->completed, 0);
+		atomic64_set(&queue->latency_ns, 0);
+		atomic64_set(&queue->max_latency_ns, 0);
+	}
+	atomic_set(&engine->inflight, 0);
+	init_waitqueue_head(&engine->idle);
+
+	spin_lock_init(&engine->fence_lock);
+
+	atomic64_set(&engine->jobs, 0);
+	atomic64_set(&engine->chunks, 0);
+	atomic64_set(&engine->batches, 0);
+	atomic64_set(&engine->bytes, 0);
+	atomic64_set(&engine->errors, 0);
+
+	return 0;
+}
+
+/* 清理复制引擎，等待所有作业完成，包括仍在等待依赖的作业 */
+void pddgpu_copy_fini(struct pddgpu_device *pdev)
+{
+	struct pddgpu_copy_engine *engine = &pdev->mman.copy;
+
+	if (!engine->wq)
+		return;
+
+	PDDGPU_DEBUG("Finalizing copy engine\n");
+
+	wait_event(engine->idle, !atomic_read(&engine->inflight));
+	destroy_workqueue(engine->wq);
+	engine->wq = NULL;
+
+	kfree(engine->workers);
+	engine->workers = NULL;
+}
+
+/* 调试打印 */
+void pddgpu_copy_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p)
+{
+	struct pddgpu_copy_engine *engine = &pdev->mman.copy;
+	u64 completed;
+	int i;
+
+	drm_printf(p, "Copy Engine Debug Info:\n");
+	drm_printf(p, "  Workers=%u, Chunk=%d KB, Inflight=%d\n",
+	           engine->num_workers, pddgpu_copy_chunk_kb,
+	           atomic_read(&engine->inflight));
+	drm_printf(p, "  Jobs=%llu, Chunks=%llu, Batches=%llu, Copied=%llu MB, Errors=%llu\n",
+	           atomic64_read(&engine->jobs), atomic64_read(&engine->chunks),
+	           atomic64_read(&engine->batches), atomic64_read(&engine->bytes) >> 20,
+	           atomic64_read(&engine->errors));
+
+	for (i = 0; i < PDDGPU_MOVE_PRIO_COUNT; i++) {
+		struct pddgpu_copy_queue *queue = &engine->queues[i];
+
+		completed = atomic64_read(&queue->completed);
+		drm_printf(p, "  %s: Depth=%u, Submitted=%llu, Completed=%llu, Avg_Latency=%llu us, Max_Latency=%llu us\n",
+		           pddgpu_move_prio_names[i], READ_ONCE(queue->depth),
+		           atomic64_read(&queue->submitted), completed,
+		           completed ? div64_u64(atomic64_read(&queue->latency_ns),
+		                                 completed * NSEC_PER_USEC) : 0,
+		           div_u64(atomic64_read(&queue->max_latency_ns), NSEC_PER_USEC));
+	}
+}
@@ -0,0 +1,227 @@
+/*
+ * PDDGPU 缓冲区移动配额实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
+
+#include <drm/ttm/ttm_device.h>
+#include <drm/ttm/ttm_resource.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_cs.h"
+#include "include/pddgpu_client.h"
+
+/* 固定的移动速率优先，否则使用测得的复制带宽 */
+static u32 pddgpu_cs_log2_MBps(struct pddgpu_device *pdev)
+{
+	int moverate = READ_ONCE(pddgpu_moverate);
+
+	if (moverate > 0)
+		return ilog2(moverate);
+
+	return READ_ONCE(pdev->mman.mm_stats.log2_max_MBps);
+}
+
+/* MB/s约等于字节/微秒，按2的幂换算 */
+static s64 pddgpu_cs_bytes_to_us(u32 log2_MBps, u64 bytes)
+{
+	return bytes >> log2_MBps;
+}
+
+static u64 pddgpu_cs_us_to_bytes(u32 log2_MBps, s64 us)
+{
+	if (us <= 0)
+		return 0;
+
+	return (u64)us << log2_MBps;
+}
+
+/* 初始化配额，full为真时从一个完整时间片开始 */
+void pddgpu_cs_budget_init(struct pddgpu_move_budget *budget, bool full)
+{
+	spin_lock_init(&budget->lock);
+	budget->last_update_us = ktime_to_us(ktime_get());
+	budget->accum_us = full ? PDDGPU_MOVE_BUDGET_SLICE_US : 0;
+	budget->accum_us_vis = budget->accum_us;
+}
+
+/* 按流逝时间补充配额，最多积攒一个时间片；min_us为正时至少补到min_us */
+static void pddgpu_cs_budget_refill(struct pddgpu_move_budget *budget,
+                                    s64 now_us, s64 min_us)
+{
+	s64 increment_us = now_us - budget->last_update_us;
+
+	budget->last_update_us = now_us;
+	budget->accum_us = min_t(s64, budget->accum_us + increment_us,
+	                         PDDGPU_MOVE_BUDGET_SLICE_US);
+	budget->accum_us_vis = min_t(s64, budget->accum_us_vis + increment_us,
+	                             PDDGPU_MOVE_BUDGET_SLICE_US);
+
+	if (min_us > 0) {
+		budget->accum_us = max(budget->accum_us, min_us);
+		budget->accum_us_vis = max(budget->accum_us_vis, min_us);
+	}
+}
+
+/*
+ * VRAM空闲较多时搬入VRAM不会引起驱逐，至少允许填满四分之一的空闲空间，
+ * 避免刚启动或透支后在VRAM空闲的情况下仍被限流。
+ */
+static s64 pddgpu_cs_min_us(struct pddgpu_device *pdev, u32 log2_MBps)
+{
+	struct ttm_resource_manager *man = ttm_manager_type(&pdev->mman.bdev, TTM_PL_VRAM);
+	u64 used, free;
+
+	if (!man || !man->size)
+		return 0;
+
+	used = ttm_resource_manager_usage(man);
+	free = man->size > used ? man->size - used : 0;
+	if (free < SZ_128M && free < man->size / 8)
+		return 0;
+
+	return pddgpu_cs_bytes_to_us(log2_MBps, free / 4);
+}
+
+/*
+ * 查询当前允许移动的字节数。设备配额约束所有客户端移动的总量，
+ * 客户端配额保证单个客户端不会独占设备的时间片。
+ */
+void pddgpu_cs_get_threshold_for_moves(struct pddgpu_device *pdev,
+                                       struct pddgpu_fpriv *fpriv,
+                                       u64 *max_bytes, u64 *max_vis_bytes)
+{
+	struct pddgpu_mm_stats *stats = &pdev->mman.mm_stats;
+	s64 now_us, min_us, us, us_vis;
+	u32 log2_MBps;
+
+	if (!READ_ONCE(pddgpu_moverate)) {
+		*max_bytes = U64_MAX;
+		*max_vis_bytes = U64_MAX;
+		return;
+	}
+
+	log2_MBps = pddgpu_cs_log2_MBps(pdev);
+	min_us = pddgpu_cs_min_us(pdev, log2_MBps);
+	now_us = ktime_to_us(ktime_get());
+
+	spin_lock(&stats->budget.lock);
+	pddgpu_cs_budget_refill(&stats->budget, now_us, min_us);
+	us = stats->budget.accum_us;
+	us_vis = stats->budget.accum_us_vis;
+	spin_unlock(&stats->budget.lock);
+
+	if (fpriv) {
+		spin_lock(&fpriv->move_budget.lock);
+		pddgpu_cs_budget_refill(&fpriv->move_budget, now_us, min_us);
+		us = min(us, fpriv->move_budget.accum_us);
+		us_vis = min(us_vis, fpriv->move_budget.accum_us_vis);
+		spin_unlock(&fpriv->move_budget.lock);
+	}
+
+	*max_bytes = pddgpu_cs_us_to_bytes(log2_MBps, us);
+
+	/* VRAM全部CPU可见时不单独限制可见部分 */
+	if (pdev->gmc.visible_vram_size < pdev->gmc.real_vram_size)
+		*max_vis_bytes = pddgpu_cs_us_to_bytes(log2_MBps, us_vis);
+	else
+		*max_vis_bytes = *max_bytes;
+}
+
+/* 从设备和客户端配额中扣除已移动的字节数 */
+void pddgpu_cs_report_moved_bytes(struct pddgpu_device *pdev,
+                                  struct pddgpu_fpriv *fpriv,
+                                  u64 num_bytes, u64 num_vis_bytes)
+{
+	struct pddgpu_mm_stats *stats = &pdev->mman.mm_stats;
+	u32 log2_MBps;
+	s64 us, us_vis;
+
+	if (!num_bytes)
+		return;
+
+	log2_MBps = pddgpu_cs_log2_MBps(pdev);
+	us = pddgpu_cs_bytes_to_us(log2_MBps, num_bytes);
+	us_vis = pddgpu_cs_bytes_to_us(log2_MBps, num_vis_bytes);
+
+	spin_lock(&stats->budget.lock);
+	stats->budget.accum_us -= us;
+	stats->budget.accum_us_vis -= us_vis;
+	spin_unlock(&stats->budget.lock);
+
+	atomic64_add(num_bytes, &stats->reported_bytes);
+
+	if (fpriv) {
+		spin_lock(&fpriv->move_budget.lock);
+		fpriv->move_budget.accum_us -= us;
+		fpriv->move_budget.accum_us_vis -= us_vis;
+		spin_unlock(&fpriv->move_budget.lock);
+
+		atomic64_add(num_bytes, &fpriv->moved_bytes);
+	}
+}
+
+/* 记录一次因配额耗尽而接受非首选放置的验证 */
+void pddgpu_cs_note_throttled(struct pddgpu_device *pdev,
+                              struct pddgpu_fpriv *fpriv)
+{
+	atomic64_inc(&pdev->mman.mm_stats.throttled);
+	if (fpriv)
+		atomic64_inc(&fpriv->moves_throttled);
+}
+
+/* 用CPU复制的实测带宽更新换算比例，滑动平均权重1/8 */
+void pddgpu_cs_note_copy(struct pddgpu_device *pdev, u64 bytes, s64 us)
+{
+	struct pddgpu_mm_stats *stats = &pdev->mman.mm_stats;
+	u64 sample;
+
+	/* 太小的复制计时误差过大 */
+	if (us <= 0 || bytes < SZ_64K)
+		return;
+
+	sample = clamp_t(u64, div64_u64(bytes, us), 1, U32_MAX);
+
+	spin_lock(&stats->budget.lock);
+	stats->measured_MBps = div_u64((u64)stats->measured_MBps * 7 + sample, 8);
+	WRITE_ONCE(stats->log2_max_MBps, ilog2(max(stats->measured_MBps, 1u)));
+	spin_unlock(&stats->budget.lock);
+}
+
+/* 初始化设备移动配额，和amdgpu一样从空配额开始 */
+void pddgpu_cs_mm_stats_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_mm_stats *stats = &pdev->mman.mm_stats;
+
+	pddgpu_cs_budget_init(&stats->budget, false);
+	stats->measured_MBps = PDDGPU_MOVE_DEFAULT_MBPS;
+	stats->log2_max_MBps = ilog2(PDDGPU_MOVE_DEFAULT_MBPS);
+
+	atomic64_set(&stats->throttled, 0);
+	atomic64_set(&stats->reported_bytes, 0);
+}
+
+/* 调试打印 */
+void pddgpu_cs_debug_print(struct pddgpu_device *pdev,
+                           struct drm_printer *p)
+{
+	struct pddgpu_mm_stats *stats = &pdev->mman.mm_stats;
+
+	drm_printf(p, "Move Budget Debug Info:\n");
+	drm_printf(p, "  Moverate=%d MB/s, Measured=%u MB/s, Log2=%u\n",
+	           pddgpu_moverate, READ_ONCE(stats->measured_MBps),
+	           pddgpu_cs_log2_MBps(pdev));
+	drm_printf(p, "  Accum=%lld us, Accum_Vis=%lld us\n",
+	           READ_ONCE(stats->budget.accum_us),
+	           READ_ONCE(stats->budget.accum_us_vis));
+	drm_printf(p, "  Reported=%llu MB, Throttled=%llu\n",
+	           atomic64_read(&stats->reported_bytes) >> 20,
+	           atomic64_read(&stats->throttled));
+}
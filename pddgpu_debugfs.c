@@ -0,0 +1,66 @@
+/*
+ * PDDGPU debugfs接口实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/seq_file.h>
+
+#include <drm/drm_debugfs.h>
+#include <drm/drm_file.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_memory_stats.h"
+
+#ifdef CONFIG_DEBUG_FS
+
+/* 每个子系统一个只读文件，内容与对应的*_debug_print()相同 */
+#define PDDGPU_DEBUGFS_SHOW(name)                                               \
+static int pddgpu_debugfs_##name##_show(struct seq_file *m, void *unused)       \
+{                                                                               \
+	struct drm_info_node *node = m->private;                                \
+	struct drm_printer p = drm_seq_file_printer(m);                         \
+                                                                                \
+	pddgpu_##name##_debug_print(drm_to_pdev(node->minor->dev), &p);         \
+	return 0;                                                               \
+}
+
+PDDGPU_DEBUGFS_SHOW(memory_stats)
+PDDGPU_DEBUGFS_SHOW(kmap_cache)
+PDDGPU_DEBUGFS_SHOW(evict)
+PDDGPU_DEBUGFS_SHOW(reclaim)
+PDDGPU_DEBUGFS_SHOW(tier)
+PDDGPU_DEBUGFS_SHOW(cs)
+PDDGPU_DEBUGFS_SHOW(copy)
+PDDGPU_DEBUGFS_SHOW(pool)
+PDDGPU_DEBUGFS_SHOW(swap)
+PDDGPU_DEBUGFS_SHOW(compress)
+PDDGPU_DEBUGFS_SHOW(prefetch)
+
+static const struct drm_info_list pddgpu_debugfs_list[] = {
+	{ "pddgpu_memory_stats", pddgpu_debugfs_memory_stats_show, 0 },
+	{ "pddgpu_kmap_cache", pddgpu_debugfs_kmap_cache_show, 0 },
+	{ "pddgpu_evict", pddgpu_debugfs_evict_show, 0 },
+	{ "pddgpu_reclaim", pddgpu_debugfs_reclaim_show, 0 },
+	{ "pddgpu_tier", pddgpu_debugfs_tier_show, 0 },
+	{ "pddgpu_move_budget", pddgpu_debugfs_cs_show, 0 },
+	{ "pddgpu_copy", pddgpu_debugfs_copy_show, 0 },
+	{ "pddgpu_pool", pddgpu_debugfs_pool_show, 0 },
+	{ "pddgpu_swap", pddgpu_debugfs_swap_show, 0 },
+	{ "pddgpu_compress", pddgpu_debugfs_compress_show, 0 },
+	{ "pddgpu_prefetch", pddgpu_debugfs_prefetch_show, 0 },
+};
+
+#endif /* CONFIG_DEBUG_FS */
+
+/* 在DRM次设备的debugfs目录下注册统计文件 */
+void pddgpu_debugfs_init(struct drm_minor *minor)
+{
+#ifdef CONFIG_DEBUG_FS
+	drm_debugfs_create_files(pddgpu_debugfs_list,
+	                         ARRAY_SIZE(pddgpu_debugfs_list),
+	                         minor->debugfs_root, minor);
+#endif
+}
@@ -83,7 +83,11 @@ int pddgpu_device_init(struct pddgpu_device *pdev)
 	
 	/* 设置设备状态为就绪 */
 	atomic_set(&pdev->device_state, PDDGPU_DEVICE_STATE_READY);
-	
+
+	/* 按需运行移动基准测试 */
+	if (pddgpu_benchmark)
+		pddgpu_benchmark(pdev);
+
 	PDDGPU_DEBUG("PDDGPU device initialized successfully\n");
 	return 0;
 
@@ -26,6 +26,172 @@ static const struct pci_device_id pddgpu_pci_table[] = {
 
 MODULE_DEVICE_TABLE(pci, pddgpu_pci_table);
 
+/* 模块参数 */
+int pddgpu_mmap_prefault = 16;
+
+MODULE_PARM_DESC(mmap_prefault, "Number of pages to prefault on CPU mmap fault (default 16)");
+module_param_named(mmap_prefault, pddgpu_mmap_prefault, int, 0644);
+
+int pddgpu_kmap_cache_size = 256;
+
+MODULE_PARM_DESC(kmap_cache_size, "Max size of cached kernel BO mappings in MB (default 256, 0 = unlimited)");
+module_param_named(kmap_cache_size, pddgpu_kmap_cache_size, int, 0444);
+
+int pddgpu_evict_scan_depth = 16;
+
+MODULE_PARM_DESC(evict_scan_depth, "Eviction candidates looked ahead for a cheaper victim (default 16, 0 = plain LRU)");
+module_param_named(evict_scan_depth, pddgpu_evict_scan_depth, int, 0644);
+
+int pddgpu_evict_max_skip = 8;
+
+MODULE_PARM_DESC(evict_max_skip, "Max consecutive eviction candidates skipped for cheaper ones (default 8)");
+module_param_named(evict_max_skip, pddgpu_evict_max_skip, int, 0644);
+
+int pddgpu_evict_weight_move = 100;
+
+MODULE_PARM_DESC(evict_weight_move, "Eviction cost weight of copy time in percent (default 100)");
+module_param_named(evict_weight_move, pddgpu_evict_weight_move, int, 0644);
+
+int pddgpu_evict_weight_fence = 100;
+
+MODULE_PARM_DESC(evict_weight_fence, "Eviction cost weight of waiting for busy BOs in percent (default 100)");
+module_param_named(evict_weight_fence, pddgpu_evict_weight_fence, int, 0644);
+
+int pddgpu_evict_weight_reuse = 100;
+
+MODULE_PARM_DESC(evict_weight_reuse, "Eviction cost weight of recently used BOs in percent (default 100)");
+module_param_named(evict_weight_reuse, pddgpu_evict_weight_reuse, int, 0644);
+
+int pddgpu_thrash_window_ms = 1000;
+
+MODULE_PARM_DESC(thrash_window_ms, "Window in ms for detecting BOs moving back and forth (default 1000)");
+module_param_named(thrash_window_ms, pddgpu_thrash_window_ms, int, 0644);
+
+int pddgpu_thrash_flips = 3;
+
+MODULE_PARM_DESC(thrash_flips, "Round trips within the window that mark a BO as thrashing (default 3, 0 = disable)");
+module_param_named(thrash_flips, pddgpu_thrash_flips, int, 0644);
+
+int pddgpu_thrash_backoff_ms = 500;
+
+MODULE_PARM_DESC(thrash_backoff_ms, "Time in ms a thrashing BO stays in its current domain, doubled on repeat (default 500)");
+module_param_named(thrash_backoff_ms, pddgpu_thrash_backoff_ms, int, 0644);
+
+int pddgpu_thrash_demote_strikes = 4;
+
+MODULE_PARM_DESC(thrash_demote_strikes, "Consecutive thrash detections before a BO is kept out of VRAM (default 4, 0 = never)");
+module_param_named(thrash_demote_strikes, pddgpu_thrash_demote_strikes, int, 0644);
+
+int pddgpu_reclaim_low_pct = 10;
+
+MODULE_PARM_DESC(reclaim_low_pct, "Free VRAM/GTT percentage that wakes background reclaim (default 10, 0 = disable)");
+module_param_named(reclaim_low_pct, pddgpu_reclaim_low_pct, int, 0644);
+
+int pddgpu_reclaim_high_pct = 20;
+
+MODULE_PARM_DESC(reclaim_high_pct, "Free VRAM/GTT percentage background reclaim stops at (default 20)");
+module_param_named(reclaim_high_pct, pddgpu_reclaim_high_pct, int, 0644);
+
+int pddgpu_reclaim_rate_mb = 256;
+
+MODULE_PARM_DESC(reclaim_rate_mb, "MB moved per background reclaim pass (default 256)");
+module_param_named(reclaim_rate_mb, pddgpu_reclaim_rate_mb, int, 0644);
+
+int pddgpu_reclaim_interval_ms = 10;
+
+MODULE_PARM_DESC(reclaim_interval_ms, "Delay in ms between background reclaim passes (default 10)");
+module_param_named(reclaim_interval_ms, pddgpu_reclaim_interval_ms, int, 0644);
+
+int pddgpu_reclaim_min_age_ms = 500;
+
+MODULE_PARM_DESC(reclaim_min_age_ms, "Minimum idle time in ms before background reclaim moves a BO (default 500)");
+module_param_named(reclaim_min_age_ms, pddgpu_reclaim_min_age_ms, int, 0644);
+
+int pddgpu_tier_interval_ms = 100;
+
+MODULE_PARM_DESC(tier_interval_ms, "Interval in ms between VRAM/GTT tiering passes (default 100, 0 = disable)");
+module_param_named(tier_interval_ms, pddgpu_tier_interval_ms, int, 0444);
+
+int pddgpu_tier_hot_threshold = 8;
+
+MODULE_PARM_DESC(tier_hot_threshold, "Decayed access count that makes a GTT fallback BO hot (default 8)");
+module_param_named(tier_hot_threshold, pddgpu_tier_hot_threshold, int, 0644);
+
+int pddgpu_tier_half_life_ms = 1000;
+
+MODULE_PARM_DESC(tier_half_life_ms, "Half-life in ms of BO access counts (default 1000)");
+module_param_named(tier_half_life_ms, pddgpu_tier_half_life_ms, int, 0644);
+
+int pddgpu_tier_migrate_mb_per_sec = 128;
+
+MODULE_PARM_DESC(tier_migrate_mb_per_sec, "Max MB per second moved by tiering promotions and demotions (default 128)");
+module_param_named(tier_migrate_mb_per_sec, pddgpu_tier_migrate_mb_per_sec, int, 0644);
+
+int pddgpu_moverate = -1;
+
+MODULE_PARM_DESC(moverate, "Max buffer migration rate in MB/s (default -1 = measured copy bandwidth, 0 = unthrottled)");
+module_param_named(moverate, pddgpu_moverate, int, 0644);
+
+int pddgpu_copy_chunk_kb = 1024;
+
+MODULE_PARM_DESC(copy_chunk_kb, "Chunk size in KB for parallel BO copies by the copy engine (default 1024, 0 = synchronous memcpy)");
+module_param_named(copy_chunk_kb, pddgpu_copy_chunk_kb, int, 0644);
+
+int pddgpu_simd_copy = 1;
+
+MODULE_PARM_DESC(simd_copy, "Use non-temporal SIMD loads and stores for CPU BO copies and clears (default 1, 0 = generic memcpy)");
+module_param_named(simd_copy, pddgpu_simd_copy, int, 0644);
+
+int pddgpu_benchmark = 0;
+
+MODULE_PARM_DESC(benchmark, "Run the BO move benchmark at device init (default 0 = off, 1 = on)");
+module_param_named(benchmark, pddgpu_benchmark, int, 0444);
+
+int pddgpu_pool_max_mb = 1024;
+
+MODULE_PARM_DESC(pool_max_mb, "Max MB of freed pages kept in the page pool for reuse (default 1024)");
+module_param_named(pool_max_mb, pddgpu_pool_max_mb, int, 0444);
+
+int pddgpu_pool_prewarm_mb = 64;
+
+MODULE_PARM_DESC(pool_prewarm_mb, "MB of write-combined pages allocated into the page pool at probe (default 64, 0 = none)");
+module_param_named(pool_prewarm_mb, pddgpu_pool_prewarm_mb, int, 0444);
+
+int pddgpu_huge_tt = 1;
+
+MODULE_PARM_DESC(huge_tt, "Back GTT BOs of 2 MB and larger with 2 MB pages where possible (default 1, 0 = off)");
+module_param_named(huge_tt, pddgpu_huge_tt, int, 0644);
+
+int pddgpu_populate_parallel_mb = 256;
+
+MODULE_PARM_DESC(populate_parallel_mb, "Populate GTT BOs of at least this many MB with parallel workers (default 256, 0 = off)");
+module_param_named(populate_parallel_mb, pddgpu_populate_parallel_mb, int, 0644);
+
+int pddgpu_sparse_chunk_kb = 64;
+
+MODULE_PARM_DESC(sparse_chunk_kb, "Population granularity in KB of sparse BOs, rounded to a power of two up to 2 MB (default 64)");
+module_param_named(sparse_chunk_kb, pddgpu_sparse_chunk_kb, int, 0644);
+
+int pddgpu_swap_min_age_ms = 5000;
+
+MODULE_PARM_DESC(swap_min_age_ms, "Minimum idle time in ms before a system memory BO may be swapped out under memory pressure (-1 = never, default 5000)");
+module_param_named(swap_min_age_ms, pddgpu_swap_min_age_ms, int, 0644);
+
+int pddgpu_compress_interval_ms = 0;
+
+MODULE_PARM_DESC(compress_interval_ms, "Interval in ms between passes that compress idle system memory BOs (default 0 = disable)");
+module_param_named(compress_interval_ms, pddgpu_compress_interval_ms, int, 0444);
+
+int pddgpu_compress_min_age_ms = 1000;
+
+MODULE_PARM_DESC(compress_min_age_ms, "Minimum idle time in ms before a system memory BO is compressed, keep below swap_min_age_ms (default 1000)");
+module_param_named(compress_min_age_ms, pddgpu_compress_min_age_ms, int, 0644);
+
+char *pddgpu_compress_alg = "lz4";
+
+MODULE_PARM_DESC(compress_alg, "Crypto API compression algorithm for idle BOs, e.g. lz4 or zstd (default lz4)");
+module_param_named(compress_alg, pddgpu_compress_alg, charp, 0444);
+
 /* DRM驱动结构 */
 static struct drm_driver pddgpu_driver = {
 	.driver_features = DRIVER_GEM | DRIVER_MODESET | DRIVER_ATOMIC,
@@ -43,6 +209,9 @@ static struct drm_driver pddgpu_driver = {
 	.gem_close_object = pddgpu_gem_close_object,
 	
 	/* 文件操作 */
+	.open = pddgpu_driver_open,
+	.postclose = pddgpu_driver_postclose,
+	.show_fdinfo = pddgpu_show_fdinfo,
 	.fops = &pddgpu_driver_fops,
 	
 	/* IOCTL */
@@ -50,7 +219,7 @@ static struct drm_driver pddgpu_driver = {
 	.num_ioctls = ARRAY_SIZE(pddgpu_ioctls),
 	
 	/* 调试 */
-#ifdef CONFIG_DRM_PDDGPU_DEBUG
+#ifdef CONFIG_DEBUG_FS
 	.debugfs_init = pddgpu_debugfs_init,
 #endif
 };
@@ -66,6 +235,7 @@ static const struct file_operations pddgpu_driver_fops = {
 	.read = drm_read,
 	.llseek = noop_llseek,
 	.mmap = pddgpu_mmap,
+	.show_fdinfo = drm_show_fdinfo,
 };
 
 /* IOCTL表 */
@@ -74,6 +244,9 @@ static const struct drm_ioctl_desc pddgpu_ioctls[] = {
 	DRM_IOCTL_DEF_DRV(PDDGPU_GEM_MAP, pddgpu_gem_map_ioctl, DRM_AUTH | DRM_UNLOCKED),
 	DRM_IOCTL_DEF_DRV(PDDGPU_GEM_INFO, pddgpu_gem_info_ioctl, DRM_AUTH | DRM_UNLOCKED),
 	DRM_IOCTL_DEF_DRV(PDDGPU_GEM_DESTROY, pddgpu_gem_destroy_ioctl, DRM_AUTH | DRM_UNLOCKED),
+	DRM_IOCTL_DEF_DRV(PDDGPU_GEM_PRIORITY, pddgpu_gem_priority_ioctl, DRM_AUTH | DRM_UNLOCKED),
+	DRM_IOCTL_DEF_DRV(PDDGPU_GEM_MADVISE, pddgpu_gem_madvise_ioctl, DRM_AUTH | DRM_UNLOCKED),
+	DRM_IOCTL_DEF_DRV(PDDGPU_GEM_PREFETCH, pddgpu_gem_prefetch_ioctl, DRM_AUTH | DRM_UNLOCKED),
 };
 
 /* PCI探测函数 */
@@ -201,6 +374,9 @@ static int __init pddgpu_init(void)
 
 	PDDGPU_INFO("PDDGPU driver initializing\n");
 
+	/* 按CPU特性选择复制和填充实现 */
+	pddgpu_memcpy_init();
+
 	ret = pci_register_driver(&pddgpu_pci_driver);
 	if (ret) {
 		PDDGPU_ERROR("Failed to register PCI driver\n");
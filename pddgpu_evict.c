@@ -0,0 +1,215 @@
+/*
+ * PDDGPU 驱逐代价评估实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/dma-resv.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_device.h>
+#include <drm/ttm/ttm_resource.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_evict.h"
+#include "include/pddgpu_thrash.h"
+#include "pddgpu_object.h"
+
+/* 各来源域被驱逐时的搬移带宽估计 (MB/s)，0表示无需复制 */
+static const u32 pddgpu_evict_bw_mbps[TTM_NUM_MEM_TYPES] = {
+	[TTM_PL_VRAM] = 12000,  /* VRAM -> GTT，经PCIe复制 */
+	[TTM_PL_TT] = 0,        /* GTT -> 系统内存，只需解绑 */
+};
+
+/* 权重为百分比，负值按0处理 */
+static inline u64 pddgpu_evict_weight(int weight)
+{
+	return max(weight, 0);
+}
+
+/* 初始化驱逐状态 */
+void pddgpu_evict_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_evict_state *evict = &pdev->mman.evict;
+	int i;
+
+	for (i = 0; i < TTM_NUM_MEM_TYPES; i++) {
+		atomic_set(&evict->walk[i].skip_streak, 0);
+	}
+	atomic64_set(&evict->scored, 0);
+	atomic64_set(&evict->accepted, 0);
+	atomic64_set(&evict->skipped, 0);
+	atomic64_set(&evict->forced, 0);
+	atomic64_set(&evict->cost_total_ns, 0);
+	atomic64_set(&evict->bytes_evicted, 0);
+}
+
+/* 计算驱逐BO的代价：搬移字节、目标带宽、最近使用时间和未完成栅栏 */
+void pddgpu_evict_score(struct pddgpu_bo *bo, struct pddgpu_evict_cost *cost)
+{
+	struct ttm_resource *res = bo->tbo.resource;
+	u64 size = bo->tbo.base.size;
+	u64 now = ktime_get_ns();
+	u64 last = READ_ONCE(bo->last_use_ns);
+	u64 age = now > last ? now - last : 0;
+	u32 bw = 0;
+
+	memset(cost, 0, sizeof(*cost));
+
+	if (!res || !size)
+		return;
+
+	if (res->mem_type < TTM_NUM_MEM_TYPES)
+		bw = pddgpu_evict_bw_mbps[res->mem_type];
+
+	if (bw)
+		cost->move_ns = div64_u64(size * NSEC_PER_SEC, (u64)bw << 20);
+	else
+		cost->move_ns = PFN_UP(size) * PDDGPU_EVICT_UNBIND_NS_PER_PAGE;
+
+	/* GPU仍在使用，驱逐需要先等待 */
+	if (!dma_resv_test_signaled(bo->tbo.base.resv, DMA_RESV_USAGE_BOOKKEEP))
+		cost->fence_ns = PDDGPU_EVICT_BUSY_NS;
+
+	/* 越近使用过越可能马上被换回，按年龄衰减 */
+	cost->reuse_ns = div64_u64(cost->move_ns * PDDGPU_EVICT_HOT_WINDOW_NS,
+	                           age + PDDGPU_EVICT_HOT_WINDOW_NS);
+
+	cost->score = div_u64(cost->move_ns * pddgpu_evict_weight(READ_ONCE(pddgpu_evict_weight_move)) +
+	                      cost->fence_ns * pddgpu_evict_weight(READ_ONCE(pddgpu_evict_weight_fence)) +
+	                      cost->reuse_ns * pddgpu_evict_weight(READ_ONCE(pddgpu_evict_weight_reuse)),
+	                      100);
+	cost->score_per_mb = div64_u64(cost->score << 20, size);
+}
+
+/*
+ * 在同一优先级的LRU上向后查找最多depth个候选，返回明显比当前候选便宜的
+ * 每MB代价，没有时返回U64_MAX。TTM调用eviction_valuable前已释放LRU锁，
+ * 这里重新获取；只看本轮遍历接下来会访问到的BO，参照不会来自已离开LRU
+ * 的BO或其他优先级。被锁住的BO会被本轮遍历跳过，不能作为参照。
+ */
+static u64 pddgpu_evict_cheaper_ahead(struct pddgpu_bo *bo, u64 score_per_mb,
+                                      int depth)
+{
+	struct ttm_device *bdev = bo->tbo.bdev;
+	struct ttm_resource *res = bo->tbo.resource;
+	struct ttm_resource_manager *man = ttm_manager_type(bdev, res->mem_type);
+	struct pddgpu_evict_cost cost;
+	struct ttm_lru_item *lru = &res->lru;
+	u64 cheaper = U64_MAX;
+
+	spin_lock(&bdev->lru_lock);
+
+	if (list_empty(&lru->link))
+		goto out_unlock;
+
+	list_for_each_entry_continue(lru, &man->lru[bo->tbo.priority], link) {
+		struct ttm_buffer_object *tbo;
+		struct pddgpu_bo *abo;
+
+		if (!ttm_lru_item_is_res(lru))
+			continue;
+
+		if (depth-- <= 0)
+			break;
+
+		/* 持有lru_lock期间资源仍在LRU上，BO不会被释放 */
+		tbo = ttm_lru_item_to_res(lru)->bo;
+		if (!tbo || !pddgpu_bo_is_pddgpu_bo(tbo) || tbo->pin_count ||
+		    dma_resv_is_locked(tbo->base.resv))
+			continue;
+
+		abo = to_pddgpu_bo(tbo);
+		if (pddgpu_thrash_bo_held(abo))
+			continue;
+
+		/* DONTNEED的BO直接丢弃，总是比需要复制的候选便宜 */
+		if (abo->madv == PDDGPU_MADV_DONTNEED) {
+			cheaper = 0;
+			break;
+		}
+
+		pddgpu_evict_score(abo, &cost);
+		if (cost.score_per_mb * 100 <
+		    score_per_mb * (100 - PDDGPU_EVICT_MIN_GAIN_PCT)) {
+			cheaper = cost.score_per_mb;
+			break;
+		}
+	}
+
+out_unlock:
+	spin_unlock(&bdev->lru_lock);
+
+	return cheaper;
+}
+
+/*
+ * 判断候选BO是否值得驱逐，由TTM在遍历LRU时调用。TTM拒绝当前候选后会
+ * 继续询问后面的BO，本轮遍历后面还有明显更便宜的候选时跳过当前候选，
+ * 后面没有更便宜的候选时总是接受，不会让分配因跳过而失败。
+ */
+bool pddgpu_evict_valuable(struct pddgpu_bo *bo, const struct ttm_place *place)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_evict_state *evict = &pdev->mman.evict;
+	int depth = READ_ONCE(pddgpu_evict_scan_depth);
+	struct pddgpu_evict_walk *walk;
+	struct pddgpu_evict_cost cost;
+	u64 cheaper;
+
+	/* 关闭代价评估时退化为纯LRU */
+	if (depth <= 0 || !bo->tbo.resource ||
+	    bo->tbo.resource->mem_type >= TTM_NUM_MEM_TYPES)
+		return true;
+
+	walk = &evict->walk[bo->tbo.resource->mem_type];
+
+	pddgpu_evict_score(bo, &cost);
+	atomic64_inc(&evict->scored);
+
+	if (atomic_read(&walk->skip_streak) < READ_ONCE(pddgpu_evict_max_skip)) {
+		cheaper = pddgpu_evict_cheaper_ahead(bo, cost.score_per_mb, depth);
+		if (cheaper != U64_MAX) {
+			atomic_inc(&walk->skip_streak);
+			atomic64_inc(&evict->skipped);
+			PDDGPU_DEBUG("Evict skip %p: %llu ns/MB, cheaper ahead %llu ns/MB\n",
+			             bo, cost.score_per_mb, cheaper);
+			return false;
+		}
+	} else {
+		atomic64_inc(&evict->forced);
+	}
+
+	atomic_set(&walk->skip_streak, 0);
+	atomic64_inc(&evict->accepted);
+	atomic64_add(cost.score, &evict->cost_total_ns);
+	atomic64_add(bo->tbo.base.size, &evict->bytes_evicted);
+
+	PDDGPU_DEBUG("Evict victim %p: mem_type=%u, size=%zu KB, move=%llu ns, "
+	             "fence=%llu ns, reuse=%llu ns, score=%llu ns (%llu ns/MB)\n",
+	             bo, bo->tbo.resource->mem_type, bo->tbo.base.size >> 10,
+	             cost.move_ns, cost.fence_ns, cost.reuse_ns,
+	             cost.score, cost.score_per_mb);
+
+	return true;
+}
+
+/* 调试打印 */
+void pddgpu_evict_debug_print(struct pddgpu_device *pdev,
+                              struct drm_printer *p)
+{
+	struct pddgpu_evict_state *evict = &pdev->mman.evict;
+	u64 accepted = atomic64_read(&evict->accepted);
+
+	drm_printf(p, "Eviction Debug Info:\n");
+	drm_printf(p, "  Scored=%llu, Accepted=%llu, Skipped=%llu, Forced=%llu\n",
+	           atomic64_read(&evict->scored), accepted,
+	           atomic64_read(&evict->skipped), atomic64_read(&evict->forced));
+	drm_printf(p, "  Evicted=%llu MB, Avg_Cost=%llu ns\n",
+	           atomic64_read(&evict->bytes_evicted) >> 20,
+	           accepted ? div64_u64(atomic64_read(&evict->cost_total_ns), accepted) : 0);
+}
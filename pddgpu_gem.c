@@ -4,10 +4,16 @@
  * Copyright (C) 2024 PDDGPU Project
  */
 
+#include <linux/capability.h>
+#include <linux/file.h>
+#include <linux/sync_file.h>
+
+#include <drm/drm_auth.h>
 #include <drm/drm_gem.h>
 #include <drm/drm_gem_shmem_helper.h>
 #include <drm/drm_file.h>
 #include <drm/drm_ioctl.h>
+#include <drm/drm_vma_manager.h>
 
 #include "include/pddgpu_drv.h"
 #include "pddgpu_object.h"
@@ -61,16 +67,28 @@ int pddgpu_gem_create_ioctl(struct drm_device *dev, void *data,
 		PDDGPU_ERROR("Invalid alignment: %u\n", args->alignment);
 		return -EINVAL;
 	}
+
+	/* GTT缓存属性只能选一种 */
+	if ((args->flags & PDDGPU_GEM_CREATE_CPU_GTT_USWC) &&
+	    (args->flags & PDDGPU_GEM_CREATE_CPU_GTT_UNCACHED)) {
+		PDDGPU_ERROR("Conflicting GTT caching flags: 0x%x\n", args->flags);
+		return -EINVAL;
+	}
 	
 	/* 设置创建参数 */
 	bp.size = args->size;
 	bp.alignment = args->alignment;
 	bp.domain = args->domains;
+	bp.preferred_domain = args->domains;
 	bp.flags = args->flags;
+	/* 异步创建的BO先不分配后备存储，由后台完成放置 */
+	if (args->flags & PDDGPU_GEM_CREATE_ASYNC)
+		bp.flags |= PDDGPU_GEM_CREATE_LAZY_PLACEMENT;
 	bp.type = ttm_bo_type_device;
 	bp.resv = NULL;
 	bp.bo_ptr_size = sizeof(struct pddgpu_bo);
 	bp.destroy = pddgpu_bo_destroy;
+	bp.owner = filp->driver_priv;
 	
 	/* 创建缓冲区对象 */
 	ret = pddgpu_bo_create(pdev, &bp, &bo);
@@ -89,6 +107,11 @@ int pddgpu_gem_create_ioctl(struct drm_device *dev, void *data,
 		return ret;
 	}
 	
+	/* 句柄立即返回，放置、清理和填充在后台进行 */
+	if ((args->flags & PDDGPU_GEM_CREATE_ASYNC) &&
+	    pddgpu_bo_queue_async_setup(bo))
+		PDDGPU_DEBUG("Async setup unavailable, BO placed on first use\n");
+	
 	PDDGPU_DEBUG("GEM created: handle=%u, size=%llu\n", args->handle, args->size);
 	
 	return 0;
@@ -100,7 +123,6 @@ int pddgpu_gem_map_ioctl(struct drm_device *dev, void *data,
 {
 	struct drm_pddgpu_gem_map *args = data;
 	struct drm_gem_object *gobj;
-	struct pddgpu_bo *bo;
 	int ret;
 	
 	PDDGPU_DEBUG("GEM map: handle=%u, offset=%llu, size=%llu, flags=0x%llx\n",
@@ -113,29 +135,31 @@ int pddgpu_gem_map_ioctl(struct drm_device *dev, void *data,
 		return -ENOENT;
 	}
 	
-	bo = to_pddgpu_bo(gobj);
-	
 	/* 验证参数 */
-	if (args->offset + args->size > gobj->size) {
+	if (args->offset < gobj->size && !args->size)
+		args->size = gobj->size - args->offset;
+
+	if (!PAGE_ALIGNED(args->offset) || args->offset >= gobj->size ||
+	    args->size > gobj->size - args->offset) {
 		PDDGPU_ERROR("Invalid mapping range\n");
 		drm_gem_object_put(gobj);
 		return -EINVAL;
 	}
 	
-	/* 映射BO */
-	ret = ttm_bo_kmap(&bo->tbo, args->offset, args->size, &bo->kptr);
+	/* 创建mmap伪偏移，实际映射在缺页时建立 */
+	ret = drm_gem_create_mmap_offset(gobj);
 	if (ret) {
-		PDDGPU_ERROR("Failed to map BO: %d\n", ret);
+		PDDGPU_ERROR("Failed to create mmap offset: %d\n", ret);
 		drm_gem_object_put(gobj);
 		return ret;
 	}
 	
-	/* 返回映射地址 */
-	args->offset = (u64)bo->kptr;
+	/* 返回可直接传给mmap()的偏移 */
+	args->offset += drm_vma_node_offset_addr(&gobj->vma_node);
 	
 	drm_gem_object_put(gobj);
 	
-	PDDGPU_DEBUG("GEM mapped: addr=0x%llx\n", args->offset);
+	PDDGPU_DEBUG("GEM mapped: mmap offset=0x%llx\n", args->offset);
 	
 	return 0;
 }
@@ -173,6 +197,137 @@ int pddgpu_gem_info_ioctl(struct drm_device *dev, void *data,
 	return 0;
 }
 
+/* GEM优先级IOCTL */
+int pddgpu_gem_priority_ioctl(struct drm_device *dev, void *data,
+                              struct drm_file *filp)
+{
+	struct drm_pddgpu_gem_priority *args = data;
+	struct drm_gem_object *gobj;
+	int ret;
+	
+	PDDGPU_DEBUG("GEM priority: handle=%u, priority=%u\n",
+	             args->handle, args->priority);
+	
+	if (args->priority > PDDGPU_BO_PRIORITY_CRITICAL)
+		return -EINVAL;
+	
+	/* 常驻优先级会挤占其他进程的显存，需要特权 */
+	if (args->priority == PDDGPU_BO_PRIORITY_CRITICAL &&
+	    !capable(CAP_SYS_NICE) && !drm_is_current_master(filp))
+		return -EACCES;
+	
+	/* 获取GEM对象 */
+	gobj = drm_gem_object_lookup(filp, args->handle);
+	if (!gobj) {
+		PDDGPU_ERROR("Invalid handle: %u\n", args->handle);
+		return -ENOENT;
+	}
+	
+	ret = pddgpu_bo_set_priority(to_pddgpu_bo(gobj), args->priority);
+	
+	drm_gem_object_put(gobj);
+	
+	return ret;
+}
+
+/* GEM madvise IOCTL */
+int pddgpu_gem_madvise_ioctl(struct drm_device *dev, void *data,
+                             struct drm_file *filp)
+{
+	struct drm_pddgpu_gem_madvise *args = data;
+	struct drm_gem_object *gobj;
+	bool retained = false;
+	int ret;
+	
+	PDDGPU_DEBUG("GEM madvise: handle=%u, madv=%u\n", args->handle, args->madv);
+	
+	if (args->pad)
+		return -EINVAL;
+	
+	/* 获取GEM对象 */
+	gobj = drm_gem_object_lookup(filp, args->handle);
+	if (!gobj) {
+		PDDGPU_ERROR("Invalid handle: %u\n", args->handle);
+		return -ENOENT;
+	}
+	
+	ret = pddgpu_bo_madvise(to_pddgpu_bo(gobj), args->madv, &retained);
+	if (!ret)
+		args->retained = retained;
+	
+	drm_gem_object_put(gobj);
+	
+	return ret;
+}
+
+/* GEM预取IOCTL：把一组BO异步迁移到目标域，立即返回栅栏 */
+int pddgpu_gem_prefetch_ioctl(struct drm_device *dev, void *data,
+                              struct drm_file *filp)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(dev);
+	struct drm_pddgpu_gem_prefetch *args = data;
+	struct drm_gem_object **objs = NULL;
+	struct sync_file *sync_file;
+	struct dma_fence *fence;
+	u32 i;
+	int fd, ret;
+	
+	PDDGPU_DEBUG("GEM prefetch: num_handles=%u, domain=0x%x\n",
+	             args->num_handles, args->domain);
+	
+	if (args->flags || !args->num_handles ||
+	    args->num_handles > PDDGPU_PREFETCH_MAX_BOS)
+		return -EINVAL;
+	
+	if (args->domain != PDDGPU_GEM_DOMAIN_CPU &&
+	    args->domain != PDDGPU_GEM_DOMAIN_GTT &&
+	    args->domain != PDDGPU_GEM_DOMAIN_VRAM)
+		return -EINVAL;
+	
+	/* 获取GEM对象 */
+	ret = drm_gem_objects_lookup(filp, u64_to_user_ptr(args->handles),
+	                             args->num_handles, &objs);
+	if (ret)
+		goto err_put;
+	
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		ret = fd;
+		goto err_put;
+	}
+	
+	/* 提交后objs归预取工作所有 */
+	fence = pddgpu_prefetch_submit(pdev, filp->driver_priv, objs,
+	                               args->num_handles, args->domain);
+	if (IS_ERR(fence)) {
+		put_unused_fd(fd);
+		ret = PTR_ERR(fence);
+		goto err_put;
+	}
+	
+	sync_file = sync_file_create(fence);
+	dma_fence_put(fence);
+	if (!sync_file) {
+		put_unused_fd(fd);
+		return -ENOMEM;
+	}
+	
+	fd_install(fd, sync_file->file);
+	args->fence_fd = fd;
+	
+	return 0;
+	
+err_put:
+	if (objs) {
+		for (i = 0; i < args->num_handles; i++)
+			if (objs[i])
+				drm_gem_object_put(objs[i]);
+		kvfree(objs);
+	}
+	
+	return ret;
+}
+
 /* GEM销毁IOCTL */
 int pddgpu_gem_destroy_ioctl(struct drm_device *dev, void *data,
                               struct drm_file *filp)
@@ -210,6 +365,9 @@ int pddgpu_gem_open_object(struct drm_gem_object *obj, struct drm_file *file)
 	
 	PDDGPU_DEBUG("GEM open object: %p\n", obj);
 	
+	/* 其他文件打开同一个BO后计为共享 */
+	pddgpu_client_bo_set_shared(bo, obj->handle_count > 1 || obj->dma_buf);
+	
 	/* 增加引用计数 */
 	ttm_bo_get(&bo->tbo);
 	
@@ -223,6 +381,9 @@ void pddgpu_gem_close_object(struct drm_gem_object *obj, struct drm_file *file)
 	
 	PDDGPU_DEBUG("GEM close object: %p\n", obj);
 	
+	/* 此时handle_count仍包含正在关闭的句柄 */
+	pddgpu_client_bo_set_shared(bo, obj->handle_count > 2 || obj->dma_buf);
+	
 	/* 减少引用计数 */
 	ttm_bo_put(&bo->tbo);
 }
@@ -255,30 +416,64 @@ void pddgpu_gem_print_info(struct drm_printer *p, unsigned int indent,
 struct dma_buf *pddgpu_gem_prime_export(struct drm_gem_object *obj, int flags)
 {
 	struct pddgpu_bo *bo = to_pddgpu_bo(obj);
+	struct dma_buf *dmabuf;
+	bool purgeable;
+	int r;
 	
 	PDDGPU_DEBUG("GEM prime export: %p\n", obj);
 	
+	/* 导入方无法得知内容被丢弃，可丢弃或已丢弃的BO不能共享 */
+	r = dma_resv_lock_interruptible(obj->resv, NULL);
+	if (r)
+		return ERR_PTR(r);
+	purgeable = bo->madv != PDDGPU_MADV_WILLNEED || bo->purged;
+	dma_resv_unlock(obj->resv);
+	if (purgeable)
+		return ERR_PTR(-EINVAL);
+	
 	/* 使用TTM的DMA-BUF导出 */
-	return drm_gem_dmabuf_export(obj->dev, obj, flags);
+	dmabuf = drm_gem_dmabuf_export(obj->dev, obj, flags);
+	if (!IS_ERR(dmabuf))
+		pddgpu_client_bo_set_shared(bo, true);
+	
+	return dmabuf;
 }
 
 /* GEM Prime vmap */
 int pddgpu_gem_prime_vmap(struct drm_gem_object *obj, struct iosys_map *map)
 {
 	struct pddgpu_bo *bo = to_pddgpu_bo(obj);
+	bool is_iomem;
+	void *vaddr;
 	int ret;
 	
 	PDDGPU_DEBUG("GEM prime vmap: %p\n", obj);
 	
-	/* 映射BO */
-	ret = ttm_bo_kmap(&bo->tbo, 0, obj->size, &bo->kptr);
+	/* 延迟放置的BO在首次映射时分配后备存储 */
+	ret = pddgpu_bo_lazy_place(bo, PDDGPU_MOVE_PRIO_INLINE);
+	if (ret)
+		return ret;
+	
+	/* 等待后台清理等内核操作完成 */
+	ret = dma_resv_wait_timeout(obj->resv, DMA_RESV_USAGE_KERNEL,
+				    false, MAX_SCHEDULE_TIMEOUT);
+	if (ret < 0)
+		return ret;
+	
+	pddgpu_bo_touch(bo);
+	
+	/* 从设备映射缓存获取映射，重复vmap无需重新映射 */
+	ret = pddgpu_kmap_cache_get(bo, 0, PFN_UP(obj->size), &vaddr, &is_iomem);
 	if (ret) {
 		PDDGPU_ERROR("Failed to map BO: %d\n", ret);
 		return ret;
 	}
 	
 	/* 设置映射信息 */
-	iosys_map_set_vaddr(map, bo->kptr);
+	if (is_iomem)
+		iosys_map_set_vaddr_iomem(map, (void __iomem *)vaddr);
+	else
+		iosys_map_set_vaddr(map, vaddr);
 	
 	return 0;
 }
@@ -290,11 +485,11 @@ void pddgpu_gem_prime_vunmap(struct drm_gem_object *obj, struct iosys_map *map)
 	
 	PDDGPU_DEBUG("GEM prime vunmap: %p\n", obj);
 	
-	/* 取消映射 */
-	if (bo->kptr) {
-		ttm_bo_kunmap(&bo->tbo, 0);
-		bo->kptr = NULL;
-	}
+	/* 映射归还缓存，真正拆除由LRU或收缩器完成 */
+	if (map->is_iomem)
+		pddgpu_kmap_cache_put(bo, (void __force *)map->vaddr_iomem);
+	else
+		pddgpu_kmap_cache_put(bo, map->vaddr);
 }
 
 /* GEM Prime mmap */
@@ -306,11 +501,29 @@ int pddgpu_gem_prime_mmap(struct drm_gem_object *obj, struct vm_area_struct *vma
 	PDDGPU_DEBUG("GEM prime mmap: %p\n", obj);
 	
 	/* 使用TTM的mmap */
-	ret = ttm_bo_mmap(&bo->tbo, vma);
+	ret = ttm_bo_mmap_obj(vma, &bo->tbo);
 	if (ret) {
 		PDDGPU_ERROR("Failed to mmap BO: %d\n", ret);
 		return ret;
 	}
 	
+	/* 使用驱动自己的缺页处理，支持预映射和大页映射 */
+	vma->vm_ops = bo->flags & PDDGPU_GEM_CREATE_SPARSE ?
+		&pddgpu_ttm_sparse_vm_ops : &pddgpu_ttm_vm_ops;
+	
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/* THP为madvise模式时，只有VM_HUGEPAGE的VMA才会调用huge_fault */
+	if (!(bo->flags & PDDGPU_GEM_CREATE_SPARSE) &&
+	    bo->preferred_domains & PDDGPU_GEM_DOMAIN_VRAM)
+		vm_flags_set(vma, VM_HUGEPAGE);
+#endif
+	
 	return 0;
 }
+
+/* 设备文件mmap */
+int pddgpu_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	/* 根据伪偏移查找GEM对象，并调用其mmap回调 */
+	return drm_gem_mmap(filp, vma);
+}
@@ -60,6 +60,7 @@ static int pddgpu_gtt_mgr_alloc(struct ttm_resource_manager *man,
 	struct pddgpu_gtt_mgr *mgr = to_gtt_mgr(man);
 	struct pddgpu_device *pdev = container_of(mgr, struct pddgpu_device, mman.gtt_mgr);
 	uint32_t num_pages = PFN_UP(bo->base.size);
+	uint32_t alignment = bo->page_alignment;
 	struct ttm_range_mgr_node *node;
 	int r, retry_count = 0;
 	unsigned long flags;
@@ -100,6 +101,10 @@ static int pddgpu_gtt_mgr_alloc(struct ttm_resource_manager *man,
 		goto err_free;
 	}
 
+	/* 大BO的GART地址按2MB对齐，大页后备的ttm_tt可以按大片段绑定 */
+	if (READ_ONCE(pddgpu_huge_tt) && num_pages >= PDDGPU_POOL_HUGE_PAGES)
+		alignment = max_t(uint32_t, alignment, PDDGPU_POOL_HUGE_PAGES);
+
 	/* 重试机制 */
 retry_alloc:
 	/* 分配 GTT 地址空间 */
@@ -115,7 +120,7 @@ retry_alloc:
 		}
 
 		r = drm_mm_insert_node_in_range(&mgr->mm, &node->mm_nodes[0],
-						num_pages, bo->page_alignment,
+						num_pages, alignment,
 						0, place->fpfn, place->lpfn,
 						DRM_MM_INSERT_BEST);
 		spin_unlock(&mgr->lock);
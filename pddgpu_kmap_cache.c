@@ -0,0 +1,392 @@
+/*
+ * PDDGPU 内核映射缓存实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/shrinker.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_kmap_cache.h"
+#include "pddgpu_object.h"
+
+static inline u64 pddgpu_kmap_entry_size(struct pddgpu_kmap_entry *entry)
+{
+	return (u64)entry->num_pages << PAGE_SHIFT;
+}
+
+/* 拆除映射，调用者需持有cache->lock且映射已从所有链表摘除 */
+static void pddgpu_kmap_entry_free(struct pddgpu_kmap_cache *cache,
+                                   struct pddgpu_kmap_entry *entry)
+{
+	cache->mapped_bytes -= pddgpu_kmap_entry_size(entry);
+	if (entry->pfn_mapped)
+		vunmap(entry->vaddr);
+	else
+		ttm_bo_kunmap(&entry->map);
+	kfree(entry);
+}
+
+/*
+ * 不连续的VRAM没有线性总线地址，ttm_bo_kmap()无法映射；
+ * 逐段收集各buddy块的页帧号，用vmap_pfn()拼成一段线性的写合并映射
+ */
+static void *pddgpu_kmap_vram_pfn(struct pddgpu_device *pdev,
+                                  struct ttm_resource *res,
+                                  unsigned long start_page,
+                                  unsigned long num_pages)
+{
+	u64 offset = (u64)start_page << PAGE_SHIFT;
+	unsigned long *pfns, i = 0;
+	u64 addr, contig;
+	void *vaddr;
+
+	if (pddgpu_vram_mgr_res_visible_size(pdev, res) < res->size)
+		return NULL;
+
+	pfns = kvmalloc_array(num_pages, sizeof(*pfns), GFP_KERNEL);
+	if (!pfns)
+		return NULL;
+
+	while (i < num_pages) {
+		addr = pddgpu_vram_mgr_res_addr(res, offset, &contig);
+		for (; contig >= PAGE_SIZE && i < num_pages; contig -= PAGE_SIZE) {
+			pfns[i++] = PHYS_PFN(pdev->gmc.fb_start + addr);
+			addr += PAGE_SIZE;
+			offset += PAGE_SIZE;
+		}
+	}
+
+	vaddr = vmap_pfn(pfns, num_pages, pgprot_writecombine(PAGE_KERNEL));
+	kvfree(pfns);
+
+	return vaddr;
+}
+
+/* 回收空闲映射直到满足目标，返回回收的页数 */
+static unsigned long pddgpu_kmap_cache_evict(struct pddgpu_kmap_cache *cache,
+                                             u64 target_bytes)
+{
+	struct pddgpu_kmap_entry *entry, *tmp;
+	unsigned long freed = 0;
+
+	lockdep_assert_held(&cache->lock);
+
+	list_for_each_entry_safe(entry, tmp, &cache->lru, lru) {
+		if (cache->mapped_bytes <= target_bytes)
+			break;
+
+		list_del(&entry->lru);
+		list_del(&entry->bo_link);
+		cache->idle_bytes -= pddgpu_kmap_entry_size(entry);
+		freed += entry->num_pages;
+		pddgpu_kmap_entry_free(cache, entry);
+		atomic64_inc(&cache->evictions);
+	}
+
+	return freed;
+}
+
+/* 收缩器：统计可回收的空闲映射 */
+static unsigned long pddgpu_kmap_cache_shrinker_count(struct shrinker *shrink,
+                                                      struct shrink_control *sc)
+{
+	struct pddgpu_kmap_cache *cache = shrink->private_data;
+	unsigned long count = READ_ONCE(cache->idle_bytes) >> PAGE_SHIFT;
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+/* 收缩器：按LRU顺序拆除空闲映射，释放vmalloc空间 */
+static unsigned long pddgpu_kmap_cache_shrinker_scan(struct shrinker *shrink,
+                                                     struct shrink_control *sc)
+{
+	struct pddgpu_kmap_cache *cache = shrink->private_data;
+	unsigned long freed;
+	u64 target;
+
+	/* 避免在持锁路径中递归回收 */
+	if (!mutex_trylock(&cache->lock))
+		return SHRINK_STOP;
+
+	target = cache->mapped_bytes -
+		 min_t(u64, cache->mapped_bytes, (u64)sc->nr_to_scan << PAGE_SHIFT);
+	freed = pddgpu_kmap_cache_evict(cache, target);
+
+	mutex_unlock(&cache->lock);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+/* 初始化内核映射缓存 */
+int pddgpu_kmap_cache_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_kmap_cache *cache = &pdev->mman.kmap_cache;
+
+	PDDGPU_DEBUG("Initializing kmap cache\n");
+
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->lru);
+	cache->mapped_bytes = 0;
+	cache->idle_bytes = 0;
+	cache->max_bytes = (u64)max(pddgpu_kmap_cache_size, 0) << 20;
+
+	atomic64_set(&cache->hits, 0);
+	atomic64_set(&cache->misses, 0);
+	atomic64_set(&cache->evictions, 0);
+	atomic64_set(&cache->invalidations, 0);
+
+	cache->shrinker = shrinker_alloc(0, "drm-pddgpu_kmap");
+	if (!cache->shrinker) {
+		PDDGPU_ERROR("Failed to allocate kmap cache shrinker\n");
+		return -ENOMEM;
+	}
+
+	cache->shrinker->count_objects = pddgpu_kmap_cache_shrinker_count;
+	cache->shrinker->scan_objects = pddgpu_kmap_cache_shrinker_scan;
+	cache->shrinker->private_data = cache;
+	shrinker_register(cache->shrinker);
+
+	PDDGPU_DEBUG("Kmap cache initialized: max=%llu MB\n", cache->max_bytes >> 20);
+
+	return 0;
+}
+
+/* 清理内核映射缓存 */
+void pddgpu_kmap_cache_fini(struct pddgpu_device *pdev)
+{
+	struct pddgpu_kmap_cache *cache = &pdev->mman.kmap_cache;
+
+	PDDGPU_DEBUG("Finalizing kmap cache\n");
+
+	if (cache->shrinker) {
+		shrinker_free(cache->shrinker);
+		cache->shrinker = NULL;
+	}
+
+	mutex_lock(&cache->lock);
+	pddgpu_kmap_cache_evict(cache, 0);
+	WARN_ON(cache->mapped_bytes);
+	mutex_unlock(&cache->lock);
+
+	mutex_destroy(&cache->lock);
+}
+
+/* 获取BO指定范围的内核映射 */
+int pddgpu_kmap_cache_get(struct pddgpu_bo *bo, unsigned long start_page,
+                          unsigned long num_pages, void **ptr, bool *is_iomem)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_kmap_cache *cache = &pdev->mman.kmap_cache;
+	struct pddgpu_kmap_entry *entry, *new_entry;
+	u64 contig = U64_MAX;
+	int r;
+
+	dma_resv_assert_held(bo->tbo.base.resv);
+
+	if (!num_pages || start_page + num_pages > PFN_UP(bo->tbo.base.size))
+		return -EINVAL;
+
+	mutex_lock(&cache->lock);
+
+	/* 命中：已有映射覆盖请求范围，失效映射指向BO旧位置，不能复用 */
+	list_for_each_entry(entry, &bo->kmap_entries, bo_link) {
+		if (entry->stale)
+			continue;
+
+		if (start_page < entry->start_page ||
+		    start_page + num_pages > entry->start_page + entry->num_pages)
+			continue;
+
+		if (!entry->ref_count++) {
+			list_del_init(&entry->lru);
+			cache->idle_bytes -= pddgpu_kmap_entry_size(entry);
+		}
+		entry->last_use = ktime_get_ns();
+		mutex_unlock(&cache->lock);
+
+		*ptr = entry->vaddr + ((start_page - entry->start_page) << PAGE_SHIFT);
+		if (is_iomem)
+			*is_iomem = entry->is_iomem;
+
+		atomic64_inc(&cache->hits);
+		return 0;
+	}
+
+	/* 为新映射腾出空间 */
+	if (cache->max_bytes)
+		pddgpu_kmap_cache_evict(cache, cache->max_bytes -
+		                        min_t(u64, cache->max_bytes,
+		                              (u64)num_pages << PAGE_SHIFT));
+
+	mutex_unlock(&cache->lock);
+
+	atomic64_inc(&cache->misses);
+
+	/* 未命中：建立新映射，BO预留锁保证期间不会被移动 */
+	r = pddgpu_ttm_sparse_populate(&bo->tbo, start_page, num_pages);
+	if (r)
+		return r;
+
+	new_entry = kzalloc(sizeof(*new_entry), GFP_KERNEL);
+	if (!new_entry)
+		return -ENOMEM;
+
+	if (bo->tbo.resource && bo->tbo.resource->mem_type == TTM_PL_VRAM)
+		pddgpu_vram_mgr_res_addr(bo->tbo.resource, 0, &contig);
+
+	if (bo->tbo.resource && contig < bo->tbo.resource->size) {
+		new_entry->vaddr = pddgpu_kmap_vram_pfn(pdev, bo->tbo.resource,
+		                                        start_page, num_pages);
+		if (!new_entry->vaddr) {
+			kfree(new_entry);
+			return -ENOMEM;
+		}
+		new_entry->pfn_mapped = true;
+		new_entry->is_iomem = true;
+	} else {
+		r = ttm_bo_kmap(&bo->tbo, start_page, num_pages, &new_entry->map);
+		if (r) {
+			kfree(new_entry);
+			return r;
+		}
+		new_entry->vaddr = ttm_kmap_obj_virtual(&new_entry->map,
+		                                        &new_entry->is_iomem);
+	}
+
+	new_entry->bo = bo;
+	new_entry->start_page = start_page;
+	new_entry->num_pages = num_pages;
+	new_entry->ref_count = 1;
+	new_entry->last_use = ktime_get_ns();
+	INIT_LIST_HEAD(&new_entry->lru);
+
+	mutex_lock(&cache->lock);
+	list_add(&new_entry->bo_link, &bo->kmap_entries);
+	cache->mapped_bytes += pddgpu_kmap_entry_size(new_entry);
+	mutex_unlock(&cache->lock);
+
+	*ptr = new_entry->vaddr;
+	if (is_iomem)
+		*is_iomem = new_entry->is_iomem;
+
+	return 0;
+}
+
+/* 释放内核映射引用，映射保留在缓存中供下次复用 */
+void pddgpu_kmap_cache_put(struct pddgpu_bo *bo, void *ptr)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_kmap_cache *cache = &pdev->mman.kmap_cache;
+	struct pddgpu_kmap_entry *entry;
+
+	mutex_lock(&cache->lock);
+
+	list_for_each_entry(entry, &bo->kmap_entries, bo_link) {
+		if (ptr < entry->vaddr ||
+		    ptr >= entry->vaddr + pddgpu_kmap_entry_size(entry) ||
+		    !entry->ref_count)
+			continue;
+
+		if (--entry->ref_count)
+			goto out_unlock;
+
+		/* BO已移动，旧映射不能再复用 */
+		if (entry->stale) {
+			list_del(&entry->bo_link);
+			pddgpu_kmap_entry_free(cache, entry);
+			goto out_unlock;
+		}
+
+		entry->last_use = ktime_get_ns();
+		list_add_tail(&entry->lru, &cache->lru);
+		cache->idle_bytes += pddgpu_kmap_entry_size(entry);
+
+		if (cache->max_bytes && cache->mapped_bytes > cache->max_bytes)
+			pddgpu_kmap_cache_evict(cache, cache->max_bytes);
+		goto out_unlock;
+	}
+
+	WARN(1, "PDDGPU: unbalanced kmap cache put %p\n", ptr);
+
+out_unlock:
+	mutex_unlock(&cache->lock);
+}
+
+/* BO移动前使其所有映射失效 */
+void pddgpu_kmap_cache_invalidate(struct pddgpu_bo *bo)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_kmap_cache *cache = &pdev->mman.kmap_cache;
+	struct pddgpu_kmap_entry *entry, *tmp;
+
+	if (list_empty_careful(&bo->kmap_entries))
+		return;
+
+	mutex_lock(&cache->lock);
+
+	list_for_each_entry_safe(entry, tmp, &bo->kmap_entries, bo_link) {
+		atomic64_inc(&cache->invalidations);
+
+		/* 仍被使用的映射在最后一个引用释放时拆除 */
+		if (entry->ref_count) {
+			WARN_ONCE(!entry->stale,
+			          "PDDGPU: moving BO with active kernel mapping\n");
+			entry->stale = true;
+			continue;
+		}
+
+		list_del(&entry->lru);
+		list_del(&entry->bo_link);
+		cache->idle_bytes -= pddgpu_kmap_entry_size(entry);
+		pddgpu_kmap_entry_free(cache, entry);
+	}
+
+	mutex_unlock(&cache->lock);
+}
+
+/* BO销毁时拆除所有映射 */
+void pddgpu_kmap_cache_bo_fini(struct pddgpu_bo *bo)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_kmap_cache *cache = &pdev->mman.kmap_cache;
+	struct pddgpu_kmap_entry *entry, *tmp;
+
+	mutex_lock(&cache->lock);
+
+	list_for_each_entry_safe(entry, tmp, &bo->kmap_entries, bo_link) {
+		WARN_ON(entry->ref_count);
+
+		if (!entry->ref_count) {
+			list_del(&entry->lru);
+			cache->idle_bytes -= pddgpu_kmap_entry_size(entry);
+		}
+		list_del(&entry->bo_link);
+		pddgpu_kmap_entry_free(cache, entry);
+	}
+
+	mutex_unlock(&cache->lock);
+}
+
+/* 调试打印 */
+void pddgpu_kmap_cache_debug_print(struct pddgpu_device *pdev,
+                                   struct drm_printer *p)
+{
+	struct pddgpu_kmap_cache *cache = &pdev->mman.kmap_cache;
+
+	drm_printf(p, "Kmap Cache Debug Info:\n");
+	drm_printf(p, "  Mapped=%llu KB, Idle=%llu KB, Max=%llu MB\n",
+	           READ_ONCE(cache->mapped_bytes) >> 10,
+	           READ_ONCE(cache->idle_bytes) >> 10, cache->max_bytes >> 20);
+	drm_printf(p, "  Hits=%llu, Misses=%llu, Evictions=%llu, Invalidations=%llu\n",
+	           atomic64_read(&cache->hits), atomic64_read(&cache->misses),
+	           atomic64_read(&cache->evictions),
+	           atomic64_read(&cache->invalidations));
+}
@@ -0,0 +1,291 @@
+/*
+ * PDDGPU 非临时SIMD复制和填充实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/io.h>
+#include <linux/iosys-map.h>
+#include <linux/string.h>
+
+#include <asm/simd.h>
+#ifdef CONFIG_X86
+#include <asm/cpufeature.h>
+#include <asm/fpu/api.h>
+#endif
+#ifdef CONFIG_ARM64
+#include <asm/cpufeature.h>
+#include <asm/neon.h>
+#endif
+
+#include <drm/drm_cache.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_memcpy.h"
+
+/*
+ * 一种SIMD实现。WC内存上的普通读逐次访问总线，普通写会污染缓存并把
+ * 写合并缓冲区拆成小事务；非临时读写按整行成块传输，接近总线带宽。
+ */
+struct pddgpu_simd_ops {
+	void (*copy)(void *dst, const void *src, size_t len);
+	void (*fill)(void *dst, const u8 *pattern, size_t len);
+	size_t align;                   /* 源和目标地址的对齐要求 */
+	size_t block;                   /* 每次迭代处理的字节数 */
+};
+
+static enum pddgpu_memcpy_impl pddgpu_memcpy_impl __read_mostly;
+
+#ifdef CONFIG_X86
+static void pddgpu_memcpy_sse41(void *dst, const void *src, size_t len)
+{
+	for (; len >= 64; len -= 64, src += 64, dst += 64)
+		asm volatile("movntdqa   (%0), %%xmm0\n"
+		             "movntdqa 16(%0), %%xmm1\n"
+		             "movntdqa 32(%0), %%xmm2\n"
+		             "movntdqa 48(%0), %%xmm3\n"
+		             "movntdq %%xmm0,   (%1)\n"
+		             "movntdq %%xmm1, 16(%1)\n"
+		             "movntdq %%xmm2, 32(%1)\n"
+		             "movntdq %%xmm3, 48(%1)\n"
+		             : : "r" (src), "r" (dst) : "memory");
+}
+
+static void pddgpu_memset_sse41(void *dst, const u8 *pattern, size_t len)
+{
+	/* 以内存操作数传入图样，编译器不会把之前填充图样的memset当作死存储 */
+	asm volatile("movdqu %0, %%xmm0\n" : : "m" (*(const u8 (*)[16])pattern));
+
+	for (; len >= 64; len -= 64, dst += 64)
+		asm volatile("movntdq %%xmm0,   (%0)\n"
+		             "movntdq %%xmm0, 16(%0)\n"
+		             "movntdq %%xmm0, 32(%0)\n"
+		             "movntdq %%xmm0, 48(%0)\n"
+		             : : "r" (dst) : "memory");
+}
+
+static void pddgpu_memcpy_avx2(void *dst, const void *src, size_t len)
+{
+	for (; len >= 128; len -= 128, src += 128, dst += 128)
+		asm volatile("vmovntdqa   (%0), %%ymm0\n"
+		             "vmovntdqa 32(%0), %%ymm1\n"
+		             "vmovntdqa 64(%0), %%ymm2\n"
+		             "vmovntdqa 96(%0), %%ymm3\n"
+		             "vmovntdq %%ymm0,   (%1)\n"
+		             "vmovntdq %%ymm1, 32(%1)\n"
+		             "vmovntdq %%ymm2, 64(%1)\n"
+		             "vmovntdq %%ymm3, 96(%1)\n"
+		             : : "r" (src), "r" (dst) : "memory");
+}
+
+static void pddgpu_memset_avx2(void *dst, const u8 *pattern, size_t len)
+{
+	asm volatile("vmovdqu %0, %%ymm0\n" : : "m" (*(const u8 (*)[32])pattern));
+
+	for (; len >= 128; len -= 128, dst += 128)
+		asm volatile("vmovntdq %%ymm0,   (%0)\n"
+		             "vmovntdq %%ymm0, 32(%0)\n"
+		             "vmovntdq %%ymm0, 64(%0)\n"
+		             "vmovntdq %%ymm0, 96(%0)\n"
+		             : : "r" (dst) : "memory");
+}
+#endif
+
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+static void pddgpu_memcpy_neon(void *dst, const void *src, size_t len)
+{
+	for (; len >= 64; len -= 64, src += 64, dst += 64)
+		asm volatile("ldnp q0, q1, [%0]\n"
+		             "ldnp q2, q3, [%0, #32]\n"
+		             "stnp q0, q1, [%1]\n"
+		             "stnp q2, q3, [%1, #32]\n"
+		             : : "r" (src), "r" (dst) : "memory");
+}
+
+static void pddgpu_memset_neon(void *dst, const u8 *pattern, size_t len)
+{
+	asm volatile("ld1 {v0.16b}, [%0]\n"
+	             : : "r" (pattern), "m" (*(const u8 (*)[16])pattern));
+
+	for (; len >= 64; len -= 64, dst += 64)
+		asm volatile("stnp q0, q0, [%0]\n"
+		             "stnp q0, q0, [%0, #32]\n"
+		             : : "r" (dst) : "memory");
+}
+#endif
+
+static const struct pddgpu_simd_ops pddgpu_simd_ops_table[PDDGPU_MEMCPY_COUNT] = {
+#ifdef CONFIG_X86
+	[PDDGPU_MEMCPY_SSE41] = {
+		.copy = pddgpu_memcpy_sse41,
+		.fill = pddgpu_memset_sse41,
+		.align = 16,
+		.block = 64,
+	},
+	[PDDGPU_MEMCPY_AVX2] = {
+		.copy = pddgpu_memcpy_avx2,
+		.fill = pddgpu_memset_avx2,
+		.align = 32,
+		.block = 128,
+	},
+#endif
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+	[PDDGPU_MEMCPY_NEON] = {
+		.copy = pddgpu_memcpy_neon,
+		.fill = pddgpu_memset_neon,
+		.align = 16,
+		.block = 64,
+	},
+#endif
+};
+
+static const char * const pddgpu_memcpy_impl_names[PDDGPU_MEMCPY_COUNT] = {
+	[PDDGPU_MEMCPY_GENERIC] = "generic",
+	[PDDGPU_MEMCPY_SSE41] = "sse4.1",
+	[PDDGPU_MEMCPY_AVX2] = "avx2",
+	[PDDGPU_MEMCPY_NEON] = "neon",
+};
+
+/* 当前使用的SIMD实现，模块参数关闭或CPU不支持时返回NULL */
+static const struct pddgpu_simd_ops *pddgpu_simd_ops_get(void)
+{
+	const struct pddgpu_simd_ops *ops;
+
+	if (!READ_ONCE(pddgpu_simd_copy))
+		return NULL;
+
+	ops = &pddgpu_simd_ops_table[pddgpu_memcpy_impl];
+	return ops->copy ? ops : NULL;
+}
+
+/* 中断上下文等不能使用向量寄存器的场合，以及没有SIMD实现的架构返回false */
+static bool pddgpu_simd_begin(void)
+{
+	if (!may_use_simd())
+		return false;
+
+#if defined(CONFIG_X86)
+	kernel_fpu_begin();
+	return true;
+#elif defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+	kernel_neon_begin();
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void pddgpu_simd_end(void)
+{
+	/* 非临时存储是弱序的，必须在栅栏发出信号前全部可见 */
+	wmb();
+
+#if defined(CONFIG_X86)
+	kernel_fpu_end();
+#elif defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+	kernel_neon_end();
+#endif
+}
+
+/* 按CPU特性选择实现 */
+void pddgpu_memcpy_init(void)
+{
+	pddgpu_memcpy_impl = PDDGPU_MEMCPY_GENERIC;
+
+#ifdef CONFIG_X86
+	if (boot_cpu_has(X86_FEATURE_AVX2) && boot_cpu_has(X86_FEATURE_AVX) &&
+	    cpu_has_xfeatures(XFEATURE_MASK_SSE | XFEATURE_MASK_YMM, NULL))
+		pddgpu_memcpy_impl = PDDGPU_MEMCPY_AVX2;
+	else if (boot_cpu_has(X86_FEATURE_XMM4_1))
+		pddgpu_memcpy_impl = PDDGPU_MEMCPY_SSE41;
+#endif
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+	if (cpu_have_named_feature(ASIMD))
+		pddgpu_memcpy_impl = PDDGPU_MEMCPY_NEON;
+#endif
+
+	PDDGPU_INFO("BO copy and fill using %s\n",
+	            pddgpu_memcpy_impl_name(pddgpu_memcpy_impl));
+}
+
+enum pddgpu_memcpy_impl pddgpu_memcpy_get_impl(void)
+{
+	return pddgpu_simd_ops_get() ? pddgpu_memcpy_impl : PDDGPU_MEMCPY_GENERIC;
+}
+
+const char *pddgpu_memcpy_impl_name(enum pddgpu_memcpy_impl impl)
+{
+	if (impl >= ARRAY_SIZE(pddgpu_memcpy_impl_names))
+		return "unknown";
+
+	return pddgpu_memcpy_impl_names[impl];
+}
+
+static void *pddgpu_map_vaddr(const struct iosys_map *map)
+{
+	return map->is_iomem ? (void __force *)map->vaddr_iomem : map->vaddr;
+}
+
+/*
+ * 复制len字节。对齐的部分按段关抢占做SIMD复制，每段不超过
+ * PDDGPU_SIMD_MAX_BYTES；剩余部分交给drm_memcpy_from_wc()。
+ */
+void pddgpu_memcpy(struct iosys_map *dst, const struct iosys_map *src, size_t len)
+{
+	const struct pddgpu_simd_ops *ops = pddgpu_simd_ops_get();
+	void *d = pddgpu_map_vaddr(dst);
+	const void *s = pddgpu_map_vaddr(src);
+	struct iosys_map dst_tail, src_tail;
+	size_t done = 0, n;
+
+	if (ops && IS_ALIGNED((unsigned long)d | (unsigned long)s, ops->align)) {
+		while (len - done >= ops->block) {
+			n = round_down(min_t(size_t, len - done, PDDGPU_SIMD_MAX_BYTES),
+			               ops->block);
+			if (!pddgpu_simd_begin())
+				break;
+			ops->copy(d + done, s + done, n);
+			pddgpu_simd_end();
+			done += n;
+		}
+	}
+
+	if (done == len)
+		return;
+
+	dst_tail = *dst;
+	src_tail = *src;
+	iosys_map_incr(&dst_tail, done);
+	iosys_map_incr(&src_tail, done);
+	drm_memcpy_from_wc(&dst_tail, &src_tail, len - done);
+}
+
+/* 填充len字节，WC/IO内存的剩余部分使用memset_io */
+void pddgpu_memset(void *ptr, bool is_iomem, u8 value, size_t len)
+{
+	const struct pddgpu_simd_ops *ops = pddgpu_simd_ops_get();
+	u8 pattern[32] __aligned(32);
+	size_t done = 0, n;
+
+	if (ops && IS_ALIGNED((unsigned long)ptr, ops->align)) {
+		memset(pattern, value, sizeof(pattern));
+		while (len - done >= ops->block) {
+			n = round_down(min_t(size_t, len - done, PDDGPU_SIMD_MAX_BYTES),
+			               ops->block);
+			if (!pddgpu_simd_begin())
+				break;
+			ops->fill(ptr + done, pattern, n);
+			pddgpu_simd_end();
+			done += n;
+		}
+	}
+
+	if (done == len)
+		return;
+
+	if (is_iomem)
+		memset_io((void __iomem *)ptr + done, value, len - done);
+	else
+		memset(ptr + done, value, len - done);
+}
@@ -97,6 +97,34 @@ int pddgpu_memory_stats_init(struct pddgpu_device *pdev)
 	atomic64_set(&pdev->memory_stats.debug.debug_moves, 0);
 	atomic64_set(&pdev->memory_stats.debug.debug_evictions, 0);
 	
+	/* 初始化缺页统计 */
+	atomic64_set(&pdev->memory_stats.fault.faults, 0);
+	atomic64_set(&pdev->memory_stats.fault.pmd_faults, 0);
+	atomic64_set(&pdev->memory_stats.fault.pud_faults, 0);
+	atomic64_set(&pdev->memory_stats.fault.bytes_mapped, 0);
+	
+	/* 初始化抖动统计 */
+	atomic64_set(&pdev->memory_stats.thrash.moves, 0);
+	atomic64_set(&pdev->memory_stats.thrash.bytes, 0);
+	atomic64_set(&pdev->memory_stats.thrash.holds, 0);
+	atomic64_set(&pdev->memory_stats.thrash.demotions, 0);
+	
+	/* 初始化移动路径统计 */
+	atomic64_set(&pdev->memory_stats.move.copies, 0);
+	atomic64_set(&pdev->memory_stats.move.copy_bytes, 0);
+	atomic64_set(&pdev->memory_stats.move.zero_copy, 0);
+	atomic64_set(&pdev->memory_stats.move.zero_copy_bytes, 0);
+	atomic64_set(&pdev->memory_stats.gart.binds, 0);
+	atomic64_set(&pdev->memory_stats.gart.frags, 0);
+	atomic64_set(&pdev->memory_stats.gart.huge_frags, 0);
+	atomic64_set(&pdev->memory_stats.gart.dma_maps, 0);
+	atomic64_set(&pdev->memory_stats.gart.dma_segments, 0);
+	atomic64_set(&pdev->memory_stats.sparse.size, 0);
+	atomic64_set(&pdev->memory_stats.sparse.populated, 0);
+	atomic64_set(&pdev->memory_stats.sparse.zero_maps, 0);
+	atomic64_set(&pdev->memory_stats.purge.purges, 0);
+	atomic64_set(&pdev->memory_stats.purge.bytes, 0);
+	
 #if PDDGPU_MEMORY_LEAK_MONITOR_ENABLED
 	/* 初始化内存泄漏监控 */
 	INIT_DELAYED_WORK(&pdev->memory_stats.leak_monitor.leak_monitor_work,
@@ -333,6 +361,25 @@ void pddgpu_memory_stats_move_end(struct pddgpu_device *pdev,
 	PDDGPU_DEBUG("Memory move ended\n");
 }
 
+/* CPU缺页统计 */
+void pddgpu_memory_stats_fault(struct pddgpu_device *pdev, u64 bytes,
+                               unsigned int order)
+{
+	if (!pdev || (atomic_read(&pdev->device_state) & PDDGPU_DEVICE_STATE_SHUTDOWN)) {
+		return;
+	}
+	
+	atomic64_inc(&pdev->memory_stats.fault.faults);
+	atomic64_add(bytes, &pdev->memory_stats.fault.bytes_mapped);
+	
+	if (order == PMD_ORDER)
+		atomic64_inc(&pdev->memory_stats.fault.pmd_faults);
+#ifdef PUD_ORDER
+	else if (order == PUD_ORDER)
+		atomic64_inc(&pdev->memory_stats.fault.pud_faults);
+#endif
+}
+
 /* 内存泄漏检测 */
 void pddgpu_memory_stats_leak_check(struct pddgpu_device *pdev)
 {
@@ -554,10 +601,41 @@ void pddgpu_memory_stats_get_info(struct pddgpu_device *pdev,
 	info->avg_allocation_time = allocation_count > 0 ? allocation_time_total / allocation_count : 0;
 	info->avg_deallocation_time = deallocation_count > 0 ? deallocation_time_total / deallocation_count : 0;
 	info->avg_move_time = move_operations > 0 ? move_time_total / move_operations : 0;
+	
+	/* 缺页统计 */
+	info->mmap_faults = atomic64_read(&pdev->memory_stats.fault.faults);
+	info->mmap_huge_faults = atomic64_read(&pdev->memory_stats.fault.pmd_faults) +
+	                         atomic64_read(&pdev->memory_stats.fault.pud_faults);
+	info->mmap_bytes_mapped = atomic64_read(&pdev->memory_stats.fault.bytes_mapped);
+	info->mmap_faults_per_mb = info->mmap_bytes_mapped >> 20 ?
+		div64_u64(info->mmap_faults * 1000, info->mmap_bytes_mapped >> 20) : 0;
+	
+	info->thrash_moves = atomic64_read(&pdev->memory_stats.thrash.moves);
+	info->thrash_bytes = atomic64_read(&pdev->memory_stats.thrash.bytes);
+	info->thrash_holds = atomic64_read(&pdev->memory_stats.thrash.holds);
+	info->thrash_demotions = atomic64_read(&pdev->memory_stats.thrash.demotions);
+	
+	info->move_copies = atomic64_read(&pdev->memory_stats.move.copies);
+	info->move_copy_bytes = atomic64_read(&pdev->memory_stats.move.copy_bytes);
+	info->move_zero_copy = atomic64_read(&pdev->memory_stats.move.zero_copy);
+	info->move_zero_copy_bytes = atomic64_read(&pdev->memory_stats.move.zero_copy_bytes);
+	
+	info->gart_binds = atomic64_read(&pdev->memory_stats.gart.binds);
+	info->gart_frags = atomic64_read(&pdev->memory_stats.gart.frags);
+	info->gart_huge_frags = atomic64_read(&pdev->memory_stats.gart.huge_frags);
+	info->gart_dma_maps = atomic64_read(&pdev->memory_stats.gart.dma_maps);
+	info->gart_dma_segments = atomic64_read(&pdev->memory_stats.gart.dma_segments);
+	
+	info->sparse_size = atomic64_read(&pdev->memory_stats.sparse.size);
+	info->sparse_populated = atomic64_read(&pdev->memory_stats.sparse.populated);
+	info->sparse_zero_maps = atomic64_read(&pdev->memory_stats.sparse.zero_maps);
+	info->purges = atomic64_read(&pdev->memory_stats.purge.purges);
+	info->purged_bytes = atomic64_read(&pdev->memory_stats.purge.bytes);
 }
 
 /* 调试打印 */
-void pddgpu_memory_stats_debug_print(struct pddgpu_device *pdev)
+void pddgpu_memory_stats_debug_print(struct pddgpu_device *pdev,
+                                     struct drm_printer *p)
 {
 	struct pddgpu_memory_stats_info info;
 	
@@ -567,17 +645,36 @@ void pddgpu_memory_stats_debug_print(struct pddgpu_device *pdev)
 	
 	pddgpu_memory_stats_get_info(pdev, &info);
 	
-	PDDGPU_INFO("Memory Statistics Debug Info:\n");
-	PDDGPU_INFO("  VRAM: Total=%llu MB, Used=%llu MB, Free=%llu MB\n",
-	            info.vram_total >> 20, info.vram_used >> 20, info.vram_free >> 20);
-	PDDGPU_INFO("  GTT:  Total=%llu MB, Used=%llu MB, Free=%llu MB\n",
-	            info.gtt_total >> 20, info.gtt_used >> 20, info.gtt_free >> 20);
-	PDDGPU_INFO("  Operations: Alloc=%llu, Dealloc=%llu\n",
-	            info.total_allocations, info.total_deallocations);
-	PDDGPU_INFO("  Performance: Avg_Alloc=%llu ns, Avg_Dealloc=%llu ns, Avg_Move=%llu ns\n",
-	            info.avg_allocation_time, info.avg_deallocation_time, info.avg_move_time);
-	PDDGPU_INFO("  Leaks: Suspicious=%llu, Confirmed=%llu\n",
-	            info.leak_suspicious, info.leak_confirmed);
+	drm_printf(p, "Memory Statistics Debug Info:\n");
+	drm_printf(p, "  VRAM: Total=%llu MB, Used=%llu MB, Free=%llu MB\n",
+	           info.vram_total >> 20, info.vram_used >> 20, info.vram_free >> 20);
+	drm_printf(p, "  GTT:  Total=%llu MB, Used=%llu MB, Free=%llu MB\n",
+	           info.gtt_total >> 20, info.gtt_used >> 20, info.gtt_free >> 20);
+	drm_printf(p, "  Operations: Alloc=%llu, Dealloc=%llu\n",
+	           info.total_allocations, info.total_deallocations);
+	drm_printf(p, "  Performance: Avg_Alloc=%llu ns, Avg_Dealloc=%llu ns, Avg_Move=%llu ns\n",
+	           info.avg_allocation_time, info.avg_deallocation_time, info.avg_move_time);
+	drm_printf(p, "  Leaks: Suspicious=%llu, Confirmed=%llu\n",
+	           info.leak_suspicious, info.leak_confirmed);
+	drm_printf(p, "  Faults: Total=%llu, Huge=%llu, Mapped=%llu MB, Per_MB=%llu.%03llu\n",
+	           info.mmap_faults, info.mmap_huge_faults, info.mmap_bytes_mapped >> 20,
+	           info.mmap_faults_per_mb / 1000, info.mmap_faults_per_mb % 1000);
+	drm_printf(p, "  Thrash: Moves=%llu, Moved=%llu MB, Holds=%llu, Demotions=%llu\n",
+	           info.thrash_moves, info.thrash_bytes >> 20,
+	           info.thrash_holds, info.thrash_demotions);
+	drm_printf(p, "  Moves: Copies=%llu (%llu MB), Zero_Copy=%llu (%llu MB)\n",
+	           info.move_copies, info.move_copy_bytes >> 20,
+	           info.move_zero_copy, info.move_zero_copy_bytes >> 20);
+	drm_printf(p, "  GART: Binds=%llu, Fragments=%llu, Huge_Fragments=%llu\n",
+	           info.gart_binds, info.gart_frags, info.gart_huge_frags);
+	drm_printf(p, "  DMA: Maps=%llu, Segments=%llu\n",
+	           info.gart_dma_maps, info.gart_dma_segments);
+	drm_printf(p, "  Sparse: Size=%llu MB, Populated=%llu MB (%llu%%), Zero_Maps=%llu\n",
+	           info.sparse_size >> 20, info.sparse_populated >> 20,
+	           info.sparse_size ? div64_u64(info.sparse_populated * 100, info.sparse_size) : 0,
+	           info.sparse_zero_maps);
+	drm_printf(p, "  Purge: Count=%llu, Bytes=%llu MB\n",
+	           info.purges, info.purged_bytes >> 20);
 }
 
 /* 重置统计 */
@@ -609,6 +706,34 @@ void pddgpu_memory_stats_reset(struct pddgpu_device *pdev)
 	atomic64_set(&pdev->memory_stats.debug.debug_moves, 0);
 	atomic64_set(&pdev->memory_stats.debug.debug_evictions, 0);
 	
+	/* 重置缺页统计 */
+	atomic64_set(&pdev->memory_stats.fault.faults, 0);
+	atomic64_set(&pdev->memory_stats.fault.pmd_faults, 0);
+	atomic64_set(&pdev->memory_stats.fault.pud_faults, 0);
+	atomic64_set(&pdev->memory_stats.fault.bytes_mapped, 0);
+	
+	/* 重置抖动统计 */
+	atomic64_set(&pdev->memory_stats.thrash.moves, 0);
+	atomic64_set(&pdev->memory_stats.thrash.bytes, 0);
+	atomic64_set(&pdev->memory_stats.thrash.holds, 0);
+	atomic64_set(&pdev->memory_stats.thrash.demotions, 0);
+	
+	/* 重置移动路径统计 */
+	atomic64_set(&pdev->memory_stats.move.copies, 0);
+	atomic64_set(&pdev->memory_stats.move.copy_bytes, 0);
+	atomic64_set(&pdev->memory_stats.move.zero_copy, 0);
+	atomic64_set(&pdev->memory_stats.move.zero_copy_bytes, 0);
+	atomic64_set(&pdev->memory_stats.gart.binds, 0);
+	atomic64_set(&pdev->memory_stats.gart.frags, 0);
+	atomic64_set(&pdev->memory_stats.gart.huge_frags, 0);
+	atomic64_set(&pdev->memory_stats.gart.dma_maps, 0);
+	atomic64_set(&pdev->memory_stats.gart.dma_segments, 0);
+	atomic64_set(&pdev->memory_stats.sparse.size, 0);
+	atomic64_set(&pdev->memory_stats.sparse.populated, 0);
+	atomic64_set(&pdev->memory_stats.sparse.zero_maps, 0);
+	atomic64_set(&pdev->memory_stats.purge.purges, 0);
+	atomic64_set(&pdev->memory_stats.purge.bytes, 0);
+	
 	/* 重置泄漏检测统计 */
 	atomic64_set(&pdev->memory_stats.leak_detector.leak_suspicious_count, 0);
 	atomic64_set(&pdev->memory_stats.leak_detector.leak_confirmed_count, 0);
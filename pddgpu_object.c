@@ -9,6 +9,8 @@
 #include <linux/slab.h>
 #include <linux/mm.h>
 #include <linux/io.h>
+#include <linux/workqueue.h>
+#include <linux/dma-fence.h>
 
 #include <drm/drm_gem.h>
 #include <drm/ttm/ttm_bo.h>
@@ -16,6 +18,7 @@
 #include <drm/ttm/ttm_resource.h>
 #include <drm/ttm/ttm_tt.h>
 
+#include "include/pddgpu_kmap_cache.h"
 #include "pddgpu_object.h"
 
 /* TTM BO函数 */
@@ -86,6 +89,50 @@ static const struct ttm_buffer_object_funcs pddgpu_bo_funcs = {
 	.release_notify = NULL,
 };
 
+/* 按创建标志清理新分配的VRAM */
+static int pddgpu_bo_clear_vram(struct pddgpu_bo *bo)
+{
+	struct dma_fence *fence;
+	int r;
+
+	if (!(bo->flags & PDDGPU_GEM_CREATE_VRAM_CLEARED) ||
+	    !bo->tbo.resource || bo->tbo.resource->mem_type != TTM_PL_VRAM)
+		return 0;
+
+	r = dma_resv_reserve_fences(bo->tbo.base.resv, 1);
+	if (unlikely(r))
+		return r;
+
+	r = pddgpu_ttm_clear_buffer(bo, bo->tbo.base.resv, &fence);
+	if (unlikely(r))
+		return r;
+
+	dma_resv_add_fence(bo->tbo.base.resv, fence, DMA_RESV_USAGE_KERNEL);
+	dma_fence_put(fence);
+
+	return 0;
+}
+
+/*
+ * 清理失败时丢弃BO的后备存储，调用者需持有BO预留锁。BO回到未放置状态，
+ * 下次使用时重新放置并清理，不会把上一个使用者的VRAM内容交出去。
+ */
+static void pddgpu_bo_discard(struct pddgpu_bo *bo)
+{
+	struct ttm_operation_ctx ctx = { .interruptible = false };
+	struct ttm_placement placement = {};
+	int r;
+
+	dma_resv_assert_held(bo->tbo.base.resv);
+
+	r = ttm_bo_validate(&bo->tbo, &placement, &ctx);
+	if (unlikely(r)) {
+		/* 无法释放时禁止CPU访问，直到用户重新WILLNEED */
+		PDDGPU_ERROR("Failed to discard uncleared BO %p: %d\n", bo, r);
+		bo->purged = true;
+	}
+}
+
 /* 创建BO */
 int pddgpu_bo_create(struct pddgpu_device *pdev, struct pddgpu_bo_param *bp, struct pddgpu_bo **bo_ptr)
 {
@@ -94,6 +141,8 @@ int pddgpu_bo_create(struct pddgpu_device *pdev, struct pddgpu_bo_param *bp, str
 		.interruptible = true,
 		.no_wait_gpu = bp->no_wait_gpu,
 	};
+	struct ttm_placement lazy_placement = {};
+	struct ttm_placement *init_placement;
 	unsigned long page_align = 0;
 	int r;
 	
@@ -127,23 +176,49 @@ int pddgpu_bo_create(struct pddgpu_device *pdev, struct pddgpu_bo_param *bp, str
 	
 	/* 设置BO属性 */
 	bo->preferred_domains = bp->preferred_domain;
-	bo->allowed_domains = bp->allowed_domain;
+	bo->allowed_domains = bp->allowed_domain ?: bo->preferred_domains;
+	/* 移动配额耗尽时用户BO可以留在GTT */
+	if (bp->type != ttm_bo_type_kernel &&
+	    bo->allowed_domains == PDDGPU_GEM_DOMAIN_VRAM)
+		bo->allowed_domains |= PDDGPU_GEM_DOMAIN_GTT;
 	bo->flags = bp->flags;
+	/* 不支持写合并时退回可缓存的GTT页面 */
+	if (!pddgpu_bo_support_uswc(bo->flags))
+		bo->flags &= ~PDDGPU_GEM_CREATE_CPU_GTT_USWC;
 	bo->tbo.bdev = &pdev->mman.bdev;
 	bo->tbo.type = bp->type;
 	bo->tbo.page_alignment = bp->byte_align >> PAGE_SHIFT;
 	bo->tbo.bo_ptr_size = bp->bo_ptr_size;
+	INIT_LIST_HEAD(&bo->kmap_entries);
+	bo->owner = pddgpu_fpriv_get(bp->owner);
+	bo->client_mem_type = -1;
+	pddgpu_bo_touch(bo);
+	pddgpu_thrash_bo_init(bo);
 	
 	/* 设置放置策略 */
 	pddgpu_bo_placement_from_domain(bo, bp->domain);
 	
-	/* 设置优先级 */
-	bo->tbo.priority = 0;
+	/* 设置优先级：内核BO常驻，用户BO可通过PDDGPU_GEM_PRIORITY调整 */
+	BUILD_BUG_ON(PDDGPU_BO_PRIORITY_CRITICAL >= TTM_MAX_BO_PRIORITY);
+	if (bp->type == ttm_bo_type_kernel)
+		bo->tbo.priority = PDDGPU_BO_PRIORITY_CRITICAL;
+	else
+		bo->tbo.priority = PDDGPU_BO_PRIORITY_NORMAL;
+	
+	/*
+	 * 延迟放置：以空放置列表初始化，BO没有资源，不占用任何内存。
+	 * 首次kmap、mmap缺页或pin时由pddgpu_bo_lazy_place()按bo->placement放置。
+	 */
+	if (bp->flags & PDDGPU_GEM_CREATE_LAZY_PLACEMENT &&
+	    bp->type == ttm_bo_type_device)
+		init_placement = &lazy_placement;
+	else
+		init_placement = &bo->placement;
 	
 	/* 初始化TTM BO */
 	r = ttm_bo_init_reserved(&pdev->mman.bdev, &bo->tbo, bp->type,
-				 &bo->placement, page_align, &ctx, NULL,
-				 bp->resv, bp->destroy);
+				 init_placement, page_align, &ctx, NULL,
+				 bp->resv, bp->destroy ? bp->destroy : pddgpu_bo_destroy);
 
 	if (unlikely(r != 0)) {
 		pddgpu_memory_stats_alloc_end(pdev, bo, r);
@@ -160,26 +235,20 @@ int pddgpu_bo_create(struct pddgpu_device *pdev, struct pddgpu_bo_param *bp, str
 		 * 某些情况下（如BO首次分配或内存回收时），TTM可能会将BO从一个内存区域迁移到另一个区域（如从GTT到VRAM），
 		 * 这时需要统计迁移的字节数以便驱动层进行性能分析或调度优化。
 		 */
-		pddgpu_cs_report_moved_bytes(pdev, ctx.bytes_moved,
+		pddgpu_cs_report_moved_bytes(pdev, bo->owner, ctx.bytes_moved,
 
 					     ctx.bytes_moved);
 	else
-		pddgpu_cs_report_moved_bytes(pdev, ctx.bytes_moved, 0);
-
-	/* VRAM清理（如果需要） */
-	if (bp->flags & PDDGPU_GEM_CREATE_VRAM_CLEARED &&
-	    bo->tbo.resource->mem_type == TTM_PL_VRAM) {
-		struct dma_fence *fence;
-
-		r = pddgpu_ttm_clear_buffer(bo, bo->tbo.base.resv, &fence);
-		if (unlikely(r))
-			goto fail_unreserve;
-
-		dma_resv_add_fence(bo->tbo.base.resv, fence,
-				   DMA_RESV_USAGE_KERNEL);
-		dma_fence_put(fence);
+		pddgpu_cs_report_moved_bytes(pdev, bo->owner, ctx.bytes_moved, 0);
 
-	}
+	/* VRAM清理（如果需要），延迟放置的BO在首次放置时清理 */
+	r = pddgpu_bo_clear_vram(bo);
+	if (unlikely(r))
+		goto fail_unreserve;
+	
+	/* 创建者未提供预留对象时，释放ttm_bo_init_reserved()持有的锁 */
+	if (!bp->resv)
+		dma_resv_unlock(bo->tbo.base.resv);
 	
 	*bo_ptr = bo;
 	
@@ -191,6 +260,386 @@ int pddgpu_bo_create(struct pddgpu_device *pdev, struct pddgpu_bo_param *bp, str
 	
 
 	return 0;
+
+fail_unreserve:
+	if (!bp->resv)
+		dma_resv_unlock(bo->tbo.base.resv);
+	pddgpu_memory_stats_alloc_end(pdev, bo, r);
+	pddgpu_bo_unref(&bo);
+	return r;
+}
+
+/*
+ * 延迟放置的BO首次使用时分配后备存储，调用者需持有BO预留锁。
+ * prio是为腾出空间而驱逐其他BO时的移动优先级。
+ */
+int pddgpu_bo_lazy_place(struct pddgpu_bo *bo, enum pddgpu_move_prio prio)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_move_ctx mctx = { .base = { .interruptible = true } };
+	int r;
+
+	dma_resv_assert_held(bo->tbo.base.resv);
+
+	if (bo->tbo.resource)
+		return 0;
+
+	pddgpu_move_ctx_begin(pdev, &mctx, prio);
+	r = pddgpu_bo_validate(bo, &mctx.base);
+	pddgpu_move_ctx_end(pdev, &mctx);
+	if (unlikely(r)) {
+		PDDGPU_DEBUG("Lazy placement failed: %d\n", r);
+		return r;
+	}
+
+	PDDGPU_DEBUG("Lazy placed BO %p in mem_type %u\n",
+	             bo, bo->tbo.resource->mem_type);
+
+	r = pddgpu_bo_clear_vram(bo);
+	if (unlikely(r))
+		pddgpu_bo_discard(bo);
+
+	return r;
+}
+
+static u32 pddgpu_bo_mem_type_to_domain(u32 mem_type)
+{
+	switch (mem_type) {
+	case TTM_PL_VRAM:
+		return PDDGPU_GEM_DOMAIN_VRAM;
+	case TTM_PL_TT:
+		return PDDGPU_GEM_DOMAIN_GTT;
+	case TTM_PL_SYSTEM:
+		return PDDGPU_GEM_DOMAIN_CPU;
+	default:
+		return 0;
+	}
+}
+
+/* VRAM空闲空间能否直接放下BO，不需要驱逐 */
+static bool pddgpu_bo_vram_fits(struct pddgpu_device *pdev, u64 size)
+{
+	struct ttm_resource_manager *man = ttm_manager_type(&pdev->mman.bdev, TTM_PL_VRAM);
+	u64 used = ttm_resource_manager_usage(man);
+
+	return man->size > used && man->size - used >= size;
+}
+
+/*
+ * 按移动配额验证BO放置，调用者需持有BO预留锁。
+ * 设备或创建者的配额不足以移动该BO时改用允许的域：已在其中的BO保持不动，
+ * 新放置的BO在VRAM放不下时直接放到其他域，不为腾出VRAM而驱逐其他BO。
+ */
+int pddgpu_bo_validate(struct pddgpu_bo *bo, struct ttm_operation_ctx *ctx)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct ttm_resource *res = bo->tbo.resource;
+	u32 domain = bo->preferred_domains;
+	u64 size = bo->tbo.base.size;
+	u64 bytes_moved = ctx->bytes_moved;
+	u64 max_bytes, max_vis_bytes, moved, vis;
+	int r;
+
+	dma_resv_assert_held(bo->tbo.base.resv);
+
+	pddgpu_cs_get_threshold_for_moves(pdev, bo->owner, &max_bytes, &max_vis_bytes);
+	if (max_bytes < size ||
+	    (bo->flags & PDDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED && max_vis_bytes < size)) {
+		domain = bo->allowed_domains;
+
+		if (res && pddgpu_bo_mem_type_to_domain(res->mem_type) & domain) {
+			if (!(pddgpu_bo_mem_type_to_domain(res->mem_type) & bo->preferred_domains))
+				pddgpu_cs_note_throttled(pdev, bo->owner);
+			return 0;
+		}
+
+		if (domain & ~PDDGPU_GEM_DOMAIN_VRAM && !pddgpu_bo_vram_fits(pdev, size))
+			domain &= ~PDDGPU_GEM_DOMAIN_VRAM;
+		if (domain != bo->preferred_domains)
+			pddgpu_cs_note_throttled(pdev, bo->owner);
+	}
+
+	pddgpu_bo_placement_from_domain(bo, domain);
+	r = ttm_bo_validate(&bo->tbo, &bo->placement, ctx);
+	if (domain != bo->preferred_domains)
+		pddgpu_bo_placement_from_domain(bo, bo->preferred_domains);
+
+	/* 限制在CPU可见范围内的VRAM放置同时计入可见配额 */
+	moved = ctx->bytes_moved - bytes_moved;
+	vis = bo->flags & PDDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED &&
+	      bo->tbo.resource && bo->tbo.resource->mem_type == TTM_PL_VRAM ? moved : 0;
+	pddgpu_cs_report_moved_bytes(pdev, bo->owner, moved, vis);
+
+	return r;
+}
+
+/* 设置BO驱逐优先级，并将其资源移到对应优先级的LRU上 */
+int pddgpu_bo_set_priority(struct pddgpu_bo *bo, unsigned int priority)
+{
+	struct ttm_device *bdev = bo->tbo.bdev;
+	int r;
+
+	if (priority >= TTM_MAX_BO_PRIORITY)
+		return -EINVAL;
+
+	r = dma_resv_lock_interruptible(bo->tbo.base.resv, NULL);
+	if (r)
+		return r;
+
+	spin_lock(&bdev->lru_lock);
+	bo->tbo.priority = priority;
+	if (bo->tbo.resource)
+		ttm_bo_move_to_lru_tail(&bo->tbo);
+	spin_unlock(&bdev->lru_lock);
+
+	dma_resv_unlock(bo->tbo.base.resv);
+
+	PDDGPU_DEBUG("BO %p priority set to %u\n", bo, priority);
+
+	return 0;
+}
+
+/*
+ * 设置BO的madvise状态，返回此前后备存储是否保留。已丢弃的BO在WILLNEED
+ * 后重新变为普通BO，下次使用时分配清零的后备存储。
+ */
+int pddgpu_bo_madvise(struct pddgpu_bo *bo, u32 madv, bool *retained)
+{
+	int r;
+
+	if (madv != PDDGPU_MADV_WILLNEED && madv != PDDGPU_MADV_DONTNEED)
+		return -EINVAL;
+
+	r = dma_resv_lock_interruptible(bo->tbo.base.resv, NULL);
+	if (r)
+		return r;
+
+	/* 固定的BO和与其他设备共享的BO不能丢弃 */
+	if (madv == PDDGPU_MADV_DONTNEED &&
+	    (bo->tbo.pin_count || bo->tbo.type != ttm_bo_type_device ||
+	     bo->tbo.base.import_attach || bo->tbo.base.dma_buf)) {
+		r = -EINVAL;
+		goto out_unlock;
+	}
+
+	*retained = !bo->purged;
+	if (madv == PDDGPU_MADV_WILLNEED)
+		bo->purged = false;
+	bo->madv = madv;
+	pddgpu_client_bo_update(bo, bo->tbo.resource);
+
+	PDDGPU_DEBUG("BO %p madvise %u, retained %d\n", bo, madv, *retained);
+
+out_unlock:
+	dma_resv_unlock(bo->tbo.base.resv);
+
+	return r;
+}
+
+/* 异步BO创建任务 */
+struct pddgpu_bo_async_work {
+	struct work_struct work;
+	struct pddgpu_bo *bo;
+};
+
+static const char *pddgpu_bo_create_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "pddgpu";
+}
+
+static const char *pddgpu_bo_create_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "bo-create";
+}
+
+static const struct dma_fence_ops pddgpu_bo_create_fence_ops = {
+	.get_driver_name = pddgpu_bo_create_fence_get_driver_name,
+	.get_timeline_name = pddgpu_bo_create_fence_get_timeline_name,
+};
+
+/* 异步清理的一段物理连续VRAM */
+struct pddgpu_bo_clear_seg {
+	void __iomem *vaddr;
+	u64 size;
+};
+
+static void pddgpu_bo_clear_unmap(struct pddgpu_bo_clear_seg *segs, int num_segs)
+{
+	while (num_segs--)
+		iounmap(segs[num_segs].vaddr);
+	kfree(segs);
+}
+
+/*
+ * 按物理连续的buddy块分段IO映射资源，返回段数或负错误码。
+ * 私有映射不依赖预留锁，可以在锁外清理。
+ */
+static int pddgpu_bo_clear_map(struct pddgpu_device *pdev,
+                               struct ttm_resource *res,
+                               struct pddgpu_bo_clear_seg **segs_ptr)
+{
+	struct pddgpu_bo_clear_seg *segs;
+	u64 offset, addr, contig;
+	int i, num_segs = 0;
+
+	if (pddgpu_vram_mgr_res_visible_size(pdev, res) < res->size)
+		return -EINVAL;
+
+	for (offset = 0; offset < res->size; offset += contig) {
+		pddgpu_vram_mgr_res_addr(res, offset, &contig);
+		num_segs++;
+	}
+
+	segs = kcalloc(num_segs, sizeof(*segs), GFP_KERNEL);
+	if (!segs)
+		return -ENOMEM;
+
+	for (i = 0, offset = 0; i < num_segs; i++, offset += contig) {
+		addr = pddgpu_vram_mgr_res_addr(res, offset, &contig);
+		contig = min(contig, res->size - offset);
+
+		segs[i].size = contig;
+		segs[i].vaddr = ioremap_wc(pdev->gmc.fb_start + addr, contig);
+		if (!segs[i].vaddr) {
+			pddgpu_bo_clear_unmap(segs, i);
+			return -ENOMEM;
+		}
+	}
+
+	*segs_ptr = segs;
+	return num_segs;
+}
+
+/* 异步BO创建工作函数：放置、填充并清理BO */
+static void pddgpu_bo_async_setup_work(struct work_struct *work)
+{
+	struct pddgpu_bo_async_work *async =
+		container_of(work, struct pddgpu_bo_async_work, work);
+	struct pddgpu_bo *bo = async->bo;
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct ttm_operation_ctx ctx = { .interruptible = false };
+	struct pddgpu_bo_clear_seg *segs = NULL;
+	struct dma_fence *fence = NULL;
+	int i, num_segs = 0;
+	int r;
+
+	dma_resv_lock(bo->tbo.base.resv, NULL);
+
+	/* 用户已先行访问并同步完成了放置 */
+	if (bo->tbo.resource) {
+		dma_resv_unlock(bo->tbo.base.resv);
+		goto out;
+	}
+
+	/* 放置BO，GTT/系统内存域的ttm_tt在此填充 */
+	r = pddgpu_bo_validate(bo, &ctx);
+	if (unlikely(r)) {
+		dma_resv_unlock(bo->tbo.base.resv);
+		PDDGPU_ERROR("Async BO placement failed: %d\n", r);
+		goto out;
+	}
+
+	/*
+	 * 需要清理时，先把栅栏加入预留对象再释放锁，清理在锁外进行。
+	 * 之后的映射、缺页和移动都会等待该栅栏，期间BO不会被移动，
+	 * 工作函数也不会在持有预留锁时等待其他使用者，避免死锁。
+	 * 清理使用按buddy块分段的私有映射而不是映射缓存：缓存中的映射只在持有
+	 * 预留锁时有效，锁外仍被引用会在BO移动时失效。所有可能失败的步骤都在
+	 * 发布栅栏之前完成，失败时退回同步清理，仍失败就丢弃后备存储。
+	 */
+	if (bo->flags & PDDGPU_GEM_CREATE_VRAM_CLEARED &&
+	    bo->tbo.resource->mem_type == TTM_PL_VRAM) {
+		r = dma_resv_reserve_fences(bo->tbo.base.resv, 1);
+		if (!r) {
+			r = pddgpu_bo_clear_map(pdev, bo->tbo.resource, &segs);
+			if (r > 0) {
+				num_segs = r;
+				r = 0;
+			}
+		}
+		if (!r) {
+			fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+			if (!fence) {
+				pddgpu_bo_clear_unmap(segs, num_segs);
+				r = -ENOMEM;
+			}
+		}
+		if (unlikely(r)) {
+			/* 无法异步清理时退回同步清理 */
+			r = pddgpu_bo_clear_vram(bo);
+			if (unlikely(r)) {
+				PDDGPU_ERROR("Async BO clear failed: %d\n", r);
+				pddgpu_bo_discard(bo);
+			}
+			dma_resv_unlock(bo->tbo.base.resv);
+			goto out;
+		}
+
+		/* 工作项在无序队列上并发完成，每个栅栏使用独立的上下文 */
+		dma_fence_init(fence, &pddgpu_bo_create_fence_ops,
+		               &pdev->mman.bo_create_fence_lock,
+		               dma_fence_context_alloc(1), 1);
+		dma_resv_add_fence(bo->tbo.base.resv, fence, DMA_RESV_USAGE_KERNEL);
+	}
+
+	dma_resv_unlock(bo->tbo.base.resv);
+
+	if (fence) {
+		for (i = 0; i < num_segs; i++)
+			pddgpu_ttm_fill((void __force *)segs[i].vaddr, true, 0,
+			                segs[i].size);
+		pddgpu_bo_clear_unmap(segs, num_segs);
+		dma_fence_signal(fence);
+		dma_fence_put(fence);
+	}
+
+	PDDGPU_DEBUG("Async BO setup done: %p\n", bo);
+
+out:
+	ttm_bo_put(&bo->tbo);
+	kfree(async);
+}
+
+/* 将BO的放置、填充和清理交给后台完成 */
+int pddgpu_bo_queue_async_setup(struct pddgpu_bo *bo)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_bo_async_work *async;
+
+	async = kzalloc(sizeof(*async), GFP_KERNEL);
+	if (!async)
+		return -ENOMEM;
+
+	/* 工作函数持有BO引用，句柄关闭后仍可安全完成 */
+	ttm_bo_get(&bo->tbo);
+	async->bo = bo;
+	INIT_WORK(&async->work, pddgpu_bo_async_setup_work);
+	queue_work(pdev->mman.bo_create_wq, &async->work);
+
+	return 0;
+}
+
+/* 异步BO创建初始化 */
+int pddgpu_bo_create_async_init(struct pddgpu_device *pdev)
+{
+	pdev->mman.bo_create_wq = alloc_workqueue("pddgpu-bo-create",
+	                                          WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!pdev->mman.bo_create_wq)
+		return -ENOMEM;
+
+	spin_lock_init(&pdev->mman.bo_create_fence_lock);
+
+	return 0;
+}
+
+/* 异步BO创建清理 */
+void pddgpu_bo_create_async_fini(struct pddgpu_device *pdev)
+{
+	if (!pdev->mman.bo_create_wq)
+		return;
+
+	destroy_workqueue(pdev->mman.bo_create_wq);
+	pdev->mman.bo_create_wq = NULL;
 }
 
 /* 释放BO引用 */
@@ -222,8 +671,7 @@ void pddgpu_bo_destroy(struct ttm_buffer_object *tbo)
 	pddgpu_memory_stats_free_start(pdev, bo);
 	
 	/* 清理映射 */
-	if (bo->kmap.bo)
-		ttm_bo_kunmap(&bo->kmap);
+	pddgpu_kmap_cache_bo_fini(bo);
 	
 	/* 清理通知器 */
 #ifdef CONFIG_MMU_NOTIFIER
@@ -234,6 +682,9 @@ void pddgpu_bo_destroy(struct ttm_buffer_object *tbo)
 	/* 完成内存释放统计 */
 	pddgpu_memory_stats_free_end(pdev, bo);
 
+	pddgpu_client_bo_update(bo, NULL);
+	pddgpu_fpriv_put(bo->owner);
+
 	/* 释放BO结构 */
 	kvfree(bo);
 }
@@ -524,6 +975,10 @@ void pddgpu_bo_placement_from_domain(struct pddgpu_bo *bo, u32 domain)
 	u64 flags = bo->flags;
 	u32 c = 0;
 
+	/* 抖动的BO在回退窗口内或降级后，只要有其他域可选就不放入VRAM */
+	if (domain & ~PDDGPU_GEM_DOMAIN_VRAM && pddgpu_thrash_avoid_vram(bo))
+		domain &= ~PDDGPU_GEM_DOMAIN_VRAM;
+
 	if (domain & PDDGPU_GEM_DOMAIN_VRAM) {
 		unsigned int visible_pfn = pdev->gmc.visible_vram_size >> PAGE_SHIFT;
 
@@ -586,6 +1041,10 @@ u64 pddgpu_bo_gpu_offset(struct pddgpu_bo *bo)
 {
 	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
 
+	/* 延迟放置且尚未使用的BO没有GPU地址 */
+	if (!bo->tbo.resource)
+		return PDDGPU_BO_INVALID_OFFSET;
+
 	if (bo->tbo.resource->mem_type == TTM_PL_VRAM)
 		return pdev->gmc.vram_start + bo->tbo.resource->start << PAGE_SHIFT;
 	else if (bo->tbo.resource->mem_type == TTM_PL_TT)
@@ -608,7 +1067,10 @@ int pddgpu_bo_pin(struct pddgpu_bo *bo, u32 domain)
 	if (unlikely(r != 0))
 		return r;
 
-	r = ttm_bo_validate(&bo->tbo, &bo->placement, &ctx);
+	/* 延迟放置的BO先完成首次放置（含VRAM清理） */
+	r = pddgpu_bo_lazy_place(bo, PDDGPU_MOVE_PRIO_INLINE);
+	if (likely(r == 0))
+		r = ttm_bo_validate(&bo->tbo, &bo->placement, &ctx);
 	if (likely(r == 0))
 		ttm_bo_pin(&bo->tbo);
 
@@ -639,6 +1101,8 @@ int pddgpu_bo_kmap(struct pddgpu_bo *bo, void **ptr)
 	if (r < 0)
 		return r;
 
+	pddgpu_bo_touch(bo);
+
 	kptr = pddgpu_bo_kptr(bo);
 	if (kptr) {
 		if (ptr)
@@ -646,12 +1110,19 @@ int pddgpu_bo_kmap(struct pddgpu_bo *bo, void **ptr)
 		return 0;
 	}
 
-	r = ttm_bo_kmap(&bo->tbo, 0, PFN_UP(bo->tbo.base.size), &bo->kmap);
+	/* 延迟放置的BO在首次映射时分配后备存储 */
+	r = pddgpu_bo_lazy_place(bo, PDDGPU_MOVE_PRIO_INLINE);
 	if (r)
 		return r;
 
+	/* 从设备映射缓存获取整BO映射，重复映射无需重新vmap */
+	r = pddgpu_kmap_cache_get(bo, 0, PFN_UP(bo->tbo.base.size), &kptr, NULL);
+	if (r)
+		return r;
+
+	bo->kptr = kptr;
 	if (ptr)
-		*ptr = pddgpu_bo_kptr(bo);
+		*ptr = kptr;
 
 	return 0;
 }
@@ -659,13 +1130,16 @@ int pddgpu_bo_kmap(struct pddgpu_bo *bo, void **ptr)
 /* 获取内核指针 */
 void *pddgpu_bo_kptr(struct pddgpu_bo *bo)
 {
-	bool is_iomem;
-
-	return ttm_kmap_obj_virtual(&bo->kmap, &is_iomem);
+	return bo->kptr;
 }
 
 /* 取消内核映射 */
 void pddgpu_bo_kunmap(struct pddgpu_bo *bo)
 {
-	ttm_bo_kunmap(&bo->tbo, &bo->kmap);
+	if (!bo->kptr)
+		return;
+
+	/* 映射归还缓存，空闲时由LRU或收缩器拆除 */
+	pddgpu_kmap_cache_put(bo, bo->kptr);
+	bo->kptr = NULL;
 }
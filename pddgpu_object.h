@@ -7,6 +7,8 @@
 #ifndef __PDDGPU_OBJECT_H__
 #define __PDDGPU_OBJECT_H__
 
+#include <linux/ktime.h>
+
 #include <drm/drm_gem.h>
 #include <drm/ttm/ttm_bo.h>
 #include <drm/ttm/ttm_placement.h>
@@ -26,6 +28,8 @@ struct pddgpu_bo_param {
 	bool no_wait_gpu;
 	struct dma_resv *resv;
 	void (*destroy)(struct ttm_buffer_object *);
+	/* 创建者，移动计入其配额；内核BO为NULL */
+	struct pddgpu_fpriv *owner;
 	/* xcp partition number plus 1, 0 means any partition */
 	int8_t xcp_id_plus1;
 };
@@ -38,7 +42,31 @@ struct pddgpu_bo {
 	struct ttm_place placements[TTM_PL_MAX];
 	struct ttm_placement placement;
 	struct ttm_buffer_object tbo;
-	struct ttm_bo_kmap_obj kmap;
+	/* 内核映射缓存中属于该BO的映射，受kmap_cache.lock保护 */
+	struct list_head kmap_entries;
+	/* pddgpu_bo_kmap()返回的整BO映射 */
+	void *kptr;
+	/* GTT页面的DMA映射，属于ttm_tt，页面不变时跨移动保留 */
+	struct sg_table *sg;
+	/* 最近一次CPU访问或放置的时间，驱逐代价评估用 */
+	u64 last_use_ns;
+	/* 抽样判定不可压缩时的last_use_ns，BO再次使用前不再抽样 */
+	u64 incompressible_ns;
+	/* 按半衰期衰减的访问计数及其时间戳，冷热分层用 */
+	u32 heat;
+	u64 heat_stamp;
+	/* 移动历史，抖动检测用 */
+	struct pddgpu_bo_thrash thrash;
+	/* 创建该BO的客户端，可能为空（内核BO） */
+	struct pddgpu_fpriv *owner;
+	/* 计入owner内存统计的区域和状态，-1表示未计入，受tbo.reserved保护 */
+	s8 client_mem_type;
+	u8 client_flags;
+	u64 client_visible;             /* 计入的CPU可见VRAM字节数 */
+	/* 用户设置的madvise状态，受tbo.reserved保护 */
+	u32 madv;
+	/* 后备存储已因DONTNEED被丢弃，下次WILLNEED时报告给用户 */
+	bool purged;
 	u64 flags;
 	/* per VM structure for page tables and with virtual addresses */
 	struct pddgpu_vm_bo_base *vm_bo;
@@ -92,6 +120,13 @@ void pddgpu_bo_free_kernel(struct pddgpu_bo **bo, u64 *gpu_addr,
 
 /* 辅助函数 */
 bool pddgpu_bo_validate_size(struct pddgpu_device *pdev, unsigned long size, u32 domain);
+int pddgpu_bo_lazy_place(struct pddgpu_bo *bo, enum pddgpu_move_prio prio);
+int pddgpu_bo_validate(struct pddgpu_bo *bo, struct ttm_operation_ctx *ctx);
+int pddgpu_bo_set_priority(struct pddgpu_bo *bo, unsigned int priority);
+int pddgpu_bo_madvise(struct pddgpu_bo *bo, u32 madv, bool *retained);
+int pddgpu_bo_create_async_init(struct pddgpu_device *pdev);
+void pddgpu_bo_create_async_fini(struct pddgpu_device *pdev);
+int pddgpu_bo_queue_async_setup(struct pddgpu_bo *bo);
 void pddgpu_bo_placement_from_domain(struct pddgpu_bo *bo, u32 domain);
 bool pddgpu_bo_support_uswc(u64 bo_flags);
 u64 pddgpu_bo_gpu_offset(struct pddgpu_bo *bo);
@@ -111,6 +146,18 @@ void pddgpu_gtt_mgr_fini(struct pddgpu_device *pdev);
 
 /* 转换宏 */
 #define to_pddgpu_bo(x) container_of(x, struct pddgpu_bo, tbo)
+
+/* LRU上可能有TTM内部的ghost对象，转换前需确认 */
+static inline bool pddgpu_bo_is_pddgpu_bo(struct ttm_buffer_object *bo)
+{
+	return bo->destroy == &pddgpu_bo_destroy;
+}
+
+/* 记录BO的使用时间和访问热度 */
+static inline void pddgpu_bo_touch(struct pddgpu_bo *bo)
+{
+	pddgpu_tier_note_access(bo);
+}
 #define to_pddgpu_vram_mgr(x) container_of(x, struct pddgpu_vram_mgr, manager)
 #define to_pddgpu_gtt_mgr(x) container_of(x, struct pddgpu_gtt_mgr, manager)
 
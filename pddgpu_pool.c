@@ -0,0 +1,611 @@
+/*
+ * PDDGPU TTM页面池实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/highmem.h>
+#include <linux/dma-mapping.h>
+#include <linux/shrinker.h>
+#include <linux/slab.h>
+#include <linux/cpumask.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
+#include <linux/topology.h>
+
+#ifdef CONFIG_X86
+#include <asm/set_memory.h>
+#endif
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_tt.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_pool.h"
+
+static const char * const pddgpu_pool_caching_names[TTM_NUM_CACHING_TYPES] = {
+	[ttm_uncached] = "UC",
+	[ttm_write_combined] = "WC",
+	[ttm_cached] = "Cached",
+};
+
+/* 改变块的页表属性，只有x86需要 */
+static int pddgpu_pool_set_caching(struct page *p, unsigned int order,
+                                   enum ttm_caching caching)
+{
+#ifdef CONFIG_X86
+	unsigned long addr = (unsigned long)page_address(p);
+
+	switch (caching) {
+	case ttm_write_combined:
+		return set_memory_wc(addr, 1 << order);
+	case ttm_uncached:
+		return set_memory_uc(addr, 1 << order);
+	case ttm_cached:
+		return set_memory_wb(addr, 1 << order);
+	}
+#endif
+	return 0;
+}
+
+/* 从系统分配一个块并设置属性，块的阶记录在首页的private中 */
+static struct page *pddgpu_pool_alloc_block(struct pddgpu_page_pool *pool,
+                                            gfp_t gfp, int node,
+                                            enum ttm_caching caching,
+                                            unsigned int order)
+{
+	struct page *p;
+
+	/* 高阶分配失败时退到低阶，不必为此进入深度回收 */
+	if (order)
+		gfp |= __GFP_NOMEMALLOC | __GFP_NORETRY | __GFP_NOWARN |
+		       __GFP_KSWAPD_RECLAIM;
+
+	/* 改变属性需要线性映射 */
+	if (caching != ttm_cached)
+		gfp &= ~__GFP_HIGHMEM;
+
+	/* 大页块以复合页分配，可以作为一个整体映射 */
+	if (order == PDDGPU_POOL_HUGE_ORDER)
+		gfp |= __GFP_COMP;
+
+	p = alloc_pages_node(node, gfp, order);
+	if (!p)
+		return NULL;
+
+	set_page_private(p, order);
+
+	if (caching != ttm_cached) {
+		if (pddgpu_pool_set_caching(p, order, caching)) {
+			__free_pages(p, order);
+			return NULL;
+		}
+		atomic64_add(1 << order, &pool->caching_changes);
+	}
+
+	return p;
+}
+
+/* 把块还给系统，WC/UC页面先恢复为回写属性 */
+static void pddgpu_pool_free_block(struct pddgpu_page_pool *pool, struct page *p,
+                                   enum ttm_caching caching, unsigned int order)
+{
+	if (caching != ttm_cached) {
+		/* 属性恢复失败的页面不能再交给系统使用 */
+		if (pddgpu_pool_set_caching(p, order, ttm_cached)) {
+			PDDGPU_ERROR("Failed to restore page caching, leaking %u pages\n",
+			             1 << order);
+			return;
+		}
+		atomic64_add(1 << order, &pool->caching_changes);
+	}
+
+	set_page_private(p, 0);
+	__free_pages(p, order);
+}
+
+static struct page *pddgpu_pool_take(struct pddgpu_page_pool *pool,
+                                     enum ttm_caching caching, unsigned int order)
+{
+	struct pddgpu_pool_type *pt = &pool->types[caching][order];
+	struct page *p;
+
+	spin_lock(&pt->lock);
+	p = list_first_entry_or_null(&pt->pages, struct page, lru);
+	if (p) {
+		list_del(&p->lru);
+		pt->nr--;
+	}
+	spin_unlock(&pt->lock);
+
+	if (p)
+		atomic_long_sub(1 << order, &pool->nr_pages);
+
+	return p;
+}
+
+/* 清零后放回池中，池满时直接还给系统 */
+static void pddgpu_pool_give(struct pddgpu_page_pool *pool, struct page *p,
+                             enum ttm_caching caching, unsigned int order)
+{
+	struct pddgpu_pool_type *pt = &pool->types[caching][order];
+	unsigned int i;
+
+	if (atomic_long_read(&pool->nr_pages) + (1 << order) > pool->max_pages) {
+		pddgpu_pool_free_block(pool, p, caching, order);
+		return;
+	}
+
+	/* 池中的页面会交给其他客户端，不能留下旧内容 */
+	for (i = 0; i < (1 << order); i++)
+		clear_highpage(p + i);
+
+	spin_lock(&pt->lock);
+	list_add(&p->lru, &pt->pages);
+	pt->nr++;
+	spin_unlock(&pt->lock);
+
+	atomic_long_add(1 << order, &pool->nr_pages);
+}
+
+/* 池中是否有比order小的同属性块 */
+static bool pddgpu_pool_has_lower(struct pddgpu_page_pool *pool,
+                                  enum ttm_caching caching, unsigned int order)
+{
+	while (order--) {
+		if (READ_ONCE(pool->types[caching][order].nr))
+			return true;
+	}
+
+	return false;
+}
+
+static gfp_t pddgpu_pool_gfp(struct pddgpu_page_pool *pool, struct ttm_tt *tt,
+                             struct ttm_operation_ctx *ctx)
+{
+	gfp_t gfp = GFP_USER;
+
+	if (tt->page_flags & TTM_TT_FLAG_ZERO_ALLOC)
+		gfp |= __GFP_ZERO;
+
+	if (ctx->gfp_retry_mayfail)
+		gfp |= __GFP_RETRY_MAYFAIL;
+
+	if (pool->use_dma32)
+		gfp |= GFP_DMA32;
+	else
+		gfp |= GFP_HIGHUSER;
+
+	return gfp;
+}
+
+/*
+ * 释放ttm_tt中[start, end)的页面，跳过稀疏ttm_tt中未填充的页。按块放回池中，
+ * release为真时恢复回写属性后直接还给系统。
+ */
+static void pddgpu_pool_free_range(struct pddgpu_page_pool *pool, struct ttm_tt *tt,
+                                   pgoff_t start, pgoff_t end, bool release)
+{
+	unsigned int order;
+	struct page *p;
+	pgoff_t i;
+
+	for (i = start; i < end; i += 1 << order) {
+		p = tt->pages[i];
+		if (!p) {
+			order = 0;
+			continue;
+		}
+		order = page_private(p);
+		if (order == PDDGPU_POOL_HUGE_ORDER)
+			atomic_long_sub(1 << order, &pool->tt_huge_pages);
+		atomic_long_sub(1 << order, &pool->tt_pages);
+		if (release)
+			pddgpu_pool_free_block(pool, p, tt->caching, order);
+		else
+			pddgpu_pool_give(pool, p, tt->caching, order);
+		memset(&tt->pages[i], 0, sizeof(*tt->pages) << order);
+	}
+}
+
+/*
+ * 填充ttm_tt中[start, end)的页面，优先从池中取同属性的块。每个位置都从
+ * 对齐和剩余长度允许的最高阶重新尝试，每个块都按自身大小对齐；某个块
+ * 分配失败只让这一块退到小阶，下一个大页边界上仍先尝试大页。
+ * 不足最高阶的头尾部分在WC/UC的当前阶池为空但低阶池中有块时先用
+ * 低阶块，避免为新页面改属性。失败时释放已填充的部分。
+ */
+static int pddgpu_pool_alloc_range(struct pddgpu_page_pool *pool, struct ttm_tt *tt,
+                                   gfp_t gfp, int node, pgoff_t start, pgoff_t end)
+{
+	unsigned int max_order = READ_ONCE(pddgpu_huge_tt) ? PDDGPU_POOL_HUGE_ORDER :
+	                         PDDGPU_POOL_HUGE_ORDER - 1;
+	unsigned int order;
+	pgoff_t i = start, j;
+	struct page *p;
+
+	while (i < end) {
+		order = min_t(unsigned int, max_order, __fls(end - i));
+		if (i)
+			order = min_t(unsigned int, order, __ffs(i));
+
+		for (;;) {
+			p = pddgpu_pool_take(pool, tt->caching, order);
+			if (p) {
+				atomic64_inc(&pool->hits);
+				break;
+			}
+
+			if (order && order < max_order && tt->caching != ttm_cached &&
+			    pddgpu_pool_has_lower(pool, tt->caching, order)) {
+				order--;
+				continue;
+			}
+
+			p = pddgpu_pool_alloc_block(pool, gfp, node, tt->caching, order);
+			if (p) {
+				atomic64_inc(&pool->misses);
+				break;
+			}
+
+			if (!order) {
+				pddgpu_pool_free_range(pool, tt, start, i, false);
+				return -ENOMEM;
+			}
+			order--;
+		}
+
+		for (j = 0; j < (1 << order); j++)
+			tt->pages[i + j] = p + j;
+		i += 1 << order;
+
+		if (order == PDDGPU_POOL_HUGE_ORDER)
+			atomic_long_add(1 << order, &pool->tt_huge_pages);
+		atomic_long_add(1 << order, &pool->tt_pages);
+	}
+
+	return 0;
+}
+
+/* 一次并行填充，调用者等待所有范围完成 */
+struct pddgpu_pool_populate {
+	struct pddgpu_page_pool *pool;
+	struct ttm_tt *tt;
+	gfp_t gfp;
+	int node;
+	atomic_t pending;
+	struct completion done;
+};
+
+/* 工作线程填充的一段范围 */
+struct pddgpu_pool_populate_work {
+	struct work_struct work;
+	struct pddgpu_pool_populate *job;
+	pgoff_t start;
+	pgoff_t end;
+	int error;
+};
+
+static void pddgpu_pool_populate_func(struct work_struct *work)
+{
+	struct pddgpu_pool_populate_work *w =
+		container_of(work, struct pddgpu_pool_populate_work, work);
+	struct pddgpu_pool_populate *job = w->job;
+
+	w->error = pddgpu_pool_alloc_range(job->pool, job->tt, job->gfp, job->node,
+	                                   w->start, w->end);
+
+	if (atomic_dec_and_test(&job->pending))
+		complete(&job->done);
+}
+
+/*
+ * 并行填充：按大页边界把ttm_tt切成不相交的范围，调用线程填充第一段，
+ * 其余交给工作线程。工作线程运行在设备所在的NUMA节点上，设备没有节点
+ * 信息时使用调用者的节点。任一范围失败时释放所有范围。
+ */
+static int pddgpu_pool_alloc_parallel(struct pddgpu_page_pool *pool,
+                                      struct ttm_tt *tt, gfp_t gfp, int node)
+{
+	struct pddgpu_pool_populate job = {
+		.pool = pool,
+		.tt = tt,
+		.gfp = gfp,
+		.node = node,
+	};
+	struct pddgpu_pool_populate_work *works;
+	pgoff_t per_worker, start;
+	u32 i, n;
+	int r;
+
+	n = min_t(u32, pool->num_workers + 1,
+	          DIV_ROUND_UP(tt->num_pages, PDDGPU_POOL_MIN_PARALLEL_PAGES));
+	per_worker = round_up(DIV_ROUND_UP(tt->num_pages, n), PDDGPU_POOL_HUGE_PAGES);
+	n = DIV_ROUND_UP(tt->num_pages, per_worker);
+
+	works = kcalloc(n, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return pddgpu_pool_alloc_range(pool, tt, gfp, node, 0, tt->num_pages);
+
+	atomic_set(&job.pending, n - 1);
+	init_completion(&job.done);
+
+	for (i = 0, start = 0; i < n; i++, start += per_worker) {
+		works[i].job = &job;
+		works[i].start = start;
+		works[i].end = min_t(pgoff_t, start + per_worker, tt->num_pages);
+		INIT_WORK(&works[i].work, pddgpu_pool_populate_func);
+		if (i)
+			queue_work_node(node, pool->populate_wq, &works[i].work);
+	}
+
+	works[0].error = pddgpu_pool_alloc_range(pool, tt, gfp, node,
+	                                         works[0].start, works[0].end);
+
+	if (n > 1)
+		wait_for_completion(&job.done);
+
+	for (i = 0, r = 0; i < n && !r; i++)
+		r = works[i].error;
+
+	/* 失败的范围已自行释放，只需释放成功的范围 */
+	if (r) {
+		for (i = 0; i < n; i++) {
+			if (!works[i].error)
+				pddgpu_pool_free_range(pool, tt, works[i].start, works[i].end, false);
+		}
+	}
+
+	atomic64_inc(&pool->parallel_populates);
+	kfree(works);
+
+	return r;
+}
+
+/* 设备所在的NUMA节点，设备没有节点信息时使用调用者的节点 */
+static int pddgpu_pool_node(struct pddgpu_page_pool *pool)
+{
+	int node = dev_to_node(pool->dev);
+
+	return node == NUMA_NO_NODE ? numa_node_id() : node;
+}
+
+/* 填充ttm_tt，足够大的ttm_tt由多个工作线程并行填充 */
+int pddgpu_pool_alloc(struct pddgpu_page_pool *pool, struct ttm_tt *tt,
+                      struct ttm_operation_ctx *ctx)
+{
+	gfp_t gfp = pddgpu_pool_gfp(pool, tt, ctx);
+	u64 threshold = (u64)max(READ_ONCE(pddgpu_populate_parallel_mb), 0) <<
+	                (20 - PAGE_SHIFT);
+	int node = pddgpu_pool_node(pool);
+
+	if (threshold && pool->populate_wq && tt->num_pages >= threshold)
+		return pddgpu_pool_alloc_parallel(pool, tt, gfp, node);
+
+	return pddgpu_pool_alloc_range(pool, tt, gfp, node, 0, tt->num_pages);
+}
+
+/* 只填充ttm_tt中[start, end)的页面，稀疏ttm_tt按块填充用，start按块大小对齐 */
+int pddgpu_pool_alloc_pages(struct pddgpu_page_pool *pool, struct ttm_tt *tt,
+                            struct ttm_operation_ctx *ctx, pgoff_t start, pgoff_t end)
+{
+	return pddgpu_pool_alloc_range(pool, tt, pddgpu_pool_gfp(pool, tt, ctx),
+	                               pddgpu_pool_node(pool), start, end);
+}
+
+/* 释放ttm_tt的全部页面 */
+void pddgpu_pool_free(struct pddgpu_page_pool *pool, struct ttm_tt *tt)
+{
+	pddgpu_pool_free_range(pool, tt, 0, tt->num_pages, false);
+}
+
+/*
+ * 释放ttm_tt的全部页面并直接还给系统。换出和压缩是为了腾出系统内存，
+ * 页面留在池中只会被计为已释放，实际仍被驱动占用。
+ */
+void pddgpu_pool_release(struct pddgpu_page_pool *pool, struct ttm_tt *tt)
+{
+	pddgpu_pool_free_range(pool, tt, 0, tt->num_pages, true);
+}
+
+/* 收缩器：统计池中的页数 */
+static unsigned long pddgpu_pool_shrinker_count(struct shrinker *shrink,
+                                                struct shrink_control *sc)
+{
+	struct pddgpu_page_pool *pool = shrink->private_data;
+	unsigned long count = atomic_long_read(&pool->nr_pages);
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+/* 收缩器：在各个池之间轮转释放，避免总是清空同一个池 */
+static unsigned long pddgpu_pool_shrinker_scan(struct shrinker *shrink,
+                                               struct shrink_control *sc)
+{
+	struct pddgpu_page_pool *pool = shrink->private_data;
+	unsigned long freed = 0;
+	unsigned int n, idx, order;
+	enum ttm_caching caching;
+	struct page *p;
+
+	for (n = 0; n < PDDGPU_POOL_NUM_TYPES && freed < sc->nr_to_scan; n++) {
+		idx = (unsigned int)atomic_inc_return(&pool->shrink_cursor) %
+		      PDDGPU_POOL_NUM_TYPES;
+		caching = idx / PDDGPU_POOL_NUM_ORDERS;
+		order = idx % PDDGPU_POOL_NUM_ORDERS;
+
+		while (freed < sc->nr_to_scan &&
+		       (p = pddgpu_pool_take(pool, caching, order))) {
+			pddgpu_pool_free_block(pool, p, caching, order);
+			freed += 1 << order;
+		}
+	}
+
+	atomic64_add(freed, &pool->shrunk);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+/*
+ * 预热写合并池，把改变页面属性的开销放在加载时而不是创建BO时。
+ * 不使用大页ttm_tt时填充只取到HUGE_ORDER - 1，不预热用不到的2MB块。
+ */
+static void pddgpu_pool_prewarm(struct pddgpu_page_pool *pool, unsigned long nr_pages)
+{
+	gfp_t gfp = pool->use_dma32 ? GFP_USER | GFP_DMA32 : GFP_USER;
+	unsigned int order = READ_ONCE(pddgpu_huge_tt) ? PDDGPU_POOL_HUGE_ORDER :
+	                     PDDGPU_POOL_HUGE_ORDER - 1;
+	unsigned long done = 0;
+	struct page *p;
+
+	nr_pages = min(nr_pages, pool->max_pages);
+
+	while (done < nr_pages) {
+		order = min_t(unsigned int, order, __fls(nr_pages - done));
+
+		p = pddgpu_pool_alloc_block(pool, gfp, dev_to_node(pool->dev),
+		                            ttm_write_combined, order);
+		if (!p) {
+			if (!order)
+				break;
+			order--;
+			continue;
+		}
+
+		pddgpu_pool_give(pool, p, ttm_write_combined, order);
+		done += 1 << order;
+	}
+
+	PDDGPU_INFO("Page pool prewarmed with %lu MB of WC pages\n",
+	            done >> (20 - PAGE_SHIFT));
+}
+
+/* 初始化页面池 */
+int pddgpu_pool_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_page_pool *pool = &pdev->mman.pool;
+	unsigned int caching, order;
+
+	PDDGPU_DEBUG("Initializing page pool\n");
+
+	pool->dev = &pdev->pdev->dev;
+	pool->use_dma32 = dma_get_mask(pool->dev) <= DMA_BIT_MASK(32);
+	pool->max_pages = (unsigned long)max(pddgpu_pool_max_mb, 0) << (20 - PAGE_SHIFT);
+
+	for (caching = 0; caching < TTM_NUM_CACHING_TYPES; caching++) {
+		for (order = 0; order < PDDGPU_POOL_NUM_ORDERS; order++) {
+			struct pddgpu_pool_type *pt = &pool->types[caching][order];
+
+			spin_lock_init(&pt->lock);
+			INIT_LIST_HEAD(&pt->pages);
+			pt->nr = 0;
+		}
+	}
+	atomic_long_set(&pool->nr_pages, 0);
+	atomic_set(&pool->shrink_cursor, 0);
+
+	atomic64_set(&pool->hits, 0);
+	atomic64_set(&pool->misses, 0);
+	atomic64_set(&pool->caching_changes, 0);
+	atomic64_set(&pool->shrunk, 0);
+	atomic_long_set(&pool->tt_pages, 0);
+	atomic_long_set(&pool->tt_huge_pages, 0);
+	atomic64_set(&pool->parallel_populates, 0);
+
+	/* 并行填充的工作线程，数量不超过CPU数 */
+	pool->num_workers = clamp_t(u32, num_online_cpus(), 1, PDDGPU_POOL_MAX_WORKERS) - 1;
+	if (pool->num_workers) {
+		pool->populate_wq = alloc_workqueue("pddgpu-populate", WQ_UNBOUND,
+		                                    pool->num_workers);
+		if (!pool->populate_wq)
+			PDDGPU_ERROR("Failed to allocate populate workqueue, populating serially\n");
+	}
+
+	pool->shrinker = shrinker_alloc(0, "drm-pddgpu_pool");
+	if (!pool->shrinker) {
+		PDDGPU_ERROR("Failed to allocate page pool shrinker\n");
+		if (pool->populate_wq) {
+			destroy_workqueue(pool->populate_wq);
+			pool->populate_wq = NULL;
+		}
+		return -ENOMEM;
+	}
+
+	pool->shrinker->count_objects = pddgpu_pool_shrinker_count;
+	pool->shrinker->scan_objects = pddgpu_pool_shrinker_scan;
+	pool->shrinker->private_data = pool;
+	shrinker_register(pool->shrinker);
+
+	if (pddgpu_pool_prewarm_mb > 0)
+		pddgpu_pool_prewarm(pool, (unsigned long)pddgpu_pool_prewarm_mb <<
+		                          (20 - PAGE_SHIFT));
+
+	PDDGPU_DEBUG("Page pool initialized: max=%d MB, dma32=%d\n",
+	             pddgpu_pool_max_mb, pool->use_dma32);
+
+	return 0;
+}
+
+/* 清理页面池，所有页面还给系统 */
+void pddgpu_pool_fini(struct pddgpu_device *pdev)
+{
+	struct pddgpu_page_pool *pool = &pdev->mman.pool;
+	unsigned int caching, order;
+	struct page *p;
+
+	PDDGPU_DEBUG("Finalizing page pool\n");
+
+	if (pool->shrinker) {
+		shrinker_free(pool->shrinker);
+		pool->shrinker = NULL;
+	}
+
+	if (pool->populate_wq) {
+		destroy_workqueue(pool->populate_wq);
+		pool->populate_wq = NULL;
+	}
+
+	for (caching = 0; caching < TTM_NUM_CACHING_TYPES; caching++) {
+		for (order = 0; order < PDDGPU_POOL_NUM_ORDERS; order++) {
+			while ((p = pddgpu_pool_take(pool, caching, order)))
+				pddgpu_pool_free_block(pool, p, caching, order);
+		}
+	}
+
+	WARN_ON(atomic_long_read(&pool->nr_pages));
+}
+
+/* 调试打印 */
+void pddgpu_pool_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p)
+{
+	struct pddgpu_page_pool *pool = &pdev->mman.pool;
+	unsigned long pages, tt_pages = atomic_long_read(&pool->tt_pages);
+	unsigned long tt_huge_pages = atomic_long_read(&pool->tt_huge_pages);
+	unsigned int caching, order;
+
+	drm_printf(p, "Page Pool Debug Info:\n");
+	drm_printf(p, "  Pooled=%lu MB, Max=%lu MB, DMA32=%d\n",
+	           atomic_long_read(&pool->nr_pages) >> (20 - PAGE_SHIFT),
+	           pool->max_pages >> (20 - PAGE_SHIFT), pool->use_dma32);
+	drm_printf(p, "  Hits=%llu, Misses=%llu, Caching_Changes=%llu pages, Shrunk=%llu pages\n",
+	           atomic64_read(&pool->hits), atomic64_read(&pool->misses),
+	           atomic64_read(&pool->caching_changes), atomic64_read(&pool->shrunk));
+	drm_printf(p, "  Populated=%lu MB, Huge=%lu MB (%lu%%)\n",
+	           tt_pages >> (20 - PAGE_SHIFT), tt_huge_pages >> (20 - PAGE_SHIFT),
+	           tt_pages ? tt_huge_pages * 100 / tt_pages : 0);
+	drm_printf(p, "  Populate_Workers=%u, Parallel_Populates=%llu\n",
+	           pool->num_workers, atomic64_read(&pool->parallel_populates));
+
+	for (caching = 0; caching < TTM_NUM_CACHING_TYPES; caching++) {
+		pages = 0;
+		for (order = 0; order < PDDGPU_POOL_NUM_ORDERS; order++)
+			pages += READ_ONCE(pool->types[caching][order].nr) << order;
+
+		drm_printf(p, "  %s: %lu pages\n", pddgpu_pool_caching_names[caching], pages);
+	}
+}
@@ -0,0 +1,255 @@
+/*
+ * PDDGPU BO预取实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/dma-fence.h>
+#include <linux/dma-resv.h>
+
+#include <drm/drm_gem.h>
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_placement.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_prefetch.h"
+#include "pddgpu_object.h"
+
+/* 一次预取请求 */
+struct pddgpu_prefetch_job {
+	struct work_struct work;
+	struct pddgpu_device *pdev;
+	struct pddgpu_fpriv *fpriv;     /* 请求者，迁移计入其移动配额 */
+	struct dma_fence *fence;
+	struct drm_gem_object **objs;
+	u32 count;
+	u32 domain;
+	u64 submit_ns;
+};
+
+static const char *pddgpu_prefetch_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "pddgpu";
+}
+
+static const char *pddgpu_prefetch_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "prefetch";
+}
+
+static const struct dma_fence_ops pddgpu_prefetch_fence_ops = {
+	.get_driver_name = pddgpu_prefetch_fence_get_driver_name,
+	.get_timeline_name = pddgpu_prefetch_fence_get_timeline_name,
+};
+
+static u32 pddgpu_prefetch_mem_type(u32 domain)
+{
+	switch (domain) {
+	case PDDGPU_GEM_DOMAIN_VRAM:
+		return TTM_PL_VRAM;
+	case PDDGPU_GEM_DOMAIN_GTT:
+		return TTM_PL_TT;
+	default:
+		return TTM_PL_SYSTEM;
+	}
+}
+
+/*
+ * 把一个BO迁移到目标域。预取只是提示：已在目标域、固定、可丢弃或不允许
+ * 放在目标域的BO跳过；配额不足时保持原位，不像验证那样退回其他域。
+ */
+static int pddgpu_prefetch_one(struct pddgpu_device *pdev, struct pddgpu_fpriv *fpriv,
+                               struct pddgpu_bo *bo, u32 domain,
+                               struct ttm_operation_ctx *ctx)
+{
+	struct pddgpu_prefetch *prefetch = &pdev->mman.prefetch;
+	struct ttm_resource *res;
+	u64 size = bo->tbo.base.size;
+	u64 max_bytes, max_vis_bytes, bytes_moved, moved, vis;
+	int r = 0;
+
+	dma_resv_lock(bo->tbo.base.resv, NULL);
+
+	res = bo->tbo.resource;
+	if (bo->tbo.pin_count || bo->madv != PDDGPU_MADV_WILLNEED || bo->purged ||
+	    !(bo->allowed_domains & domain) ||
+	    (res && res->mem_type == pddgpu_prefetch_mem_type(domain))) {
+		atomic64_inc(&prefetch->skipped);
+		goto out_unlock;
+	}
+
+	pddgpu_cs_get_threshold_for_moves(pdev, fpriv, &max_bytes, &max_vis_bytes);
+	if (max_bytes < size ||
+	    (domain == PDDGPU_GEM_DOMAIN_VRAM &&
+	     bo->flags & PDDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED && max_vis_bytes < size)) {
+		pddgpu_cs_note_throttled(pdev, fpriv);
+		atomic64_inc(&prefetch->throttled);
+		goto out_unlock;
+	}
+
+	bytes_moved = ctx->bytes_moved;
+	pddgpu_bo_placement_from_domain(bo, domain);
+	r = ttm_bo_validate(&bo->tbo, &bo->placement, ctx);
+	pddgpu_bo_placement_from_domain(bo, bo->preferred_domains);
+
+	moved = ctx->bytes_moved - bytes_moved;
+	vis = bo->flags & PDDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED &&
+	      bo->tbo.resource && bo->tbo.resource->mem_type == TTM_PL_VRAM ? moved : 0;
+	pddgpu_cs_report_moved_bytes(pdev, fpriv, moved, vis);
+
+	if (r) {
+		PDDGPU_DEBUG("Prefetch of BO %p failed: %d\n", bo, r);
+		atomic64_inc(&prefetch->errors);
+	} else {
+		atomic64_inc(&prefetch->bos);
+		atomic64_add(size, &prefetch->bytes);
+	}
+
+out_unlock:
+	dma_resv_unlock(bo->tbo.base.resv);
+
+	return r;
+}
+
+/* 预取工作函数：依次提交迁移，等复制引擎全部完成后发出栅栏信号 */
+static void pddgpu_prefetch_work(struct work_struct *work)
+{
+	struct pddgpu_prefetch_job *job =
+		container_of(work, struct pddgpu_prefetch_job, work);
+	struct pddgpu_prefetch *prefetch = &job->pdev->mman.prefetch;
+	struct pddgpu_move_ctx mctx = { .base = { .interruptible = false } };
+	int r, err = 0;
+	u32 i;
+
+	/* 预取的迁移及其引起的驱逐都按PREFETCH优先级复制 */
+	pddgpu_move_ctx_begin(job->pdev, &mctx, PDDGPU_MOVE_PRIO_PREFETCH);
+	for (i = 0; i < job->count; i++) {
+		r = pddgpu_prefetch_one(job->pdev, job->fpriv, to_pddgpu_bo(job->objs[i]),
+		                        job->domain, &mctx.base);
+		if (r && !err)
+			err = r;
+	}
+	pddgpu_move_ctx_end(job->pdev, &mctx);
+
+	for (i = 0; i < job->count; i++)
+		dma_resv_wait_timeout(job->objs[i]->resv, DMA_RESV_USAGE_KERNEL, false,
+		                      MAX_SCHEDULE_TIMEOUT);
+
+	atomic64_add(ktime_get_ns() - job->submit_ns, &prefetch->latency_ns);
+
+	if (err)
+		dma_fence_set_error(job->fence, err);
+	dma_fence_signal(job->fence);
+	dma_fence_put(job->fence);
+
+	for (i = 0; i < job->count; i++)
+		drm_gem_object_put(job->objs[i]);
+	kvfree(job->objs);
+	pddgpu_fpriv_put(job->fpriv);
+	kfree(job);
+}
+
+/* 提交预取请求 */
+struct dma_fence *pddgpu_prefetch_submit(struct pddgpu_device *pdev,
+                                         struct pddgpu_fpriv *fpriv,
+                                         struct drm_gem_object **objs,
+                                         u32 count, u32 domain)
+{
+	struct pddgpu_prefetch *prefetch = &pdev->mman.prefetch;
+	struct pddgpu_prefetch_job *job;
+	struct dma_fence *fence;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return ERR_PTR(-ENOMEM);
+
+	fence = kzalloc(sizeof(*fence), GFP_KERNEL);
+	if (!fence) {
+		kfree(job);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	/* 有序队列按提交顺序完成，序号与信号顺序一致 */
+	dma_fence_init(fence, &pddgpu_prefetch_fence_ops, &prefetch->fence_lock,
+	               prefetch->fence_context,
+	               atomic64_inc_return(&prefetch->fence_seqno));
+
+	job->pdev = pdev;
+	job->fpriv = pddgpu_fpriv_get(fpriv);
+	job->fence = dma_fence_get(fence);
+	job->objs = objs;
+	job->count = count;
+	job->domain = domain;
+	job->submit_ns = ktime_get_ns();
+	INIT_WORK(&job->work, pddgpu_prefetch_work);
+
+	atomic64_inc(&prefetch->requests);
+	queue_work(prefetch->wq, &job->work);
+
+	return fence;
+}
+
+/* 初始化预取 */
+int pddgpu_prefetch_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_prefetch *prefetch = &pdev->mman.prefetch;
+
+	PDDGPU_DEBUG("Initializing BO prefetch\n");
+
+	prefetch->wq = alloc_ordered_workqueue("pddgpu-prefetch", 0);
+	if (!prefetch->wq)
+		return -ENOMEM;
+
+	prefetch->fence_context = dma_fence_context_alloc(1);
+	atomic64_set(&prefetch->fence_seqno, 0);
+	spin_lock_init(&prefetch->fence_lock);
+
+	atomic64_set(&prefetch->requests, 0);
+	atomic64_set(&prefetch->bos, 0);
+	atomic64_set(&prefetch->bytes, 0);
+	atomic64_set(&prefetch->skipped, 0);
+	atomic64_set(&prefetch->throttled, 0);
+	atomic64_set(&prefetch->errors, 0);
+	atomic64_set(&prefetch->latency_ns, 0);
+
+	return 0;
+}
+
+/* 清理预取，等待已提交的请求完成 */
+void pddgpu_prefetch_fini(struct pddgpu_device *pdev)
+{
+	struct pddgpu_prefetch *prefetch = &pdev->mman.prefetch;
+
+	PDDGPU_DEBUG("Finalizing BO prefetch\n");
+
+	if (!prefetch->wq)
+		return;
+
+	destroy_workqueue(prefetch->wq);
+	prefetch->wq = NULL;
+}
+
+/* 调试打印 */
+void pddgpu_prefetch_debug_print(struct pddgpu_device *pdev,
+                                 struct drm_printer *p)
+{
+	struct pddgpu_prefetch *prefetch = &pdev->mman.prefetch;
+	u64 requests = atomic64_read(&prefetch->requests);
+
+	drm_printf(p, "BO Prefetch Debug Info:\n");
+	drm_printf(p, "  Requests=%llu, Avg_Latency=%llu us\n", requests,
+	           requests ? div64_u64(atomic64_read(&prefetch->latency_ns),
+	                                requests * NSEC_PER_USEC) : 0);
+	drm_printf(p, "  BOs=%llu (%llu MB), Skipped=%llu, Throttled=%llu, Errors=%llu\n",
+	           atomic64_read(&prefetch->bos),
+	           atomic64_read(&prefetch->bytes) >> 20,
+	           atomic64_read(&prefetch->skipped),
+	           atomic64_read(&prefetch->throttled),
+	           atomic64_read(&prefetch->errors));
+}
@@ -0,0 +1,269 @@
+/*
+ * PDDGPU 后台内存回收实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
+#include <linux/dma-resv.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_device.h>
+#include <drm/ttm/ttm_placement.h>
+#include <drm/ttm/ttm_resource.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_reclaim.h"
+#include "pddgpu_object.h"
+
+/* 空闲字节数 */
+static u64 pddgpu_reclaim_free(struct ttm_resource_manager *man)
+{
+	u64 used = ttm_resource_manager_usage(man);
+
+	return man->size > used ? man->size - used : 0;
+}
+
+/* 水位百分比换算为字节数 */
+static u64 pddgpu_reclaim_mark(struct ttm_resource_manager *man, int pct)
+{
+	return div_u64(man->size * clamp(pct, 0, 100), 100);
+}
+
+static struct ttm_resource_manager *
+pddgpu_reclaim_manager(struct pddgpu_device *pdev, u32 mem_type)
+{
+	struct ttm_resource_manager *man;
+
+	if (mem_type != TTM_PL_VRAM && mem_type != TTM_PL_TT)
+		return NULL;
+
+	man = ttm_manager_type(&pdev->mman.bdev, mem_type);
+	if (!man || !man->use_type || !man->size)
+		return NULL;
+
+	return man;
+}
+
+/* 从LRU头挑选一个冷BO，返回时已持有其预留锁和引用 */
+static struct pddgpu_bo *pddgpu_reclaim_pick(struct pddgpu_device *pdev,
+                                             struct ttm_resource_manager *man)
+{
+	struct ttm_device *bdev = &pdev->mman.bdev;
+	u64 min_age = (u64)max(READ_ONCE(pddgpu_reclaim_min_age_ms), 0) * NSEC_PER_MSEC;
+	u64 now = ktime_get_ns();
+	struct ttm_resource_cursor cursor;
+	struct pddgpu_bo *victim = NULL;
+	struct ttm_resource *res;
+
+	spin_lock(&bdev->lru_lock);
+	ttm_resource_cursor_init(&cursor, man);
+	ttm_resource_manager_for_each_res(&cursor, res) {
+		struct ttm_buffer_object *tbo = res->bo;
+		struct pddgpu_bo *bo;
+
+		if (!tbo || !pddgpu_bo_is_pddgpu_bo(tbo) || tbo->pin_count ||
+		    tbo->priority >= PDDGPU_BO_PRIORITY_CRITICAL)
+			continue;
+
+		/* 最近用过或处于抖动回退窗口内的BO不算冷 */
+		bo = to_pddgpu_bo(tbo);
+		if (now - READ_ONCE(bo->last_use_ns) < min_age ||
+		    pddgpu_thrash_bo_held(bo))
+			continue;
+
+		if (!dma_resv_trylock(tbo->base.resv))
+			continue;
+
+		/* GPU仍在使用的BO留给同步驱逐处理，后台回收从不等待 */
+		if (tbo->resource != res ||
+		    !dma_resv_test_signaled(tbo->base.resv, DMA_RESV_USAGE_BOOKKEEP) ||
+		    !ttm_bo_get_unless_zero(tbo)) {
+			dma_resv_unlock(tbo->base.resv);
+			continue;
+		}
+
+		victim = bo;
+		break;
+	}
+	ttm_resource_cursor_fini(&cursor);
+	spin_unlock(&bdev->lru_lock);
+
+	return victim;
+}
+
+/* 回收一个域直到高水位或本轮配额用完，VRAM移到GTT，GTT移到系统内存 */
+static void pddgpu_reclaim_domain(struct pddgpu_device *pdev, u32 mem_type,
+                                  u64 *budget)
+{
+	struct pddgpu_reclaim *reclaim = &pdev->mman.reclaim;
+	struct pddgpu_move_ctx mctx = {
+		.base = { .interruptible = false, .no_wait_gpu = true },
+	};
+	struct ttm_place place = {
+		.mem_type = mem_type == TTM_PL_VRAM ? TTM_PL_TT : TTM_PL_SYSTEM,
+	};
+	struct ttm_placement placement = {
+		.num_placement = 1,
+		.placement = &place,
+	};
+	struct ttm_resource_manager *man;
+	struct pddgpu_bo *bo;
+	u64 high, size;
+	int r;
+
+	man = pddgpu_reclaim_manager(pdev, mem_type);
+	if (!man)
+		return;
+
+	high = pddgpu_reclaim_mark(man, READ_ONCE(pddgpu_reclaim_high_pct));
+
+	pddgpu_move_ctx_begin(pdev, &mctx, PDDGPU_MOVE_PRIO_BACKGROUND);
+	while (*budget && pddgpu_reclaim_free(man) < high) {
+		bo = pddgpu_reclaim_pick(pdev, man);
+		if (!bo)
+			break;
+
+		/* DONTNEED的BO直接丢弃后备存储，不占用回收带宽 */
+		size = bo->tbo.base.size;
+		if (bo->madv == PDDGPU_MADV_DONTNEED)
+			r = pddgpu_ttm_purge(bo, &mctx.base);
+		else
+			r = ttm_bo_validate(&bo->tbo, &placement, &mctx.base);
+		dma_resv_unlock(bo->tbo.base.resv);
+		ttm_bo_put(&bo->tbo);
+
+		if (r) {
+			PDDGPU_DEBUG("Background reclaim from mem_type %u failed: %d\n",
+			             mem_type, r);
+			break;
+		}
+
+		atomic64_inc(&reclaim->bos_evicted);
+		atomic64_add(size, mem_type == TTM_PL_VRAM ? &reclaim->vram_bytes :
+		                                             &reclaim->gtt_bytes);
+		*budget -= min(*budget, size);
+	}
+	pddgpu_move_ctx_end(pdev, &mctx);
+}
+
+static bool pddgpu_reclaim_below(struct pddgpu_device *pdev, u32 mem_type, int pct)
+{
+	struct ttm_resource_manager *man = pddgpu_reclaim_manager(pdev, mem_type);
+
+	return man && pddgpu_reclaim_free(man) < pddgpu_reclaim_mark(man, pct);
+}
+
+/* 后台回收工作函数 */
+static void pddgpu_reclaim_work(struct work_struct *work)
+{
+	struct pddgpu_reclaim *reclaim =
+		container_of(to_delayed_work(work), struct pddgpu_reclaim, work);
+	struct pddgpu_device *pdev =
+		container_of(reclaim, struct pddgpu_device, mman.reclaim);
+	int rate_mb = READ_ONCE(pddgpu_reclaim_rate_mb);
+	int high = READ_ONCE(pddgpu_reclaim_high_pct);
+	u64 budget;
+
+	if (rate_mb <= 0)
+		return;
+
+	budget = (u64)rate_mb << 20;
+	atomic64_inc(&reclaim->passes);
+
+	pddgpu_reclaim_domain(pdev, TTM_PL_VRAM, &budget);
+	pddgpu_reclaim_domain(pdev, TTM_PL_TT, &budget);
+
+	/* 配额用完仍未到高水位，按回收速率稍后继续；没有冷BO可回收则等待下次唤醒 */
+	if (!budget && (pddgpu_reclaim_below(pdev, TTM_PL_VRAM, high) ||
+	                pddgpu_reclaim_below(pdev, TTM_PL_TT, high)))
+		queue_delayed_work(reclaim->wq, &reclaim->work,
+		                   msecs_to_jiffies(max(READ_ONCE(pddgpu_reclaim_interval_ms), 1)));
+}
+
+/* 分配后检查水位 */
+void pddgpu_reclaim_check(struct pddgpu_device *pdev, u32 mem_type)
+{
+	struct pddgpu_reclaim *reclaim = &pdev->mman.reclaim;
+	int low = READ_ONCE(pddgpu_reclaim_low_pct);
+
+	if (!reclaim->wq || low <= 0 || !pddgpu_reclaim_below(pdev, mem_type, low))
+		return;
+
+	/* 已在排队时不会重复唤醒 */
+	if (queue_delayed_work(reclaim->wq, &reclaim->work, 0))
+		atomic64_inc(&reclaim->wakeups);
+}
+
+/* 初始化后台回收 */
+int pddgpu_reclaim_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_reclaim *reclaim = &pdev->mman.reclaim;
+
+	PDDGPU_DEBUG("Initializing background reclaim\n");
+
+	reclaim->wq = alloc_ordered_workqueue("pddgpu-reclaim", WQ_MEM_RECLAIM);
+	if (!reclaim->wq)
+		return -ENOMEM;
+
+	INIT_DELAYED_WORK(&reclaim->work, pddgpu_reclaim_work);
+
+	atomic64_set(&reclaim->wakeups, 0);
+	atomic64_set(&reclaim->passes, 0);
+	atomic64_set(&reclaim->bos_evicted, 0);
+	atomic64_set(&reclaim->vram_bytes, 0);
+	atomic64_set(&reclaim->gtt_bytes, 0);
+
+	return 0;
+}
+
+/* 清理后台回收 */
+void pddgpu_reclaim_fini(struct pddgpu_device *pdev)
+{
+	struct pddgpu_reclaim *reclaim = &pdev->mman.reclaim;
+
+	if (!reclaim->wq)
+		return;
+
+	PDDGPU_DEBUG("Finalizing background reclaim\n");
+
+	cancel_delayed_work_sync(&reclaim->work);
+	destroy_workqueue(reclaim->wq);
+	reclaim->wq = NULL;
+}
+
+/* 调试打印 */
+void pddgpu_reclaim_debug_print(struct pddgpu_device *pdev,
+                                struct drm_printer *p)
+{
+	struct pddgpu_reclaim *reclaim = &pdev->mman.reclaim;
+	struct ttm_resource_manager *man;
+	u32 mem_type;
+
+	drm_printf(p, "Background Reclaim Debug Info:\n");
+	drm_printf(p, "  Watermarks: Low=%d%%, High=%d%%, Rate=%d MB/%d ms\n",
+	           pddgpu_reclaim_low_pct, pddgpu_reclaim_high_pct,
+	           pddgpu_reclaim_rate_mb, pddgpu_reclaim_interval_ms);
+
+	for (mem_type = TTM_PL_TT; mem_type <= TTM_PL_VRAM; mem_type++) {
+		man = pddgpu_reclaim_manager(pdev, mem_type);
+		if (!man)
+			continue;
+
+		drm_printf(p, "  %s: Free=%llu MB, Low=%llu MB, High=%llu MB\n",
+		           mem_type == TTM_PL_VRAM ? "VRAM" : "GTT",
+		           pddgpu_reclaim_free(man) >> 20,
+		           pddgpu_reclaim_mark(man, pddgpu_reclaim_low_pct) >> 20,
+		           pddgpu_reclaim_mark(man, pddgpu_reclaim_high_pct) >> 20);
+	}
+
+	drm_printf(p, "  Wakeups=%llu, Passes=%llu, BOs=%llu, VRAM=%llu MB, GTT=%llu MB\n",
+	           atomic64_read(&reclaim->wakeups), atomic64_read(&reclaim->passes),
+	           atomic64_read(&reclaim->bos_evicted),
+	           atomic64_read(&reclaim->vram_bytes) >> 20,
+	           atomic64_read(&reclaim->gtt_bytes) >> 20);
+}
@@ -0,0 +1,264 @@
+/*
+ * PDDGPU 系统内存BO换出实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/shrinker.h>
+#include <linux/workqueue.h>
+#include <linux/dma-resv.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_device.h>
+#include <drm/ttm/ttm_resource.h>
+#include <drm/ttm/ttm_tt.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_swap.h"
+#include "pddgpu_object.h"
+
+/* 从系统内存LRU头挑选一个可换出的冷BO，返回时已持有其预留锁和引用 */
+static struct pddgpu_bo *pddgpu_swap_pick(struct pddgpu_device *pdev, u64 min_age)
+{
+	struct ttm_device *bdev = &pdev->mman.bdev;
+	struct ttm_resource_manager *man = ttm_manager_type(bdev, TTM_PL_SYSTEM);
+	u64 now = ktime_get_ns();
+	struct ttm_resource_cursor cursor;
+	struct pddgpu_bo *victim = NULL;
+	struct ttm_resource *res;
+
+	spin_lock(&bdev->lru_lock);
+	ttm_resource_cursor_init(&cursor, man);
+	ttm_resource_manager_for_each_res(&cursor, res) {
+		struct ttm_buffer_object *tbo = res->bo;
+		struct pddgpu_bo *bo;
+
+		if (!tbo || !pddgpu_bo_is_pddgpu_bo(tbo) || tbo->pin_count ||
+		    tbo->type != ttm_bo_type_device ||
+		    tbo->priority >= PDDGPU_BO_PRIORITY_CRITICAL ||
+		    !pddgpu_ttm_swappable(tbo))
+			continue;
+
+		/* 最近用过、处于抖动回退窗口内或有常驻内核映射的BO不换出，DONTNEED的BO直接丢弃 */
+		bo = to_pddgpu_bo(tbo);
+		if (READ_ONCE(bo->kptr) ||
+		    (READ_ONCE(bo->madv) != PDDGPU_MADV_DONTNEED &&
+		     (now - READ_ONCE(bo->last_use_ns) < min_age ||
+		      pddgpu_thrash_bo_held(bo))))
+			continue;
+
+		if (!dma_resv_trylock(tbo->base.resv))
+			continue;
+
+		/* 收缩器从不等待GPU */
+		if (tbo->resource != res ||
+		    !dma_resv_test_signaled(tbo->base.resv, DMA_RESV_USAGE_BOOKKEEP) ||
+		    !ttm_bo_get_unless_zero(tbo)) {
+			dma_resv_unlock(tbo->base.resv);
+			continue;
+		}
+
+		victim = bo;
+		break;
+	}
+	ttm_resource_cursor_fini(&cursor);
+	spin_unlock(&bdev->lru_lock);
+
+	return victim;
+}
+
+/* 换出冷BO直到释放nr_pages页，返回释放的页数 */
+static unsigned long pddgpu_swap_run(struct pddgpu_device *pdev,
+                                     unsigned long nr_pages, gfp_t gfp)
+{
+	struct ttm_operation_ctx ctx = { .interruptible = false, .no_wait_gpu = true };
+	int min_age_ms = READ_ONCE(pddgpu_swap_min_age_ms);
+	unsigned long freed = 0;
+	struct pddgpu_bo *bo;
+	pgoff_t num_pages;
+	int r;
+
+	if (min_age_ms < 0)
+		return 0;
+
+	while (freed < nr_pages) {
+		bo = pddgpu_swap_pick(pdev, (u64)min_age_ms * NSEC_PER_MSEC);
+		if (!bo)
+			break;
+
+		num_pages = PFN_UP(bo->tbo.base.size);
+		if (bo->madv == PDDGPU_MADV_DONTNEED)
+			r = pddgpu_ttm_purge(bo, &ctx);
+		else
+			r = pddgpu_ttm_swapout(bo, gfp);
+		dma_resv_unlock(bo->tbo.base.resv);
+		ttm_bo_put(&bo->tbo);
+
+		if (r) {
+			PDDGPU_DEBUG("BO swapout failed: %d\n", r);
+			break;
+		}
+
+		freed += num_pages;
+	}
+
+	return freed;
+}
+
+/* 后台换出工作函数，处理收缩器推迟的页数 */
+static void pddgpu_swap_work(struct work_struct *work)
+{
+	struct pddgpu_swap *swap = container_of(work, struct pddgpu_swap, work);
+	struct pddgpu_device *pdev = container_of(swap, struct pddgpu_device, mman.swap);
+	unsigned long nr_pages = atomic_long_xchg(&swap->deferred_pages, 0);
+
+	if (nr_pages)
+		pddgpu_swap_run(pdev, nr_pages, GFP_KERNEL | __GFP_NOWARN);
+}
+
+/* 收缩器：统计系统内存域中尚未换出的页数 */
+static unsigned long pddgpu_swap_shrinker_count(struct shrinker *shrink,
+                                                struct shrink_control *sc)
+{
+	struct pddgpu_device *pdev = shrink->private_data;
+	struct ttm_resource_manager *man =
+		ttm_manager_type(&pdev->mman.bdev, TTM_PL_SYSTEM);
+	unsigned long resident, swapped;
+
+	if (READ_ONCE(pddgpu_swap_min_age_ms) < 0)
+		return 0;
+
+	/* 已换出和已压缩的BO仍占着系统内存域的资源，但不再占用页面 */
+	resident = ttm_resource_manager_usage(man) >> PAGE_SHIFT;
+	swapped = atomic_long_read(&pdev->mman.swap.swapped_pages) +
+	          (atomic64_read(&pdev->mman.compress.resident_bytes) >> PAGE_SHIFT);
+
+	return resident > swapped ? resident - swapped : SHRINK_EMPTY;
+}
+
+/*
+ * 收缩器：换出冷BO。ttm_tt_swapout()要分配shmem页面，不允许进入文件系统
+ * 的回收只记下目标页数，交给后台回收队列异步完成。
+ */
+static unsigned long pddgpu_swap_shrinker_scan(struct shrinker *shrink,
+                                               struct shrink_control *sc)
+{
+	struct pddgpu_device *pdev = shrink->private_data;
+	struct pddgpu_swap *swap = &pdev->mman.swap;
+	unsigned long freed;
+
+	if (!(sc->gfp_mask & __GFP_FS)) {
+		atomic_long_add(sc->nr_to_scan, &swap->deferred_pages);
+		if (queue_work(pdev->mman.reclaim.wq, &swap->work))
+			atomic64_inc(&swap->deferred);
+		return SHRINK_STOP;
+	}
+
+	freed = pddgpu_swap_run(pdev, sc->nr_to_scan,
+	                        GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+/* 记录一次换入 */
+void pddgpu_swap_note_in(struct pddgpu_device *pdev, pgoff_t num_pages, s64 us)
+{
+	struct pddgpu_swap *swap = &pdev->mman.swap;
+
+	atomic_long_sub(num_pages, &swap->swapped_pages);
+	atomic64_inc(&swap->swapins);
+	atomic64_add((u64)num_pages << PAGE_SHIFT, &swap->swapin_bytes);
+	atomic64_add(max_t(s64, us, 0), &swap->swapin_us);
+}
+
+/* 换出的BO未换入就被释放 */
+void pddgpu_swap_note_released(struct pddgpu_device *pdev, pgoff_t num_pages)
+{
+	atomic_long_sub(num_pages, &pdev->mman.swap.swapped_pages);
+}
+
+/* 记录一次换出，由pddgpu_ttm_swapout()调用 */
+void pddgpu_swap_note_out(struct pddgpu_device *pdev, pgoff_t num_pages, s64 us)
+{
+	struct pddgpu_swap *swap = &pdev->mman.swap;
+
+	atomic_long_add(num_pages, &swap->swapped_pages);
+	atomic64_inc(&swap->swapouts);
+	atomic64_add((u64)num_pages << PAGE_SHIFT, &swap->swapout_bytes);
+	atomic64_add(max_t(s64, us, 0), &swap->swapout_us);
+}
+
+/* 初始化换出 */
+int pddgpu_swap_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_swap *swap = &pdev->mman.swap;
+
+	PDDGPU_DEBUG("Initializing BO swap\n");
+
+	INIT_WORK(&swap->work, pddgpu_swap_work);
+	atomic_long_set(&swap->deferred_pages, 0);
+	atomic_long_set(&swap->swapped_pages, 0);
+
+	atomic64_set(&swap->swapouts, 0);
+	atomic64_set(&swap->swapout_bytes, 0);
+	atomic64_set(&swap->swapout_us, 0);
+	atomic64_set(&swap->swapins, 0);
+	atomic64_set(&swap->swapin_bytes, 0);
+	atomic64_set(&swap->swapin_us, 0);
+	atomic64_set(&swap->deferred, 0);
+
+	swap->shrinker = shrinker_alloc(0, "drm-pddgpu_swap");
+	if (!swap->shrinker) {
+		PDDGPU_ERROR("Failed to allocate swap shrinker\n");
+		return -ENOMEM;
+	}
+
+	swap->shrinker->count_objects = pddgpu_swap_shrinker_count;
+	swap->shrinker->scan_objects = pddgpu_swap_shrinker_scan;
+	swap->shrinker->private_data = pdev;
+	/* 换出要复制页面，代价高于丢弃缓存 */
+	swap->shrinker->seeks = DEFAULT_SEEKS * 4;
+	shrinker_register(swap->shrinker);
+
+	return 0;
+}
+
+/* 清理换出，换出在shmem中的页面随BO释放 */
+void pddgpu_swap_fini(struct pddgpu_device *pdev)
+{
+	struct pddgpu_swap *swap = &pdev->mman.swap;
+
+	PDDGPU_DEBUG("Finalizing BO swap\n");
+
+	if (swap->shrinker) {
+		shrinker_free(swap->shrinker);
+		swap->shrinker = NULL;
+	}
+
+	cancel_work_sync(&swap->work);
+}
+
+/* 调试打印 */
+void pddgpu_swap_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p)
+{
+	struct pddgpu_swap *swap = &pdev->mman.swap;
+	u64 swapouts = atomic64_read(&swap->swapouts);
+	u64 swapins = atomic64_read(&swap->swapins);
+
+	drm_printf(p, "BO Swap Debug Info:\n");
+	drm_printf(p, "  Min_Age=%d ms, Swapped=%lu MB, Deferred_Scans=%llu\n",
+	           pddgpu_swap_min_age_ms,
+	           atomic_long_read(&swap->swapped_pages) >> (20 - PAGE_SHIFT),
+	           atomic64_read(&swap->deferred));
+	drm_printf(p, "  Swap_Out: Count=%llu, Bytes=%llu MB, Avg_Latency=%llu us\n",
+	           swapouts, atomic64_read(&swap->swapout_bytes) >> 20,
+	           swapouts ? div64_u64(atomic64_read(&swap->swapout_us), swapouts) : 0);
+	drm_printf(p, "  Swap_In: Count=%llu, Bytes=%llu MB, Avg_Latency=%llu us\n",
+	           swapins, atomic64_read(&swap->swapin_bytes) >> 20,
+	           swapins ? div64_u64(atomic64_read(&swap->swapin_us), swapins) : 0);
+}
@@ -0,0 +1,109 @@
+/*
+ * PDDGPU BO抖动检测实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_placement.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_client.h"
+#include "include/pddgpu_thrash.h"
+#include "pddgpu_object.h"
+
+/* 初始化BO移动历史 */
+void pddgpu_thrash_bo_init(struct pddgpu_bo *bo)
+{
+	memset(&bo->thrash, 0, sizeof(bo->thrash));
+	bo->thrash.prev_mem_type = TTM_NUM_MEM_TYPES;
+}
+
+/*
+ * 记录一次移动。BO在窗口内反复回到刚离开的域即视为往返，
+ * 往返次数达到阈值后进入回退窗口，期间保持在当前域；
+ * 连续多次被判定为抖动的BO被永久移出VRAM。
+ */
+void pddgpu_thrash_note_move(struct pddgpu_bo *bo, u32 old_mem_type,
+                             u32 new_mem_type)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_bo_thrash *t = &bo->thrash;
+	struct pddgpu_fpriv *owner = bo->owner;
+	u64 window = (u64)max(READ_ONCE(pddgpu_thrash_window_ms), 0) * NSEC_PER_MSEC;
+	int threshold = READ_ONCE(pddgpu_thrash_flips);
+	int demote_strikes = READ_ONCE(pddgpu_thrash_demote_strikes);
+	u64 now = ktime_get_ns();
+	u64 backoff;
+
+	dma_resv_assert_held(bo->tbo.base.resv);
+
+	if (old_mem_type == new_mem_type || threshold <= 0)
+		return;
+
+	/* 窗口过期后重新计数，平静足够久则清除历史判定 */
+	if (now - t->window_start > window) {
+		if (now > t->hold_until + window)
+			t->strikes = 0;
+		t->window_start = now;
+		t->flips = 0;
+	}
+
+	if (new_mem_type == t->prev_mem_type) {
+		t->flips++;
+		atomic64_inc(&pdev->memory_stats.thrash.moves);
+		atomic64_add(bo->tbo.base.size, &pdev->memory_stats.thrash.bytes);
+		if (owner) {
+			atomic64_inc(&owner->thrash_moves);
+			atomic64_add(bo->tbo.base.size, &owner->thrash_bytes);
+		}
+	}
+	t->prev_mem_type = old_mem_type;
+
+	if (t->flips < threshold)
+		return;
+
+	t->strikes++;
+	t->flips = 0;
+	t->window_start = now;
+
+	backoff = (u64)max(READ_ONCE(pddgpu_thrash_backoff_ms), 0) * NSEC_PER_MSEC;
+	backoff <<= min_t(u32, t->strikes - 1, PDDGPU_THRASH_MAX_BACKOFF_SHIFT);
+	t->hold_until = now + backoff;
+
+	atomic64_inc(&pdev->memory_stats.thrash.holds);
+	if (owner)
+		atomic64_inc(&owner->thrash_holds);
+
+	PDDGPU_DEBUG("BO %p thrashing between mem_type %u and %u, holding for %llu ms\n",
+	             bo, old_mem_type, new_mem_type, div_u64(backoff, NSEC_PER_MSEC));
+
+	/* 降级后放置时只要还有其他域可选就不再使用VRAM */
+	if (demote_strikes > 0 && t->strikes >= demote_strikes && !t->demoted) {
+		t->demoted = true;
+		atomic64_inc(&pdev->memory_stats.thrash.demotions);
+		if (owner)
+			atomic64_inc(&owner->thrash_demotions);
+
+		PDDGPU_DEBUG("BO %p demoted out of VRAM\n", bo);
+	}
+}
+
+/* BO是否处于回退窗口内 */
+bool pddgpu_thrash_bo_held(struct pddgpu_bo *bo)
+{
+	return ktime_get_ns() < READ_ONCE(bo->thrash.hold_until);
+}
+
+/* 放置时是否应避开VRAM：已降级，或在回退窗口内且当前不在VRAM */
+bool pddgpu_thrash_avoid_vram(struct pddgpu_bo *bo)
+{
+	if (bo->thrash.demoted)
+		return true;
+
+	return bo->tbo.resource && bo->tbo.resource->mem_type != TTM_PL_VRAM &&
+	       pddgpu_thrash_bo_held(bo);
+}
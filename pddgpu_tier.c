@@ -0,0 +1,317 @@
+/*
+ * PDDGPU VRAM/GTT冷热分层实现
+ *
+ * Copyright (C) 2024 PDDGPU Project
+ */
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
+#include <linux/dma-resv.h>
+
+#include <drm/ttm/ttm_bo.h>
+#include <drm/ttm/ttm_device.h>
+#include <drm/ttm/ttm_placement.h>
+#include <drm/ttm/ttm_resource.h>
+#include <drm/drm_print.h>
+
+#include "include/pddgpu_drv.h"
+#include "include/pddgpu_tier.h"
+#include "pddgpu_object.h"
+
+static inline u64 pddgpu_tier_half_life_ns(void)
+{
+	return (u64)max(READ_ONCE(pddgpu_tier_half_life_ms), 1) * NSEC_PER_MSEC;
+}
+
+static u32 pddgpu_tier_heat_at(struct pddgpu_bo *bo, u64 now)
+{
+	u64 stamp = READ_ONCE(bo->heat_stamp);
+	u64 halvings = now > stamp ? div64_u64(now - stamp, pddgpu_tier_half_life_ns()) : 0;
+
+	return halvings >= 32 ? 0 : READ_ONCE(bo->heat) >> halvings;
+}
+
+/* 当前热度：访问次数按半衰期指数衰减 */
+u32 pddgpu_tier_heat(struct pddgpu_bo *bo)
+{
+	return pddgpu_tier_heat_at(bo, ktime_get_ns());
+}
+
+/* 记录一次访问（CPU缺页、kmap/vmap、放置） */
+void pddgpu_tier_note_access(struct pddgpu_bo *bo)
+{
+	u64 now = ktime_get_ns();
+	u32 heat = pddgpu_tier_heat_at(bo, now);
+
+	WRITE_ONCE(bo->heat, min_t(u32, heat + 1, PDDGPU_TIER_MAX_HEAT));
+	WRITE_ONCE(bo->heat_stamp, now);
+	WRITE_ONCE(bo->last_use_ns, now);
+}
+
+static u64 pddgpu_tier_vram_free(struct pddgpu_device *pdev)
+{
+	struct ttm_resource_manager *man = ttm_manager_type(&pdev->mman.bdev, TTM_PL_VRAM);
+	u64 used = ttm_resource_manager_usage(man);
+
+	return man->size > used ? man->size - used : 0;
+}
+
+/* 迁移后VRAM空闲量仍须高于后台回收的高水位，避免与回收互相拉扯 */
+static u64 pddgpu_tier_vram_reserve(struct pddgpu_device *pdev)
+{
+	struct ttm_resource_manager *man = ttm_manager_type(&pdev->mman.bdev, TTM_PL_VRAM);
+
+	return div_u64(man->size * clamp(READ_ONCE(pddgpu_reclaim_high_pct), 0, 100), 100);
+}
+
+/* 按每秒迁移带宽补充配额，最多积攒一秒 */
+static void pddgpu_tier_refill(struct pddgpu_tier *tier)
+{
+	u64 rate = (u64)max(READ_ONCE(pddgpu_tier_migrate_mb_per_sec), 0) << 20;
+	u64 now = ktime_get_ns();
+	u64 elapsed = min_t(u64, now - tier->budget_stamp, NSEC_PER_SEC);
+
+	tier->budget_bytes = min(tier->budget_bytes +
+	                         div64_u64(rate * elapsed, NSEC_PER_SEC), rate);
+	tier->budget_stamp = now;
+}
+
+/*
+ * 在LRU前段挑选候选：promote时找GTT中最热的回退BO，
+ * 否则找VRAM中比limit冷得多的BO。返回时已持有预留锁和引用。
+ */
+static struct pddgpu_bo *pddgpu_tier_pick(struct pddgpu_device *pdev, bool promote,
+                                          u32 limit)
+{
+	struct ttm_device *bdev = &pdev->mman.bdev;
+	struct ttm_resource_manager *man;
+	struct ttm_resource_cursor cursor;
+	struct pddgpu_bo *best = NULL;
+	struct ttm_resource *res;
+	int depth = PDDGPU_TIER_SCAN_DEPTH;
+	u32 best_heat = 0;
+
+	man = ttm_manager_type(bdev, promote ? TTM_PL_TT : TTM_PL_VRAM);
+
+	spin_lock(&bdev->lru_lock);
+	ttm_resource_cursor_init(&cursor, man);
+	ttm_resource_manager_for_each_res(&cursor, res) {
+		struct ttm_buffer_object *tbo = res->bo;
+		struct pddgpu_bo *bo;
+		u32 heat;
+
+		if (depth-- <= 0)
+			break;
+
+		if (!tbo || !pddgpu_bo_is_pddgpu_bo(tbo) || tbo->pin_count)
+			continue;
+
+		bo = to_pddgpu_bo(tbo);
+		if (pddgpu_thrash_bo_held(bo) || bo->thrash.demoted)
+			continue;
+
+		heat = pddgpu_tier_heat(bo);
+		if (promote) {
+			/* 只有首选VRAM、因空间不足落在GTT的BO才需要提升 */
+			if (!(bo->preferred_domains & PDDGPU_GEM_DOMAIN_VRAM) ||
+			    heat < limit || (best && heat <= best_heat))
+				continue;
+		} else {
+			if (tbo->priority >= PDDGPU_BO_PRIORITY_CRITICAL ||
+			    heat * 2 >= limit || (best && heat >= best_heat))
+				continue;
+		}
+
+		/* 已被锁住的BO正在使用或迁移中 */
+		if (dma_resv_is_locked(tbo->base.resv) ||
+		    !dma_resv_test_signaled(tbo->base.resv, DMA_RESV_USAGE_BOOKKEEP))
+			continue;
+
+		best = bo;
+		best_heat = heat;
+	}
+
+	/* 持有lru_lock期间资源仍在LRU上，BO不会被释放 */
+	if (best) {
+		if (!dma_resv_trylock(best->tbo.base.resv)) {
+			best = NULL;
+		} else if (!best->tbo.resource ||
+		           best->tbo.resource->mem_type != man->mem_type ||
+		           !ttm_bo_get_unless_zero(&best->tbo)) {
+			dma_resv_unlock(best->tbo.base.resv);
+			best = NULL;
+		}
+	}
+	ttm_resource_cursor_fini(&cursor);
+	spin_unlock(&bdev->lru_lock);
+
+	return best;
+}
+
+/* 迁移BO到目标域，调用者持有预留锁；后台迁移只计入设备移动配额 */
+static int pddgpu_tier_move(struct pddgpu_bo *bo, u32 mem_type)
+{
+	struct pddgpu_device *pdev = pddgpu_ttm_pdev(bo->tbo.bdev);
+	struct pddgpu_move_ctx mctx = {
+		.base = { .interruptible = false, .no_wait_gpu = true },
+	};
+	struct ttm_place place = { .mem_type = mem_type };
+	struct ttm_placement placement = {
+		.num_placement = 1,
+		.placement = &place,
+	};
+	int r;
+
+	if (mem_type == TTM_PL_VRAM && bo->flags & PDDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED)
+		place.lpfn = pdev->gmc.visible_vram_size >> PAGE_SHIFT;
+
+	pddgpu_move_ctx_begin(pdev, &mctx, PDDGPU_MOVE_PRIO_BACKGROUND);
+	r = ttm_bo_validate(&bo->tbo, &placement, &mctx.base);
+	pddgpu_move_ctx_end(pdev, &mctx);
+	pddgpu_cs_report_moved_bytes(pdev, NULL, mctx.base.bytes_moved,
+	                             place.lpfn ? mctx.base.bytes_moved : 0);
+
+	return r;
+}
+
+static void pddgpu_tier_release(struct pddgpu_bo *bo)
+{
+	dma_resv_unlock(bo->tbo.base.resv);
+	ttm_bo_put(&bo->tbo);
+}
+
+/* 降级比hot冷得多的VRAM BO，直到能放下size字节 */
+static bool pddgpu_tier_make_room(struct pddgpu_device *pdev, u64 size, u32 hot)
+{
+	struct pddgpu_tier *tier = &pdev->mman.tier;
+	struct pddgpu_bo *cold;
+	u64 cold_size;
+
+	while (pddgpu_tier_vram_free(pdev) < size + pddgpu_tier_vram_reserve(pdev)) {
+		cold = pddgpu_tier_pick(pdev, false, hot);
+		if (!cold)
+			return false;
+
+		cold_size = cold->tbo.base.size;
+		if (tier->budget_bytes < size + cold_size) {
+			pddgpu_tier_release(cold);
+			atomic64_inc(&tier->budget_exhausted);
+			return false;
+		}
+
+		if (pddgpu_tier_move(cold, TTM_PL_TT)) {
+			pddgpu_tier_release(cold);
+			return false;
+		}
+		pddgpu_tier_release(cold);
+
+		tier->budget_bytes -= cold_size;
+		atomic64_inc(&tier->demotions);
+		atomic64_add(cold_size, &tier->demoted_bytes);
+	}
+
+	return true;
+}
+
+/* 分层工作函数：把热的GTT回退BO提升回VRAM */
+static void pddgpu_tier_work(struct work_struct *work)
+{
+	struct pddgpu_tier *tier =
+		container_of(to_delayed_work(work), struct pddgpu_tier, work);
+	struct pddgpu_device *pdev =
+		container_of(tier, struct pddgpu_device, mman.tier);
+	int interval = READ_ONCE(pddgpu_tier_interval_ms);
+	u32 hot = max(READ_ONCE(pddgpu_tier_hot_threshold), 1);
+	u64 max_bytes, max_vis_bytes;
+	struct pddgpu_bo *bo;
+	u64 size;
+	int i;
+
+	if (interval <= 0)
+		return;
+
+	pddgpu_tier_refill(tier);
+
+	for (i = 0; i < PDDGPU_TIER_MAX_MOVES_PER_PASS; i++) {
+		bo = pddgpu_tier_pick(pdev, true, hot);
+		if (!bo)
+			break;
+
+		/* 提升同样受设备移动配额约束，让出带宽给前台验证 */
+		size = bo->tbo.base.size;
+		pddgpu_cs_get_threshold_for_moves(pdev, NULL, &max_bytes, &max_vis_bytes);
+		if (tier->budget_bytes < size || max_bytes < size) {
+			pddgpu_tier_release(bo);
+			atomic64_inc(&tier->budget_exhausted);
+			break;
+		}
+
+		/* 空间不够时先降级冷BO腾出位置 */
+		if (!pddgpu_tier_make_room(pdev, size, pddgpu_tier_heat(bo)) ||
+		    pddgpu_tier_move(bo, TTM_PL_VRAM)) {
+			pddgpu_tier_release(bo);
+			break;
+		}
+
+		/* 恢复原放置，GTT重新作为回退域 */
+		pddgpu_bo_placement_from_domain(bo, bo->preferred_domains);
+		pddgpu_tier_release(bo);
+
+		tier->budget_bytes -= size;
+		atomic64_inc(&tier->promotions);
+		atomic64_add(size, &tier->promoted_bytes);
+	}
+
+	queue_delayed_work(pdev->mman.reclaim.wq, &tier->work,
+	                   msecs_to_jiffies(interval));
+}
+
+/* 初始化分层 */
+void pddgpu_tier_init(struct pddgpu_device *pdev)
+{
+	struct pddgpu_tier *tier = &pdev->mman.tier;
+
+	PDDGPU_DEBUG("Initializing memory tiering\n");
+
+	INIT_DELAYED_WORK(&tier->work, pddgpu_tier_work);
+	tier->budget_bytes = 0;
+	tier->budget_stamp = ktime_get_ns();
+
+	atomic64_set(&tier->promotions, 0);
+	atomic64_set(&tier->demotions, 0);
+	atomic64_set(&tier->promoted_bytes, 0);
+	atomic64_set(&tier->demoted_bytes, 0);
+	atomic64_set(&tier->budget_exhausted, 0);
+
+	if (pddgpu_tier_interval_ms > 0)
+		queue_delayed_work(pdev->mman.reclaim.wq, &tier->work,
+		                   msecs_to_jiffies(pddgpu_tier_interval_ms));
+}
+
+/* 清理分层 */
+void pddgpu_tier_fini(struct pddgpu_device *pdev)
+{
+	PDDGPU_DEBUG("Finalizing memory tiering\n");
+
+	cancel_delayed_work_sync(&pdev->mman.tier.work);
+}
+
+/* 调试打印 */
+void pddgpu_tier_debug_print(struct pddgpu_device *pdev,
+                             struct drm_printer *p)
+{
+	struct pddgpu_tier *tier = &pdev->mman.tier;
+
+	drm_printf(p, "Memory Tiering Debug Info:\n");
+	drm_printf(p, "  Interval=%d ms, Hot=%d, Half_Life=%d ms, Budget=%d MB/s\n",
+	           pddgpu_tier_interval_ms, pddgpu_tier_hot_threshold,
+	           pddgpu_tier_half_life_ms, pddgpu_tier_migrate_mb_per_sec);
+	drm_printf(p, "  Promotions=%llu (%llu MB), Demotions=%llu (%llu MB), Budget_Exhausted=%llu\n",
+	           atomic64_read(&tier->promotions),
+	           atomic64_read(&tier->promoted_bytes) >> 20,
+	           atomic64_read(&tier->demotions),
+	           atomic64_read(&tier->demoted_bytes) >> 20,
+	           atomic64_read(&tier->budget_exhausted));
+}
@@ -5,29 +5,62 @@
  */
 
 #include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/scatterlist.h>
 #include <linux/dma-resv.h>
 #include <linux/slab.h>
+#include <linux/bitmap.h>
+#include <linux/log2.h>
 #include <linux/mm.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 
+#include <drm/drm_drv.h>
 #include <drm/drm_gem.h>
+#include <drm/drm_vma_manager.h>
 #include <drm/ttm/ttm_bo.h>
 #include <drm/ttm/ttm_placement.h>
 #include <drm/ttm/ttm_resource.h>
 #include <drm/ttm/ttm_tt.h>
 
 #include "include/pddgpu_drv.h"
+#include "include/pddgpu_memory_stats.h"
 #include "pddgpu_object.h"
 
+static int pddgpu_ttm_io_mem_reserve(struct ttm_device *bdev,
+                                     struct ttm_resource *mem);
+static unsigned long pddgpu_ttm_io_mem_pfn(struct ttm_buffer_object *bo,
+                                           unsigned long page_offset);
+static int pddgpu_bo_move(struct ttm_buffer_object *bo, bool evict,
+                          struct ttm_operation_ctx *ctx,
+                          struct ttm_resource *new_mem,
+                          struct ttm_place *hop);
+static void pddgpu_evict_flags(struct ttm_buffer_object *bo,
+                               struct ttm_placement *placement);
+static bool pddgpu_bo_eviction_valuable(struct ttm_buffer_object *bo,
+                                        const struct ttm_place *place);
+static struct ttm_tt *pddgpu_ttm_tt_create(struct ttm_buffer_object *bo,
+                                           uint32_t page_flags);
+static void pddgpu_ttm_tt_destroy(struct ttm_device *bdev, struct ttm_tt *ttm);
+static int pddgpu_ttm_tt_populate(struct ttm_device *bdev, struct ttm_tt *ttm,
+                                  struct ttm_operation_ctx *ctx);
+static void pddgpu_ttm_tt_unpopulate(struct ttm_device *bdev, struct ttm_tt *ttm);
+static void pddgpu_bo_swap_notify(struct ttm_buffer_object *bo);
+
 /* TTM设备函数表 */
 static const struct ttm_device_funcs pddgpu_ttm_funcs = {
-	.ttm_tt_create = ttm_tt_create,           // 创建TTM页表对象
-	.ttm_tt_populate = ttm_tt_populate,       // 填充页表
-	.ttm_tt_unpopulate = ttm_tt_unpopulate,   // 释放页表
-	.ttm_tt_destroy = ttm_tt_destroy,         // 销毁页表对象
-	.eviction_valuable = ttm_bo_eviction_valuable, // 判断BO是否可被驱逐
+	.ttm_tt_create = pddgpu_ttm_tt_create,    // 创建TTM页表对象
+	.ttm_tt_populate = pddgpu_ttm_tt_populate,     // 从页面池填充页表
+	.ttm_tt_unpopulate = pddgpu_ttm_tt_unpopulate, // 页面放回页面池
+	.ttm_tt_destroy = pddgpu_ttm_tt_destroy,  // 销毁页表对象
+	.eviction_valuable = pddgpu_bo_eviction_valuable, // 判断BO是否可被驱逐
 	.eviction_fence = ttm_bo_eviction_fence,       // 获取BO驱逐同步栅栏
+	.evict_flags = pddgpu_evict_flags,             // 设置驱逐目标放置
+	.move = pddgpu_bo_move,                        // BO移动
+	.io_mem_reserve = pddgpu_ttm_io_mem_reserve,   // IO内存预留
+	.io_mem_pfn = pddgpu_ttm_io_mem_pfn,           // IO内存页帧号
 	.move_notify = NULL,
+	.swap_notify = pddgpu_bo_swap_notify,          // 全局换出前拆除内核映射
 	.delete_mem_notify = NULL,
 	.release_notify = NULL,
 };
@@ -67,6 +100,60 @@ int pddgpu_ttm_init(struct pddgpu_device *pdev)
 		goto err_gtt_fini;
 	}
 
+	/* 初始化驱逐代价评估 */
+	pddgpu_evict_init(pdev);
+
+	/* 初始化内核映射缓存 */
+	ret = pddgpu_kmap_cache_init(pdev);
+	if (ret) {
+		PDDGPU_ERROR("Failed to initialize kmap cache: %d\n", ret);
+		goto err_pools_fini;
+	}
+
+	/* 初始化移动配额 */
+	pddgpu_cs_mm_stats_init(pdev);
+
+	/* 初始化异步BO创建 */
+	ret = pddgpu_bo_create_async_init(pdev);
+	if (ret) {
+		PDDGPU_ERROR("Failed to initialize async BO creation: %d\n", ret);
+		goto err_kmap_cache_fini;
+	}
+
+	/* 初始化复制引擎 */
+	ret = pddgpu_copy_init(pdev);
+	if (ret) {
+		PDDGPU_ERROR("Failed to initialize copy engine: %d\n", ret);
+		goto err_async_fini;
+	}
+
+	/* 初始化后台回收 */
+	ret = pddgpu_reclaim_init(pdev);
+	if (ret) {
+		PDDGPU_ERROR("Failed to initialize background reclaim: %d\n", ret);
+		goto err_copy_fini;
+	}
+
+	/* 初始化冷热分层，运行在后台回收队列上 */
+	pddgpu_tier_init(pdev);
+
+	/* 初始化压缩，位于系统内存和换出之间，运行在后台回收队列上 */
+	pddgpu_compress_init(pdev);
+
+	/* 初始化换出，推迟的换出运行在后台回收队列上 */
+	ret = pddgpu_swap_init(pdev);
+	if (ret) {
+		PDDGPU_ERROR("Failed to initialize BO swap: %d\n", ret);
+		goto err_reclaim_fini;
+	}
+
+	/* 初始化预取，迁移经复制引擎执行 */
+	ret = pddgpu_prefetch_init(pdev);
+	if (ret) {
+		PDDGPU_ERROR("Failed to initialize BO prefetch: %d\n", ret);
+		goto err_swap_fini;
+	}
+
 	/* 启用缓冲区函数 */
 	pdev->mman.buffer_funcs_enabled = true;
 
@@ -74,6 +161,20 @@ int pddgpu_ttm_init(struct pddgpu_device *pdev)
 
 	return 0;
 
+err_swap_fini:
+	pddgpu_swap_fini(pdev);
+err_reclaim_fini:
+	pddgpu_compress_fini(pdev);
+	pddgpu_tier_fini(pdev);
+	pddgpu_reclaim_fini(pdev);
+err_copy_fini:
+	pddgpu_copy_fini(pdev);
+err_async_fini:
+	pddgpu_bo_create_async_fini(pdev);
+err_kmap_cache_fini:
+	pddgpu_kmap_cache_fini(pdev);
+err_pools_fini:
+	pddgpu_ttm_pools_fini(pdev);
 err_gtt_fini:
 	pddgpu_gtt_mgr_fini(pdev);
 err_vram_fini:
@@ -89,6 +190,27 @@ void pddgpu_ttm_fini(struct pddgpu_device *pdev)
 {
 	PDDGPU_DEBUG("Finalizing TTM\n");
 
+	/* 等待已提交的预取完成 */
+	pddgpu_prefetch_fini(pdev);
+
+	/* 注销换出收缩器并停止压缩，它们依赖后台回收队列 */
+	pddgpu_swap_fini(pdev);
+	pddgpu_compress_fini(pdev);
+
+	/* 停止冷热分层和后台回收 */
+	pddgpu_tier_fini(pdev);
+	pddgpu_reclaim_fini(pdev);
+
+	/* 等待并清理异步BO创建 */
+	pddgpu_bo_create_async_fini(pdev);
+
+	/* 等待复制引擎中的移动完成，之后的移动使用同步复制 */
+	pdev->mman.buffer_funcs_enabled = false;
+	pddgpu_copy_fini(pdev);
+
+	/* 清理内核映射缓存 */
+	pddgpu_kmap_cache_fini(pdev);
+
 	/* 清理内存池 */
 	pddgpu_ttm_pools_fini(pdev);
 
@@ -104,13 +226,16 @@ void pddgpu_ttm_fini(struct pddgpu_device *pdev)
 	PDDGPU_DEBUG("TTM finalized\n");
 }
 
-/* TTM内存池初始化 */
+/* TTM内存池初始化，按配置预热写合并页面 */
 int pddgpu_ttm_pools_init(struct pddgpu_device *pdev)
 {
+	int ret;
+
 	PDDGPU_DEBUG("Initializing TTM pools\n");
 
-	/* 这里应该初始化各种内存池 */
-	/* 由于这是模拟实现，我们只是记录日志 */
+	ret = pddgpu_pool_init(pdev);
+	if (ret)
+		return ret;
 
 	PDDGPU_DEBUG("TTM pools initialized\n");
 
@@ -122,12 +247,683 @@ void pddgpu_ttm_pools_fini(struct pddgpu_device *pdev)
 {
 	PDDGPU_DEBUG("Finalizing TTM pools\n");
 
-	/* 这里应该清理各种内存池 */
-	/* 由于这是模拟实现，我们只是记录日志 */
+	pddgpu_pool_fini(pdev);
 
 	PDDGPU_DEBUG("TTM pools finalized\n");
 }
 
+/* PDDGPU ttm_tt，解绑后页面和DMA地址保留在ttm_tt中 */
+struct pddgpu_ttm_tt {
+	struct ttm_tt ttm;
+	struct pddgpu_bo *abo;          /* 所属BO，其sg指向sgt */
+	struct sg_table *sgt;           /* 填充时建立的DMA映射 */
+	unsigned long *populated;       /* 稀疏ttm_tt中已填充的块，非稀疏时为NULL */
+	struct pddgpu_compressed *compressed;   /* 压缩保存的内容，此时页面已释放 */
+	bool swapped;                   /* 由pddgpu_ttm_swapout()换出，计入换出统计 */
+	bool release_pages;             /* 换出或压缩：下次unpopulate不经过页面池 */
+	unsigned int chunk_order;       /* 稀疏ttm_tt的填充粒度 */
+	pgoff_t num_populated;          /* 稀疏ttm_tt中已填充的页数 */
+	u64 offset;                     /* GART偏移 */
+	u32 num_frags;                  /* 绑定划分出的映射片段数 */
+	u32 num_huge_frags;             /* 其中对齐到2MB的片段数 */
+	bool bound;
+};
+
+static inline struct pddgpu_ttm_tt *to_pddgpu_ttm_tt(struct ttm_tt *ttm)
+{
+	return container_of(ttm, struct pddgpu_ttm_tt, ttm);
+}
+
+/* 稀疏ttm_tt的块数 */
+static inline unsigned long pddgpu_ttm_tt_num_chunks(struct pddgpu_ttm_tt *gtt)
+{
+	return DIV_ROUND_UP(gtt->ttm.num_pages, 1UL << gtt->chunk_order);
+}
+
+/* 按sparse_chunk_kb确定填充粒度，取2的幂，不超过一个大页块 */
+static int pddgpu_ttm_tt_init_sparse(struct pddgpu_device *pdev,
+                                     struct pddgpu_ttm_tt *gtt)
+{
+	unsigned long chunk_pages;
+
+	chunk_pages = ((unsigned long)max(READ_ONCE(pddgpu_sparse_chunk_kb), 0) << 10) >>
+	              PAGE_SHIFT;
+	chunk_pages = min(roundup_pow_of_two(max(chunk_pages, 1UL)),
+	                  PDDGPU_POOL_HUGE_PAGES);
+	gtt->chunk_order = ilog2(chunk_pages);
+
+	gtt->populated = bitmap_zalloc(pddgpu_ttm_tt_num_chunks(gtt), GFP_KERNEL);
+	if (!gtt->populated)
+		return -ENOMEM;
+
+	atomic64_add((u64)gtt->ttm.num_pages << PAGE_SHIFT,
+	             &pdev->memory_stats.sparse.size);
+
+	return 0;
+}
+
+/* BO创建标志选择的GTT页面缓存属性，没有标志时和TTM内部对象一样使用可缓存页面 */
+static enum ttm_caching pddgpu_ttm_tt_caching(struct pddgpu_bo *abo)
+{
+	if (!abo)
+		return ttm_cached;
+
+	if (abo->flags & PDDGPU_GEM_CREATE_CPU_GTT_USWC)
+		return ttm_write_combined;
+
+	if (abo->flags & PDDGPU_GEM_CREATE_CPU_GTT_UNCACHED)
+		return ttm_uncached;
+
+	return ttm_cached;
+}
+
+/*
+ * 创建ttm_tt，稀疏BO的页面在使用时才按块分配。缓存属性决定页面池中
+ * 的页面类型，ttm_io_prot()据此设置mmap和内核映射的页表属性。
+ */
+static struct ttm_tt *pddgpu_ttm_tt_create(struct ttm_buffer_object *bo,
+                                           uint32_t page_flags)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	struct pddgpu_ttm_tt *gtt;
+	bool sparse;
+
+	gtt = kzalloc(sizeof(*gtt), GFP_KERNEL);
+	if (!gtt)
+		return NULL;
+
+	if (pddgpu_bo_is_pddgpu_bo(bo))
+		gtt->abo = to_pddgpu_bo(bo);
+
+	/* 未填充的范围读为零，新分配的块也必须是零 */
+	sparse = gtt->abo && bo->type == ttm_bo_type_device &&
+		 (gtt->abo->flags & PDDGPU_GEM_CREATE_SPARSE);
+	if (sparse)
+		page_flags |= TTM_TT_FLAG_ZERO_ALLOC;
+
+	if (ttm_tt_init(&gtt->ttm, bo, page_flags, pddgpu_ttm_tt_caching(gtt->abo), 0)) {
+		kfree(gtt);
+		return NULL;
+	}
+
+	if (sparse && pddgpu_ttm_tt_init_sparse(pdev, gtt)) {
+		ttm_tt_fini(&gtt->ttm);
+		kfree(gtt);
+		return NULL;
+	}
+
+	return &gtt->ttm;
+}
+
+/*
+ * 以一个sg表映射全部页面。物理连续的页面合并成不超过
+ * PDDGPU_MAX_SG_SEGMENT_SIZE的段，整张表一次dma_map_sgtable，
+ * 有IOMMU时分配一段连续的IOVA，GART和复制引擎看到的是少数大段。
+ * 稀疏ttm_tt只有整体填充后才能映射，未填充的页没有可供设备访问的后备。
+ */
+static int pddgpu_ttm_tt_map_dma(struct pddgpu_device *pdev,
+                                 struct pddgpu_ttm_tt *gtt)
+{
+	struct device *dev = &pdev->pdev->dev;
+	struct ttm_tt *ttm = &gtt->ttm;
+	unsigned int max_segment;
+	struct sg_table *sgt;
+	int r;
+
+	if (WARN_ON_ONCE(gtt->populated && gtt->num_populated < ttm->num_pages))
+		return -EINVAL;
+
+	max_segment = min_t(unsigned long, PDDGPU_MAX_SG_SEGMENT_SIZE,
+	                    dma_get_max_seg_size(dev));
+
+	sgt = kmalloc(sizeof(*sgt), GFP_KERNEL);
+	if (!sgt)
+		return -ENOMEM;
+
+	r = sg_alloc_table_from_pages_segment(sgt, ttm->pages, ttm->num_pages, 0,
+	                                      (u64)ttm->num_pages << PAGE_SHIFT,
+	                                      max_segment, GFP_KERNEL);
+	if (r)
+		goto err_free;
+
+	r = dma_map_sgtable(dev, sgt, DMA_BIDIRECTIONAL, 0);
+	if (r) {
+		PDDGPU_ERROR("Failed to map ttm_tt for DMA: %d\n", r);
+		goto err_free_table;
+	}
+
+	gtt->sgt = sgt;
+	if (gtt->abo)
+		gtt->abo->sg = sgt;
+
+	atomic64_inc(&pdev->memory_stats.gart.dma_maps);
+	atomic64_add(sgt->nents, &pdev->memory_stats.gart.dma_segments);
+
+	return 0;
+
+err_free_table:
+	sg_free_table(sgt);
+err_free:
+	kfree(sgt);
+	return r;
+}
+
+/* 解除DMA映射，页面即将放回页面池 */
+static void pddgpu_ttm_tt_unmap_dma(struct pddgpu_device *pdev,
+                                    struct pddgpu_ttm_tt *gtt)
+{
+	if (!gtt->sgt)
+		return;
+
+	if (gtt->abo)
+		gtt->abo->sg = NULL;
+
+	dma_unmap_sgtable(&pdev->pdev->dev, gtt->sgt, DMA_BIDIRECTIONAL, 0);
+	sg_free_table(gtt->sgt);
+	kfree(gtt->sgt);
+	gtt->sgt = NULL;
+}
+
+/*
+ * 从设备页面池填充ttm_tt并建立DMA映射，导入的dma-buf由导出者提供页面
+ * 和映射。映射随页面保留到unpopulate，期间的移动和重新绑定都直接复用。
+ * 稀疏ttm_tt在这里不分配页面，由pddgpu_ttm_sparse_populate()按块填充，
+ * 但换入或解压时内容要整体复制回来，只能整体填充。
+ */
+static int pddgpu_ttm_tt_populate(struct ttm_device *bdev, struct ttm_tt *ttm,
+                                  struct ttm_operation_ctx *ctx)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(bdev);
+	struct pddgpu_ttm_tt *gtt = to_pddgpu_ttm_tt(ttm);
+	bool swapped = ttm->page_flags & TTM_TT_FLAG_SWAPPED;
+	bool restore = swapped || gtt->compressed;
+	ktime_t start;
+	int r;
+
+	if (ttm->page_flags & TTM_TT_FLAG_EXTERNAL)
+		return 0;
+
+	if (gtt->populated && !restore)
+		return 0;
+
+	r = pddgpu_pool_alloc(&pdev->mman.pool, ttm, ctx);
+	if (r)
+		return r;
+
+	/* 换入要在DMA映射之前完成，映射时才会为非一致性设备刷新缓存 */
+	if (swapped) {
+		start = ktime_get();
+		r = ttm_tt_swapin(ttm);
+		if (r) {
+			PDDGPU_ERROR("Failed to swap in ttm_tt: %d\n", r);
+			pddgpu_pool_free(&pdev->mman.pool, ttm);
+			return r;
+		}
+		if (gtt->swapped)
+			pddgpu_swap_note_in(pdev, ttm->num_pages,
+			                    ktime_us_delta(ktime_get(), start));
+		gtt->swapped = false;
+	} else if (gtt->compressed) {
+		r = pddgpu_decompress_pages(pdev, gtt->compressed, ttm->pages);
+		if (r) {
+			pddgpu_pool_free(&pdev->mman.pool, ttm);
+			return r;
+		}
+		pddgpu_compressed_free(pdev, gtt->compressed);
+		gtt->compressed = NULL;
+	}
+
+	/* 换入或解压后内容已经恢复，映射失败时留给绑定时重建 */
+	r = pddgpu_ttm_tt_map_dma(pdev, gtt);
+	if (r && !restore) {
+		pddgpu_pool_free(&pdev->mman.pool, ttm);
+		return r;
+	}
+
+	if (gtt->populated) {
+		bitmap_fill(gtt->populated, pddgpu_ttm_tt_num_chunks(gtt));
+		gtt->num_populated = ttm->num_pages;
+		atomic64_add((u64)ttm->num_pages << PAGE_SHIFT,
+		             &pdev->memory_stats.sparse.populated);
+	}
+
+	return 0;
+}
+
+/* 解除DMA映射，页面放回设备页面池，换出和压缩时直接还给系统 */
+static void pddgpu_ttm_tt_unpopulate(struct ttm_device *bdev, struct ttm_tt *ttm)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(bdev);
+	struct pddgpu_ttm_tt *gtt = to_pddgpu_ttm_tt(ttm);
+
+	if (ttm->page_flags & TTM_TT_FLAG_EXTERNAL)
+		return;
+
+	pddgpu_ttm_tt_unmap_dma(pdev, gtt);
+	if (gtt->release_pages)
+		pddgpu_pool_release(&pdev->mman.pool, ttm);
+	else
+		pddgpu_pool_free(&pdev->mman.pool, ttm);
+	gtt->release_pages = false;
+
+	if (gtt->populated) {
+		bitmap_zero(gtt->populated, pddgpu_ttm_tt_num_chunks(gtt));
+		atomic64_sub((u64)gtt->num_populated << PAGE_SHIFT,
+		             &pdev->memory_stats.sparse.populated);
+		gtt->num_populated = 0;
+	}
+}
+
+/*
+ * 填充稀疏ttm_tt中覆盖[start, start + num_pages)的块，调用者需持有BO预留锁。
+ * 非稀疏BO直接返回。其他进程的映射中这些块可能指向零页，需要失效。
+ * 按块填充只用于CPU访问的系统内存域，放入GTT前在绑定时整体填充，
+ * 绑定期间页面和DMA映射不再变化。
+ */
+int pddgpu_ttm_sparse_populate(struct ttm_buffer_object *bo, pgoff_t start,
+                               pgoff_t num_pages)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	struct ttm_operation_ctx ctx = { .interruptible = false };
+	struct pddgpu_ttm_tt *gtt;
+	unsigned long chunk, last;
+	pgoff_t s, e;
+	bool changed = false;
+	int r = 0;
+
+	if (!bo->ttm || !num_pages)
+		return 0;
+
+	gtt = to_pddgpu_ttm_tt(bo->ttm);
+	if (!gtt->populated)
+		return 0;
+
+	dma_resv_assert_held(bo->base.resv);
+
+	if (WARN_ON_ONCE(gtt->bound && gtt->num_populated < bo->ttm->num_pages))
+		return -EINVAL;
+
+	if (!ttm_tt_is_populated(bo->ttm)) {
+		r = ttm_tt_populate(bo->bdev, bo->ttm, &ctx);
+		if (r)
+			return r;
+	}
+
+	last = min_t(pgoff_t, start + num_pages, bo->ttm->num_pages);
+	last = (last - 1) >> gtt->chunk_order;
+
+	for (chunk = start >> gtt->chunk_order; chunk <= last; chunk++) {
+		if (test_bit(chunk, gtt->populated))
+			continue;
+
+		s = (pgoff_t)chunk << gtt->chunk_order;
+		e = min_t(pgoff_t, s + (1UL << gtt->chunk_order), bo->ttm->num_pages);
+
+		r = pddgpu_pool_alloc_pages(&pdev->mman.pool, bo->ttm, &ctx, s, e);
+		if (r)
+			break;
+
+		set_bit(chunk, gtt->populated);
+		gtt->num_populated += e - s;
+		atomic64_add((u64)(e - s) << PAGE_SHIFT, &pdev->memory_stats.sparse.populated);
+		changed = true;
+
+		unmap_mapping_range(bo->bdev->dev_mapping,
+		                    drm_vma_node_offset_addr(&bo->base.vma_node) +
+		                    ((u64)s << PAGE_SHIFT),
+		                    (u64)(e - s) << PAGE_SHIFT, 1);
+	}
+
+	if (changed)
+		pddgpu_ttm_tt_unmap_dma(pdev, gtt);
+
+	return r;
+}
+
+/*
+ * BO能否换出：页面已填充且尚未换出，导入的dma-buf和部分填充的稀疏BO
+ * 不能换出。挑选候选时在LRU锁下调用，换出前持有预留锁再检查一次。
+ */
+bool pddgpu_ttm_swappable(struct ttm_buffer_object *bo)
+{
+	struct ttm_tt *ttm = bo->ttm;
+	struct pddgpu_ttm_tt *gtt;
+
+	if (!ttm || !ttm_tt_is_populated(ttm) ||
+	    (ttm->page_flags & (TTM_TT_FLAG_EXTERNAL | TTM_TT_FLAG_SWAPPED)))
+		return false;
+
+	gtt = to_pddgpu_ttm_tt(ttm);
+	return !gtt->populated || gtt->num_populated == ttm->num_pages;
+}
+
+/*
+ * 把系统内存域中的BO换出到shmem，调用者需持有BO预留锁并确认BO空闲。
+ * shmem页面由内核在内存压力下异步写回交换区，下次填充ttm_tt时换入。
+ */
+int pddgpu_ttm_swapout(struct pddgpu_bo *abo, gfp_t gfp)
+{
+	struct ttm_buffer_object *bo = &abo->tbo;
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	pgoff_t num_pages;
+	ktime_t start;
+	int r;
+
+	dma_resv_assert_held(bo->base.resv);
+
+	if (!bo->resource || bo->resource->mem_type != TTM_PL_SYSTEM ||
+	    !pddgpu_ttm_swappable(bo))
+		return -EBUSY;
+
+	/* 用户映射和内核映射都指向即将释放的页面，仍在使用的内核映射不能拆 */
+	ttm_bo_unmap_virtual(bo);
+	pddgpu_kmap_cache_invalidate(abo);
+	if (!list_empty_careful(&abo->kmap_entries))
+		return -EBUSY;
+
+	num_pages = bo->ttm->num_pages;
+	start = ktime_get();
+
+	to_pddgpu_ttm_tt(bo->ttm)->release_pages = true;
+	r = ttm_tt_swapout(bo->bdev, bo->ttm, gfp);
+	if (r < 0) {
+		to_pddgpu_ttm_tt(bo->ttm)->release_pages = false;
+		return r;
+	}
+
+	to_pddgpu_ttm_tt(bo->ttm)->swapped = true;
+	pddgpu_swap_note_out(pdev, num_pages, ktime_us_delta(ktime_get(), start));
+
+	return 0;
+}
+
+/* 丢弃换出或压缩保存的内容，ttm_tt此时没有页面 */
+static void pddgpu_ttm_tt_drop_saved(struct pddgpu_device *pdev, struct ttm_tt *ttm)
+{
+	struct pddgpu_ttm_tt *gtt = to_pddgpu_ttm_tt(ttm);
+
+	if (ttm->page_flags & TTM_TT_FLAG_SWAPPED) {
+		if (gtt->swapped)
+			pddgpu_swap_note_released(pdev, ttm->num_pages);
+		gtt->swapped = false;
+		if (ttm->swap_storage)
+			fput(ttm->swap_storage);
+		ttm->swap_storage = NULL;
+		ttm->page_flags &= ~TTM_TT_FLAG_SWAPPED;
+	}
+
+	if (gtt->compressed) {
+		pddgpu_compressed_free(pdev, gtt->compressed);
+		gtt->compressed = NULL;
+	}
+}
+
+/*
+ * 准备丢弃DONTNEED BO的后备存储，调用者需持有BO预留锁。拆掉所有映射，
+ * 换出或压缩的内容直接丢弃。BO不可丢弃时返回false。
+ */
+static bool pddgpu_ttm_purge_prepare(struct pddgpu_bo *abo)
+{
+	struct ttm_buffer_object *bo = &abo->tbo;
+
+	if (abo->madv != PDDGPU_MADV_DONTNEED || bo->pin_count || abo->kptr ||
+	    !bo->resource)
+		return false;
+
+	ttm_bo_unmap_virtual(bo);
+	pddgpu_kmap_cache_invalidate(abo);
+	if (!list_empty_careful(&abo->kmap_entries))
+		return false;
+
+	if (bo->ttm && !ttm_tt_is_populated(bo->ttm))
+		pddgpu_ttm_tt_drop_saved(to_pddgpu_device(bo->bdev), bo->ttm);
+
+	return true;
+}
+
+/* 记录一次丢弃，下次WILLNEED时告诉用户内容已丢失 */
+static void pddgpu_ttm_purge_note(struct pddgpu_bo *abo)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(abo->tbo.bdev);
+
+	abo->purged = true;
+	pddgpu_client_bo_update(abo, NULL);
+	atomic64_inc(&pdev->memory_stats.purge.purges);
+	atomic64_add(abo->tbo.base.size, &pdev->memory_stats.purge.bytes);
+}
+
+/*
+ * 丢弃DONTNEED BO的后备存储而不是移动它，调用者需持有BO预留锁。空放置的
+ * 验证释放资源和页面，GPU仍在使用时由ghost对象延后释放。下次使用时重新
+ * 分配清零的后备存储。
+ */
+int pddgpu_ttm_purge(struct pddgpu_bo *abo, struct ttm_operation_ctx *ctx)
+{
+	struct ttm_placement placement = {};
+	int r;
+
+	dma_resv_assert_held(abo->tbo.base.resv);
+
+	if (!pddgpu_ttm_purge_prepare(abo))
+		return -EBUSY;
+
+	r = ttm_bo_validate(&abo->tbo, &placement, ctx);
+	if (r)
+		return r;
+
+	pddgpu_ttm_purge_note(abo);
+
+	return 0;
+}
+
+/*
+ * 压缩保存系统内存域中的BO并释放页面，调用者需持有BO预留锁并确认BO空闲。
+ * 下次填充ttm_tt时解压。抽样判定不可压缩时返回-E2BIG。
+ */
+int pddgpu_ttm_compress(struct pddgpu_bo *abo)
+{
+	struct ttm_buffer_object *bo = &abo->tbo;
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	struct pddgpu_compressed *c;
+
+	dma_resv_assert_held(bo->base.resv);
+
+	if (!bo->resource || bo->resource->mem_type != TTM_PL_SYSTEM ||
+	    !pddgpu_ttm_swappable(bo))
+		return -EBUSY;
+
+	/* 压缩期间的CPU写入会丢失，先拆掉映射，缺页要等预留锁 */
+	ttm_bo_unmap_virtual(bo);
+	pddgpu_kmap_cache_invalidate(abo);
+	if (!list_empty_careful(&abo->kmap_entries))
+		return -EBUSY;
+
+	c = pddgpu_compress_pages(pdev, bo->ttm->pages, bo->ttm->num_pages);
+	if (IS_ERR(c))
+		return PTR_ERR(c);
+
+	to_pddgpu_ttm_tt(bo->ttm)->release_pages = true;
+	ttm_tt_unpopulate(bo->bdev, bo->ttm);
+	to_pddgpu_ttm_tt(bo->ttm)->compressed = c;
+
+	return 0;
+}
+
+/* BO的第page页是否落在稀疏ttm_tt未填充的块中，换出或压缩的ttm_tt要整体恢复 */
+static bool pddgpu_ttm_sparse_hole(struct ttm_buffer_object *bo, pgoff_t page)
+{
+	struct pddgpu_ttm_tt *gtt;
+
+	if (!bo->ttm || !bo->resource || bo->resource->mem_type == TTM_PL_VRAM ||
+	    (bo->ttm->page_flags & TTM_TT_FLAG_SWAPPED))
+		return false;
+
+	gtt = to_pddgpu_ttm_tt(bo->ttm);
+	return gtt->populated && !gtt->compressed &&
+	       !test_bit(page >> gtt->chunk_order, gtt->populated);
+}
+
+/*
+ * 按DMA段划分GART绑定的映射片段：DMA地址和GART地址都对齐到2MB的片段
+ * 可以用一个大页表项映射，其余按页划分。IOMMU合并后的段即使由小页组成
+ * 也能划出2MB片段。导入的dma-buf使用导出者的映射，没有映射时只能按页划分。
+ * 设备没有GART页表，这里只统计划分结果，不写入表项。
+ */
+static void pddgpu_ttm_tt_count_frags(struct pddgpu_ttm_tt *gtt)
+{
+	struct ttm_tt *ttm = &gtt->ttm;
+	struct sg_table *sgt = gtt->sgt ?: ttm->sg;
+	const u64 huge_size = PDDGPU_POOL_HUGE_PAGES << PAGE_SHIFT;
+	u64 gart_addr = gtt->offset;
+	struct scatterlist *sg;
+	unsigned int i;
+
+	gtt->num_frags = 0;
+	gtt->num_huge_frags = 0;
+
+	if (!sgt) {
+		gtt->num_frags = ttm->num_pages;
+		return;
+	}
+
+	for_each_sgtable_dma_sg(sgt, sg, i) {
+		dma_addr_t addr = sg_dma_address(sg);
+		u64 left = sg_dma_len(sg);
+
+		while (left) {
+			u64 step = PAGE_SIZE;
+
+			if (left >= huge_size && IS_ALIGNED(addr, huge_size) &&
+			    IS_ALIGNED(gart_addr, huge_size)) {
+				step = huge_size;
+				gtt->num_huge_frags++;
+			}
+			gtt->num_frags++;
+
+			addr += step;
+			gart_addr += step;
+			left -= min(left, step);
+		}
+	}
+}
+
+/*
+ * 绑定到GART。只记录GART偏移和片段划分，不写GART页表项；ttm_tt的页面和
+ * DMA映射在填充时已经建立，绑定和解绑都不会重新映射。
+ */
+static int pddgpu_ttm_backend_bind(struct ttm_device *bdev, struct ttm_tt *ttm,
+                                   struct ttm_resource *res)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(bdev);
+	struct pddgpu_ttm_tt *gtt = to_pddgpu_ttm_tt(ttm);
+	int r;
+
+	if (!ttm_tt_is_populated(ttm)) {
+		PDDGPU_ERROR("Binding unpopulated ttm_tt\n");
+		return -EINVAL;
+	}
+
+	/* GPU经GART访问全部页面，稀疏ttm_tt绑定前整体填充 */
+	if (gtt->populated && gtt->num_populated < ttm->num_pages) {
+		r = pddgpu_ttm_sparse_populate(&gtt->abo->tbo, 0, ttm->num_pages);
+		if (r)
+			return r;
+	}
+
+	/* 系统内存域中的稀疏ttm_tt没有DMA映射，在这里建立 */
+	if (!gtt->sgt && !(ttm->page_flags & TTM_TT_FLAG_EXTERNAL)) {
+		r = pddgpu_ttm_tt_map_dma(pdev, gtt);
+		if (r)
+			return r;
+	}
+
+	gtt->offset = (u64)res->start << PAGE_SHIFT;
+	pddgpu_ttm_tt_count_frags(gtt);
+	gtt->bound = true;
+
+	atomic64_inc(&pdev->memory_stats.gart.binds);
+	atomic64_add(gtt->num_frags, &pdev->memory_stats.gart.frags);
+	atomic64_add(gtt->num_huge_frags, &pdev->memory_stats.gart.huge_frags);
+
+	return 0;
+}
+
+/* 从GART解绑，页面和DMA映射留给下次绑定 */
+static void pddgpu_ttm_backend_unbind(struct ttm_device *bdev, struct ttm_tt *ttm)
+{
+	struct pddgpu_ttm_tt *gtt = to_pddgpu_ttm_tt(ttm);
+
+	gtt->bound = false;
+}
+
+/* 销毁ttm_tt */
+static void pddgpu_ttm_tt_destroy(struct ttm_device *bdev, struct ttm_tt *ttm)
+{
+	struct pddgpu_ttm_tt *gtt = to_pddgpu_ttm_tt(ttm);
+
+	pddgpu_ttm_backend_unbind(bdev, ttm);
+	pddgpu_ttm_tt_drop_saved(to_pddgpu_device(bdev), ttm);
+
+	if (gtt->populated) {
+		atomic64_sub((u64)ttm->num_pages << PAGE_SHIFT,
+		             &to_pddgpu_device(bdev)->memory_stats.sparse.size);
+		bitmap_free(gtt->populated);
+	}
+
+	ttm_tt_fini(ttm);
+	kfree(gtt);
+}
+
+/*
+ * 系统内存和GTT之间使用同一组ttm_tt页面，只改变GART绑定，不复制数据。
+ * 返回-EAGAIN表示不是这种移动。
+ */
+static int pddgpu_bo_move_zero_copy(struct ttm_buffer_object *bo,
+                                    struct ttm_operation_ctx *ctx,
+                                    struct ttm_resource *new_mem)
+{
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	u32 old_type = bo->resource->mem_type;
+	int ret;
+
+	if (!bo->ttm)
+		return -EAGAIN;
+
+	if (old_type == TTM_PL_SYSTEM && new_mem->mem_type == TTM_PL_TT) {
+		ret = pddgpu_ttm_backend_bind(bo->bdev, bo->ttm, new_mem);
+		if (ret)
+			return ret;
+	} else if (old_type == TTM_PL_TT && new_mem->mem_type == TTM_PL_SYSTEM) {
+		/* GPU可能仍通过GART访问这些页面 */
+		ret = ttm_bo_wait_ctx(bo, ctx);
+		if (ret)
+			return ret;
+
+		pddgpu_ttm_backend_unbind(bo->bdev, bo->ttm);
+	} else {
+		return -EAGAIN;
+	}
+
+	ttm_bo_move_null(bo, new_mem);
+
+	atomic64_inc(&pdev->memory_stats.move.zero_copy);
+	atomic64_add(bo->base.size, &pdev->memory_stats.move.zero_copy_bytes);
+
+	return 0;
+}
+
+/*
+ * 移动成功后更新BO的域和客户端统计，并记录移动历史检测两个域之间的往返。
+ * 失败的移动不计入历史，否则重试会被误判为抖动。
+ */
+static void pddgpu_bo_move_notify(struct pddgpu_bo *abo, u32 old_type,
+                                  struct ttm_resource *new_mem)
+{
+	abo->domain = new_mem->mem_type;
+	pddgpu_client_bo_update(abo, new_mem);
+	pddgpu_thrash_note_move(abo, old_type, new_mem->mem_type);
+}
+
 /* TTM BO移动函数 */
 static int pddgpu_bo_move(struct ttm_buffer_object *bo, bool evict,
                           struct ttm_operation_ctx *ctx,
@@ -136,36 +932,124 @@ static int pddgpu_bo_move(struct ttm_buffer_object *bo, bool evict,
 {
 	struct pddgpu_bo *abo = to_pddgpu_bo(bo);
 	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	u32 old_type = bo->resource ? bo->resource->mem_type : new_mem->mem_type;
+	ktime_t start;
 	int ret;
 
 	PDDGPU_DEBUG("Moving BO: size=%lu, new_mem=%p\n", bo->base.size, new_mem);
 
-	/* 使用GPU进行内存复制 */
-	if (pdev->mman.buffer_funcs_enabled) {
-		ret = pddgpu_move_blit(bo, evict, new_mem, bo->resource);
-		if (ret == 0) {
-			/* GPU复制成功 */
-			ttm_bo_move_null(bo, new_mem);
-			return 0;
+	/* 缓存的内核映射指向旧位置，移动前使其失效 */
+	pddgpu_kmap_cache_invalidate(abo);
+
+	/* 新资源已分配，低于低水位时唤醒后台回收 */
+	pddgpu_reclaim_check(pdev, new_mem->mem_type);
+
+	/* 非驱逐的放置计为一次访问 */
+	if (!evict)
+		pddgpu_bo_touch(abo);
+
+	/* 延迟放置的BO首次获得资源，或系统内存中尚未填充，无需复制 */
+	if (!bo->resource ||
+	    (bo->resource->mem_type == TTM_PL_SYSTEM && !bo->ttm)) {
+		if (new_mem->mem_type == TTM_PL_TT) {
+			ret = pddgpu_ttm_backend_bind(bo->bdev, bo->ttm, new_mem);
+			if (ret)
+				return ret;
 		}
+		ttm_bo_move_null(bo, new_mem);
+		pddgpu_bo_move_notify(abo, old_type, new_mem);
+		return 0;
 	}
 
-	/* 回退到CPU复制 */
-	ret = ttm_bo_move_memcpy(bo, evict, ctx, new_mem);
+	/* 驱逐DONTNEED的BO时丢弃内容而不复制，资源切换后才记为已丢弃 */
+	if (evict && new_mem->mem_type == TTM_PL_SYSTEM && pddgpu_ttm_purge_prepare(abo)) {
+		ret = ttm_bo_wait_ctx(bo, ctx);
+		if (ret)
+			return ret;
+
+		if (bo->ttm) {
+			pddgpu_ttm_backend_unbind(bo->bdev, bo->ttm);
+			ttm_tt_unpopulate(bo->bdev, bo->ttm);
+		}
+		ttm_bo_move_null(bo, new_mem);
+		pddgpu_bo_move_notify(abo, old_type, new_mem);
+		pddgpu_ttm_purge_note(abo);
+		atomic_inc(&pdev->num_evictions);
+		return 0;
+	}
+
+	/* 系统内存和GTT之间的移动不复制数据 */
+	ret = pddgpu_bo_move_zero_copy(bo, ctx, new_mem);
+	if (ret != -EAGAIN) {
+		if (ret)
+			return ret;
+		pddgpu_bo_move_notify(abo, old_type, new_mem);
+		if (evict)
+			atomic_inc(&pdev->num_evictions);
+		return 0;
+	}
+
+	/*
+	 * 换出或压缩的ttm_tt没有页面，复制会把未填充的源当作清零。
+	 * 先换入或解压，TTM只为GTT目标填充ttm_tt，其他目标要在这里恢复。
+	 */
+	if (bo->ttm && !ttm_tt_is_populated(bo->ttm) &&
+	    (to_pddgpu_ttm_tt(bo->ttm)->compressed ||
+	     bo->ttm->page_flags & TTM_TT_FLAG_SWAPPED)) {
+		ret = ttm_tt_populate(bo->bdev, bo->ttm, ctx);
+		if (ret)
+			return ret;
+	}
+
+	/* 复制会读写全部页面，稀疏ttm_tt先整体填充 */
+	if (bo->ttm) {
+		ret = pddgpu_ttm_sparse_populate(bo, 0, bo->ttm->num_pages);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * 复制完成后资源已经切换到new_mem，不能再失败。复制到GTT的页面
+	 * 先绑定，复制失败时解绑，BO仍留在原位置。
+	 */
+	if (new_mem->mem_type == TTM_PL_TT) {
+		ret = pddgpu_ttm_backend_bind(bo->bdev, bo->ttm, new_mem);
+		if (ret)
+			return ret;
+	}
+
+	/* 由复制引擎异步复制，失败时回退到同步CPU复制 */
+	if (pdev->mman.buffer_funcs_enabled) {
+		ret = pddgpu_move_blit(bo, evict, ctx, new_mem, bo->resource);
+		if (!ret)
+			goto out;
+	}
+
+	/* 回退到CPU复制，记录耗时用于换算移动配额 */
+	start = ktime_get();
+	ret = pddgpu_copy_sync(bo, ctx, new_mem);
+	if (ret == -EAGAIN)
+		ret = ttm_bo_move_memcpy(bo, evict, ctx, new_mem);
 	if (ret) {
 		PDDGPU_ERROR("Failed to move BO: %d\n", ret);
+		if (new_mem->mem_type == TTM_PL_TT)
+			pddgpu_ttm_backend_unbind(bo->bdev, bo->ttm);
 		return ret;
 	}
+	pddgpu_cs_note_copy(pdev, bo->base.size, ktime_us_delta(ktime_get(), start));
 
+out:
 	/* 更新BO信息 */
-	abo->domain = new_mem->mem_type;
 	abo->size = bo->base.size;
+	pddgpu_bo_move_notify(abo, old_type, new_mem);
 
 	/* 更新统计信息 */
 	if (evict) {
 		atomic64_inc(&pdev->num_evictions);
 	}
 	atomic64_add(bo->base.size, &pdev->num_bytes_moved);
+	atomic64_inc(&pdev->memory_stats.move.copies);
+	atomic64_add(bo->base.size, &pdev->memory_stats.move.copy_bytes);
 
 	return 0;
 }
@@ -178,6 +1062,20 @@ static void pddgpu_evict_flags(struct ttm_buffer_object *bo,
 
 	PDDGPU_DEBUG("Setting evict flags for BO\n");
 
+	if (!bo->resource)
+		return;
+
+	/*
+	 * DONTNEED的BO移到系统内存，由pddgpu_bo_move()丢弃内容而不复制。
+	 * 驱逐可能失败，等资源切换后才记为已丢弃。
+	 */
+	if (pddgpu_bo_is_pddgpu_bo(bo) && abo->madv == PDDGPU_MADV_DONTNEED &&
+	    bo->resource->mem_type != TTM_PL_SYSTEM) {
+		pddgpu_bo_placement_from_domain(abo, PDDGPU_GEM_DOMAIN_CPU);
+		*placement = abo->placement;
+		return;
+	}
+
 	switch (bo->resource->mem_type) {
 	case TTM_PL_VRAM:
 		/* 从VRAM移动到GTT或系统内存 */
@@ -190,17 +1088,77 @@ static void pddgpu_evict_flags(struct ttm_buffer_object *bo,
 		break;
 	case TTM_PL_SYSTEM:
 		/* 系统内存不需要移动 */
-		break;
+		return;
 	}
+
+	*placement = abo->placement;
 }
 
 /* TTM BO驱逐价值评估 */
 static bool pddgpu_bo_eviction_valuable(struct ttm_buffer_object *bo,
                                         const struct ttm_place *place)
 {
-	/* 简单的驱逐价值评估 */
-	/* 可以根据BO的使用情况、大小、优先级等进行更复杂的评估 */
-	return true;
+	/* 放置范围不重叠的BO驱逐了也无济于事 */
+	if (!ttm_bo_eviction_valuable(bo, place))
+		return false;
+
+	/* TTM搬移时产生的ghost对象没有驱动私有状态 */
+	if (!pddgpu_bo_is_pddgpu_bo(bo))
+		return true;
+
+	/* DONTNEED的BO直接丢弃，不需要复制，总是值得驱逐 */
+	if (to_pddgpu_bo(bo)->madv == PDDGPU_MADV_DONTNEED && !bo->pin_count)
+		return true;
+
+	/* 抖动的BO在回退窗口内保持在当前域 */
+	if (pddgpu_thrash_bo_held(to_pddgpu_bo(bo)))
+		return false;
+
+	/*
+	 * TTM按优先级从低到高遍历LRU，低优先级BO总是先被驱逐。
+	 * 延迟关键的BO在内存压力下不参与驱逐，只在挂起等全量驱逐时移出。
+	 */
+	if (bo->priority >= PDDGPU_BO_PRIORITY_CRITICAL)
+		return false;
+
+	/* 同一优先级内按代价模型挑选最便宜的候选 */
+	return pddgpu_evict_valuable(to_pddgpu_bo(bo), place);
+}
+
+/* CPU填充，WC/IO内存使用非临时存储 */
+void pddgpu_ttm_fill(void *ptr, bool is_iomem, u8 value, size_t size)
+{
+	pddgpu_memset(ptr, is_iomem, value, size);
+}
+
+/* 清理BO内容，调用者需持有BO预留锁 */
+int pddgpu_ttm_clear_buffer(struct pddgpu_bo *bo, struct dma_resv *resv,
+                            struct dma_fence **fence)
+{
+	size_t size = bo->tbo.base.size;
+	bool is_iomem;
+	void *ptr;
+	long r;
+
+	/* 等待之前的内核操作（如移动）完成 */
+	r = dma_resv_wait_timeout(resv, DMA_RESV_USAGE_KERNEL, false,
+	                          MAX_SCHEDULE_TIMEOUT);
+	if (r < 0)
+		return r;
+
+	r = pddgpu_kmap_cache_get(bo, 0, PFN_UP(size), &ptr, &is_iomem);
+	if (r) {
+		PDDGPU_ERROR("Failed to map BO for clear: %ld\n", r);
+		return r;
+	}
+
+	pddgpu_ttm_fill(ptr, is_iomem, 0, size);
+	pddgpu_kmap_cache_put(bo, ptr);
+
+	/* CPU清理同步完成，返回已signal的栅栏 */
+	*fence = dma_fence_get_stub();
+
+	return 0;
 }
 
 /* TTM IO内存预留 */
@@ -208,25 +1166,311 @@ static int pddgpu_ttm_io_mem_reserve(struct ttm_device *bdev,
                                      struct ttm_resource *mem)
 {
 	struct pddgpu_device *pdev = to_pddgpu_device(bdev);
+	u64 addr, contig;
 
 	PDDGPU_DEBUG("Reserving IO memory\n");
 
-	/* 这里应该实现IO内存预留逻辑 */
-	/* 由于这是模拟实现，我们只是记录日志 */
+	switch (mem->mem_type) {
+	case TTM_PL_SYSTEM:
+	case TTM_PL_TT:
+		/* 系统内存和GTT由ttm_tt页面提供，无需IO映射 */
+		return 0;
+	case TTM_PL_VRAM:
+		/* 只有全部buddy块都CPU可见的VRAM才能映射 */
+		if (pddgpu_vram_mgr_res_visible_size(pdev, mem) < mem->size)
+			return -EINVAL;
 
-	return 0;
+		/*
+		 * 物理连续的资源才有线性总线地址，可供ttm_bo_kmap()使用；
+		 * 不连续的资源只能经io_mem_pfn逐页映射。
+		 */
+		addr = pddgpu_vram_mgr_res_addr(mem, 0, &contig);
+		if (addr == PDDGPU_BO_INVALID_OFFSET)
+			return -EINVAL;
+		mem->bus.offset = contig >= mem->size ? pdev->gmc.fb_start + addr : 0;
+		mem->bus.is_iomem = true;
+		mem->bus.caching = ttm_write_combined;
+		return 0;
+	default:
+		return -EINVAL;
+	}
 }
 
 /* TTM IO内存页帧号 */
 static unsigned long pddgpu_ttm_io_mem_pfn(struct ttm_buffer_object *bo,
                                            unsigned long page_offset)
 {
-	PDDGPU_DEBUG("Getting IO memory PFN\n");
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	u64 addr;
 
-	/* 这里应该返回实际的页帧号 */
-	/* 由于这是模拟实现，我们返回0 */
-	return 0;
+	/* VRAM资源可能由多个不连续的buddy块组成，需按块查找 */
+	addr = pddgpu_vram_mgr_res_addr(bo->resource,
+	                                (u64)page_offset << PAGE_SHIFT, NULL);
+	if (addr == PDDGPU_BO_INVALID_OFFSET)
+		return 0;
+
+	return (pdev->gmc.fb_start + addr) >> PAGE_SHIFT;
+}
+
+/* mmap缺页映射字节数估算 */
+static u64 pddgpu_ttm_fault_bytes(struct vm_fault *vmf,
+                                  struct ttm_buffer_object *bo)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long remaining;
+
+	/* ttm_bo_vm_fault_reserved()最多预映射prefault个页面，受VMA和BO边界限制 */
+	remaining = min_t(unsigned long, (vma->vm_end - vmf->address) >> PAGE_SHIFT,
+	                  PFN_UP(bo->base.size));
+
+	return (u64)clamp_t(unsigned long, pddgpu_mmap_prefault, 1, remaining) << PAGE_SHIFT;
+}
+
+/* 缺页地址对应的BO页 */
+static pgoff_t pddgpu_ttm_fault_page(struct vm_area_struct *vma, unsigned long address,
+                                     struct ttm_buffer_object *bo)
+{
+	return ((address - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff -
+	       drm_vma_node_start(&bo->base.vma_node);
+}
+
+/*
+ * 稀疏BO的缺页：未填充的块读时映射共享零页，写时分配该块。返回0表示
+ * 该页已有后备页面，交给普通缺页处理。
+ */
+static vm_fault_t pddgpu_ttm_sparse_fault(struct vm_fault *vmf,
+                                          struct ttm_buffer_object *bo)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	pgoff_t page = pddgpu_ttm_fault_page(vma, vmf->address, bo);
+	vm_fault_t ret;
+	int r;
+
+	if (!pddgpu_ttm_sparse_hole(bo, page))
+		return 0;
+
+	if (vmf->flags & FAULT_FLAG_WRITE) {
+		r = pddgpu_ttm_sparse_populate(bo, page, 1);
+		return r ? vmf_error(r) : 0;
+	}
+
+	/* 映射只读，首次写入时进入pddgpu_ttm_sparse_mkwrite() */
+	ret = vmf_insert_pfn_prot(vma, vmf->address, my_zero_pfn(vmf->address),
+	                          vm_get_page_prot(vma->vm_flags & ~VM_WRITE));
+	if (ret == VM_FAULT_NOPAGE)
+		atomic64_inc(&to_pddgpu_device(bo->bdev)->memory_stats.sparse.zero_maps);
+
+	return ret;
+}
+
+/* mmap缺页处理 */
+static vm_fault_t pddgpu_ttm_fault(struct vm_fault *vmf)
+{
+	struct ttm_buffer_object *bo = vmf->vma->vm_private_data;
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	pgprot_t prot = vmf->vma->vm_page_prot;
+	vm_fault_t ret;
+	int idx;
+
+	ret = ttm_bo_vm_reserve(bo, vmf);
+	if (ret)
+		return ret;
+
+	/* 后备存储已丢弃的BO在WILLNEED之前不能访问 */
+	if (to_pddgpu_bo(bo)->purged) {
+		ret = VM_FAULT_SIGBUS;
+		goto out_unlock;
+	}
+
+	/* 延迟放置的BO在首次CPU访问时分配后备存储 */
+	if (!bo->resource) {
+		struct pddgpu_bo *abo = to_pddgpu_bo(bo);
+		int r;
+
+		r = pddgpu_bo_lazy_place(abo, PDDGPU_MOVE_PRIO_FAULT);
+		if (r) {
+			ret = VM_FAULT_SIGBUS;
+			goto out_unlock;
+		}
+	}
+
+	if (vmf->vma->vm_ops == &pddgpu_ttm_sparse_vm_ops) {
+		ret = pddgpu_ttm_sparse_fault(vmf, bo);
+		if (ret)
+			goto out_unlock;
+
+		/* 稀疏BO的映射默认只读，已有后备页面的写缺页直接映射为可写 */
+		if (vmf->flags & FAULT_FLAG_WRITE)
+			prot = pgprot_modify(prot, vm_get_page_prot(vmf->vma->vm_flags));
+	}
+
+	if (drm_dev_enter(pdev->ddev, &idx)) {
+		ret = ttm_bo_vm_fault_reserved(vmf, prot, max(pddgpu_mmap_prefault, 1));
+		drm_dev_exit(idx);
+	} else {
+		/* 设备已拔出，映射哑页 */
+		ret = ttm_bo_vm_dummy_page(vmf, vmf->vma->vm_page_prot);
+	}
+
+	if (ret == VM_FAULT_RETRY && !(vmf->flags & FAULT_FLAG_RETRY_NOWAIT))
+		return ret;
+
+	if (!(ret & VM_FAULT_ERROR)) {
+		pddgpu_bo_touch(to_pddgpu_bo(bo));
+		pddgpu_memory_stats_fault(pdev, pddgpu_ttm_fault_bytes(vmf, bo), 0);
+	}
+
+out_unlock:
+	dma_resv_unlock(bo->base.resv);
+
+	return ret;
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/* 大页缺页处理：VRAM物理连续时直接插入PMD/PUD映射 */
+static vm_fault_t pddgpu_ttm_huge_fault(struct vm_fault *vmf, unsigned int order)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	struct ttm_buffer_object *bo = vma->vm_private_data;
+	struct pddgpu_device *pdev = to_pddgpu_device(bo->bdev);
+	bool write = vmf->flags & FAULT_FLAG_WRITE;
+	unsigned long fault_size = PAGE_SIZE << order;
+	unsigned long address = vmf->address & ~(fault_size - 1);
+	unsigned long page_offset, pfn;
+	vm_fault_t ret = VM_FAULT_FALLBACK;
+	u64 addr, contig;
+
+	if (order != PMD_ORDER
+#ifdef CONFIG_HAVE_ARCH_TRANSPARENT_HUGEPAGE_PUD
+	    && order != PUD_ORDER
+#endif
+	    )
+		return VM_FAULT_FALLBACK;
+
+	/* 大页范围必须完整落在VMA内 */
+	if (address < vma->vm_start || address + fault_size > vma->vm_end)
+		return VM_FAULT_FALLBACK;
+
+	/* 私有写映射需要COW，只能逐页处理 */
+	if (write && !(vma->vm_flags & VM_SHARED))
+		return VM_FAULT_FALLBACK;
+
+	ret = ttm_bo_vm_reserve(bo, vmf);
+	if (ret)
+		return ret;
+
+	ret = VM_FAULT_FALLBACK;
+
+	/* 只有空闲、CPU可见的VRAM才能走大页路径，其余情况交给普通缺页处理 */
+	if (!bo->resource || bo->resource->mem_type != TTM_PL_VRAM ||
+	    !dma_resv_test_signaled(bo->base.resv, DMA_RESV_USAGE_KERNEL))
+		goto out_unlock;
+
+	page_offset = ((address - vma->vm_start) >> PAGE_SHIFT) +
+		      vma->vm_pgoff - drm_vma_node_start(&bo->base.vma_node);
+	if (((u64)page_offset << PAGE_SHIFT) + fault_size > bo->base.size)
+		goto out_unlock;
+
+	if (ttm_mem_io_reserve(bo->bdev, bo->resource))
+		goto out_unlock;
+
+	addr = pddgpu_vram_mgr_res_addr(bo->resource,
+	                                (u64)page_offset << PAGE_SHIFT, &contig);
+	if (addr == PDDGPU_BO_INVALID_OFFSET || contig < fault_size)
+		goto out_unlock;
+
+	pfn = (pdev->gmc.fb_start + addr) >> PAGE_SHIFT;
+	if (pfn & ((1UL << order) - 1))
+		goto out_unlock;
+
+	if (order == PMD_ORDER)
+		ret = vmf_insert_pfn_pmd(vmf, __pfn_to_pfn_t(pfn, PFN_DEV), write);
+#ifdef CONFIG_HAVE_ARCH_TRANSPARENT_HUGEPAGE_PUD
+	else
+		ret = vmf_insert_pfn_pud(vmf, __pfn_to_pfn_t(pfn, PFN_DEV), write);
+#endif
+
+	if (ret == VM_FAULT_NOPAGE) {
+		pddgpu_bo_touch(to_pddgpu_bo(bo));
+		pddgpu_memory_stats_fault(pdev, fault_size, order);
+	}
+
+out_unlock:
+	dma_resv_unlock(bo->base.resv);
+	return ret;
 }
+#endif
+
+/*
+ * 稀疏BO的只读页首次写入。页表锁已经释放，不能像缺页处理那样放弃
+ * mmap锁重试，因此直接等待预留锁。分配块后该块的映射已失效，返回
+ * VM_FAULT_NOPAGE让这次写入重新缺页并映射新页面。
+ */
+static vm_fault_t pddgpu_ttm_sparse_mkwrite(struct vm_fault *vmf)
+{
+	struct ttm_buffer_object *bo = vmf->vma->vm_private_data;
+	pgoff_t page = pddgpu_ttm_fault_page(vmf->vma, vmf->address, bo);
+	vm_fault_t ret = 0;
+	int r;
+
+	if (dma_resv_lock_interruptible(bo->base.resv, NULL))
+		return VM_FAULT_NOPAGE;
+
+	if (pddgpu_ttm_sparse_hole(bo, page)) {
+		r = pddgpu_ttm_sparse_populate(bo, page, 1);
+		ret = r ? vmf_error(r) : VM_FAULT_NOPAGE;
+	}
+
+	dma_resv_unlock(bo->base.resv);
+
+	return ret;
+}
+
+/* 调试器访问稀疏BO时先填充涉及的块，内核映射不能指向空页 */
+static int pddgpu_ttm_sparse_access(struct vm_area_struct *vma, unsigned long addr,
+                                    void *buf, int len, int write)
+{
+	struct ttm_buffer_object *bo = vma->vm_private_data;
+	pgoff_t page = pddgpu_ttm_fault_page(vma, addr, bo);
+	int r;
+
+	if (len < 1 || page >= PFN_UP(bo->base.size))
+		return -EIO;
+
+	r = ttm_bo_reserve(bo, true, false, NULL);
+	if (r)
+		return r;
+
+	r = pddgpu_ttm_sparse_populate(bo, page, PFN_UP(offset_in_page(addr) + len));
+	ttm_bo_unreserve(bo);
+	if (r)
+		return r;
+
+	return ttm_bo_vm_access(vma, addr, buf, len, write);
+}
+
+/* TTM BO mmap操作 */
+const struct vm_operations_struct pddgpu_ttm_vm_ops = {
+	.fault = pddgpu_ttm_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	.huge_fault = pddgpu_ttm_huge_fault,
+#endif
+	.open = ttm_bo_vm_open,
+	.close = ttm_bo_vm_close,
+	.access = ttm_bo_vm_access,
+};
+
+/* 稀疏BO mmap操作，pfn_mkwrite使映射保持只读，首次写入时才分配页面 */
+const struct vm_operations_struct pddgpu_ttm_sparse_vm_ops = {
+	.fault = pddgpu_ttm_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	.huge_fault = pddgpu_ttm_huge_fault,
+#endif
+	.pfn_mkwrite = pddgpu_ttm_sparse_mkwrite,
+	.open = ttm_bo_vm_open,
+	.close = ttm_bo_vm_close,
+	.access = pddgpu_ttm_sparse_access,
+};
 
 /* TTM内存访问 */
 static int pddgpu_ttm_access_memory(struct ttm_buffer_object *bo,
@@ -251,16 +1495,21 @@ static void pddgpu_bo_delete_mem_notify(struct ttm_buffer_object *bo)
 	/* 由于这是模拟实现，我们只是记录日志 */
 }
 
-/* GPU加速内存移动 */
-static int pddgpu_move_blit(struct ttm_buffer_object *bo, bool evict,
-                            struct ttm_resource *new_mem,
-                            struct ttm_resource *old_mem)
+/*
+ * TTM全局换出通知，之后ttm_tt_swapout()释放页面。缓存中的空闲映射仍指向
+ * 这些页面，必须在释放前拆除。
+ */
+static void pddgpu_bo_swap_notify(struct ttm_buffer_object *bo)
 {
-	PDDGPU_DEBUG("GPU accelerated memory move\n");
+	/* TTM搬移时产生的ghost对象没有驱动私有状态 */
+	if (!pddgpu_bo_is_pddgpu_bo(bo))
+		return;
+
+	pddgpu_kmap_cache_invalidate(to_pddgpu_bo(bo));
 
-	/* 这里应该实现GPU加速的内存移动 */
-	/* 由于这是模拟实现，我们返回错误以回退到CPU复制 */
-	return -ENODEV;
+	/* 换出的页面直接还给系统，不留在页面池中 */
+	if (bo->ttm)
+		to_pddgpu_ttm_tt(bo->ttm)->release_pages = true;
 }
 
 /* 放置策略设置 */
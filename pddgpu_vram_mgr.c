@@ -15,7 +15,6 @@
 #include "include/pddgpu_drv.h"
 #include "pddgpu_vram_mgr.h"
 
-#define PDDGPU_MAX_SG_SEGMENT_SIZE	(2UL << 30)
 #define PDDGPU_VRAM_ALLOC_RETRY_COUNT	3
 #define PDDGPU_VRAM_ALLOC_RETRY_DELAY	10 /* 毫秒 */
 
@@ -132,6 +131,7 @@ static int pddgpu_vram_mgr_alloc(struct ttm_resource_manager *man,
 		return -ENODEV;
 	}
 
+	/* 以字节为单位的分配范围 */
 	lpfn = (u64)place->lpfn << PAGE_SHIFT;
 	if (!lpfn || lpfn > man->size)
 		lpfn = man->size;
@@ -159,6 +159,10 @@ static int pddgpu_vram_mgr_alloc(struct ttm_resource_manager *man,
 	ttm_resource_init(bo, place, &vres->base);
 	INIT_LIST_HEAD(&vres->blocks);
 
+	/* 需要线性CPU映射的BO（如内核BO）要求物理连续 */
+	if (place->flags & TTM_PL_FLAG_CONTIGUOUS)
+		vres->flags |= DRM_BUDDY_CONTIGUOUS_ALLOCATION;
+
 	size = PFN_UP(bo->base.size) << PAGE_SHIFT;
 	remaining_size = size;
 
@@ -190,9 +194,10 @@ retry_alloc:
 
 	/* 分配内存块 */
 	while (remaining_size >= min_block_size) {
-		u64 block_size = min_block_size;
-		u64 block_start = fpfn << PAGE_SHIFT;
-		u64 block_end = lpfn << PAGE_SHIFT;
+		u64 block_size = vres->flags & DRM_BUDDY_CONTIGUOUS_ALLOCATION ?
+		                 remaining_size : min_block_size;
+		u64 block_start = fpfn;
+		u64 block_end = lpfn;
 
 		/* 尝试分配块 */
 		r = drm_buddy_alloc_blocks(mm, block_start, block_end,
@@ -530,3 +535,66 @@ void pddgpu_vram_mgr_get_stats(struct pddgpu_vram_mgr *mgr,
 	stats->state = atomic_read(&mgr->state);
 	stats->is_healthy = pddgpu_vram_mgr_is_healthy(mgr);
 }
+
+/* 资源中位于CPU可见VRAM内的字节数，按buddy块累加 */
+u64 pddgpu_vram_mgr_res_visible_size(struct pddgpu_device *pdev,
+                                     struct ttm_resource *res)
+{
+	struct pddgpu_vram_mgr_resource *vres = to_pddgpu_vram_mgr_resource(res);
+	u64 visible = pdev->gmc.visible_vram_size;
+	struct drm_buddy_block *block;
+	u64 start, size, usage = 0;
+
+	list_for_each_entry(block, &vres->blocks, link) {
+		start = pddgpu_vram_mgr_block_start(block);
+		size = pddgpu_vram_mgr_block_size(block);
+
+		if (start >= visible)
+			continue;
+		usage += min(size, visible - start);
+	}
+
+	return usage;
+}
+
+/* 资源内偏移转换为VRAM地址 */
+u64 pddgpu_vram_mgr_res_addr(struct ttm_resource *res, u64 offset, u64 *contig)
+{
+	struct pddgpu_vram_mgr_resource *vres = to_pddgpu_vram_mgr_resource(res);
+	struct drm_buddy_block *block;
+	u64 start, size;
+
+	/* 按分配顺序遍历buddy块，定位偏移所在的块 */
+	list_for_each_entry(block, &vres->blocks, link) {
+		size = pddgpu_vram_mgr_block_size(block);
+		if (offset >= size) {
+			offset -= size;
+			continue;
+		}
+
+		start = pddgpu_vram_mgr_block_start(block);
+
+		/* 统计从该地址起物理连续的字节数 */
+		if (contig) {
+			*contig = size - offset;
+			while (!list_is_last(&block->link, &vres->blocks)) {
+				struct drm_buddy_block *next = list_next_entry(block, link);
+
+				if (pddgpu_vram_mgr_block_start(next) !=
+				    pddgpu_vram_mgr_block_start(block) +
+				    pddgpu_vram_mgr_block_size(block))
+					break;
+
+				*contig += pddgpu_vram_mgr_block_size(next);
+				block = next;
+			}
+		}
+
+		return start + offset;
+	}
+
+	if (contig)
+		*contig = 0;
+
+	return PDDGPU_BO_INVALID_OFFSET;
+}